@@ -29,6 +29,7 @@
 #include "ordolim.h"
 #include "gauss.h"
 #include "mymem.h"
+#include "summations.h"
 
 struct OPP_LINE {
 	player_t i;
@@ -518,20 +519,6 @@ static int compare_oline (const void * a, const void * b)
 }
 
 
-static ptrdiff_t
-head2head_idx_sdev (player_t inp_x, player_t inp_y)
-{	
-	ptrdiff_t idx;
-	ptrdiff_t x = (ptrdiff_t)inp_x;
-	ptrdiff_t y = (ptrdiff_t)inp_y;
-	if (y < x) 
-		idx = (x*x-x)/2+y;					
-	else
-		idx = (y*y-y)/2+x;
-	return idx;
-}
-
-
 static char *
 get_ratingstr (char *s, int decimals, double rating)
 {
@@ -785,16 +772,18 @@ all_report_indiv_stats 	( FILE *textf
 					fprintf(f, " : %+*.*f",6+decimals, decimals, dr);
 
 					if (simulate > 1 && p->sim != NULL) {
-						ptrdiff_t idx;
+						const struct DEVIATION_ACC *pa;
 						double ctrs;
 						double sd;
 
-						idx = head2head_idx_sdev (target, oth);
-						sd = p->sim[idx].sdev;
-						ctrs = 100*gauss_integral(dr/sd);
-
-						fprintf(f, ", %*.*f, %6.1f", 4+decimals, decimals, sd, ctrs);
-
+						if (NULL != (pa = summations_pair (p->sim, target, oth))) {
+							sd = pa->sdev;
+							ctrs = 100*gauss_integral(dr/sd);
+							fprintf(f, ", %*.*f, %6.1f", 4+decimals, decimals, sd, ctrs);
+						} else {
+							// pair not accumulated in the simulations
+							fprintf(f, ", %*s, %6s", 4+decimals, "-", "-");
+						}
 					} 
 					fprintf(f, "\n");
 				}
@@ -40,7 +40,7 @@ struct CEGT {
 	const char						**name;
 	double							confidence_factor;
 	const struct GAMESTATS 			*gstat;
-	const struct DEVIATION_ACC		*sim;
+	const struct summations			*sim;
 	struct output_qualifiers 		outqual;
 	int 							decimals; // only valid for head to head output
 };
@@ -0,0 +1,1329 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "covar.h"
+#include "xpect.h"
+#include "mymem.h"
+#include "sysport.h"
+
+
+/*
+|	Every encounter, and every prior, is a term t with up to three
+|	parameters (white, black and white advantage) and their coefficients.
+|	The curvature of the fit is H = sum of h t t', and the variance of the
+|	equations that were solved is M = sum of m t t'. The covariance of the
+|	parameters is A M A, with A the inverse of H. When the ratings maximize
+|	the likelihood, M == H and the covariance is just A. The prior of the
+|	white advantage is not simulated, so it has no variance (m = 0).
+|
+|	Players with a fixed rating (anchors) are not parameters. Without
+|	anchors or loose anchors, the ratings are only defined relative to the
+|	average: one player is fixed to solve H, and the covariance is later
+|	moved to the average with C' = P C P, P = I - 11'/n.
+|
+|	Up to COVAR_DENSE_MAX_PARAMS, A is the dense inverse of H from its
+|	Cholesky factorization, which takes seconds and is best for round
+|	robins. A M is not stored: the row of a parameter is built from the
+|	terms when needed, and the covariance of a pair is its dot product with
+|	a row of A.
+|
+|	Larger pools are sparse, a few opponents each, and the inverse would
+|	not fit in memory. A is never formed. A b is solved with conjugate
+|	gradients, preconditioned with the diagonal of H, on the sparse rows of
+|	H and M merged from the terms. The variance of each parameter is one solve,
+|	a pair in scope another one (two for a row of a table with sandwich),
+|	spread over the threads given. To keep the system well conditioned, the
+|	player fixed for a free average stays in it as one more unknown. H is
+|	then singular only along the ratings all moving together, b is made
+|	orthogonal to that, and x is shifted to put that player back at 0,
+|	which is the same x that the system without that player gives.
+|
+|	The same A gives the change of the parameters when the results change:
+|	A s, with s the change of the equations. For an encounter, s is the sum
+|	of g over its games, g being the derivative of the equation with each
+|	result. That is the linear prediction of covlin_predict().
+*/
+
+#define NOPARAM (-1)
+#define DELTA_STEP 0.5		// rating points, numerical derivatives of the probabilities
+#define DRAW_STEP 0.0001	// draw rate, numerical derivatives of the probabilities
+#define CG_TOLERANCE 1e-6	// residual relative to b
+#define CG_MAX_ITER 10000	// not reached unless the games do not define the ratings
+#define CG_VECTORS 4		// work of a solve, in blocks of vectors
+#define CG_BLOCK 8			// right hand sides solved together
+
+struct CTERM {
+	ptrdiff_t	p[3];	// parameters, NOPARAM if not present
+	double		c[3];	// coefficients
+	double		h;		// weight in the curvature
+	double		m;		// weight in the variance of the equations
+};
+
+struct CSOLVE {
+	ptrdiff_t		np;
+	ptrdiff_t		nq;			// length of the vectors, np and the ground if sparse
+	ptrdiff_t		pwa;		// white advantage, NOPARAM if not adjusted
+	ptrdiff_t		ground;		// sparse, unknown of the player fixed to solve, or NOPARAM
+	ptrdiff_t *		idx;		// parameter of each player, NOPARAM if fixed or flagged
+	const bool_t *	flagged;	// out of the fit
+	player_t		notflagged;
+	bool_t			centered;	// relative to the average
+	bool_t			sandwich;	// M != H
+	double *		a;			// dense, inverse of the curvature, np x np, NULL if sparse
+	double *		pdiag;		// sparse, diagonal of the curvature, NULL if dense
+	ptrdiff_t *		rowstart;	// sparse, nq+1, entries of each row of H and M
+	ptrdiff_t *		col;		// sparse, column of each entry
+	double *		hval;		// sparse, H
+	double *		mval;		// sparse, M, NULL if M == H
+	struct CTERM *	term;		// dense, terms of M, NULL if M == H
+	ptrdiff_t		term_n;
+	double *		brow;		// np, a row of A M
+	ptrdiff_t		brow_i;		// parameter of brow, NOPARAM if not built yet
+	double *		vdiag;		// np
+	double *		rowmean;	// np, covariance with the average
+	double			cbar;		// variance of the average
+	double *		g;			// 3 per encounter, NULL if not needed
+};
+
+static void
+cterm_set (struct CTERM *t, ptrdiff_t a, double ca, ptrdiff_t b, double cb, ptrdiff_t w, double cw, double h, double m)
+{
+	t->p[0] = a; t->c[0] = ca;
+	t->p[1] = b; t->c[1] = cb;
+	t->p[2] = w; t->c[2] = cw;
+	t->h = h;
+	t->m = m;
+}
+
+static double
+sq (double x) 
+{
+	return x * x;
+}
+
+// curvature and variance of the equations for n games, rating difference delta,
+// and the derivative of the equation with each result (win, draw, loss)
+static void
+enc_weights (bool_t ml, double delta, double n, double deq, double beta, double *h, double *m, double *g /*@out@*/)
+{
+	double p[3], p1[3], p2[3];
+	double f, mean, var;
+	int k;
+
+	get_pWDL (delta, &p[0], &p[1], &p[2], deq, beta);
+	f = xpect (delta, 0, beta);
+
+	if (ml) {
+		get_pWDL (delta - DELTA_STEP, &p1[0], &p1[1], &p1[2], deq, beta);
+		get_pWDL (delta + DELTA_STEP, &p2[0], &p2[1], &p2[2], deq, beta);
+		for (k = 0; k < 3; k++) {
+			g[k] = p[k] > 0? (p2[k] - p1[k]) / (2*DELTA_STEP) / p[k]: 0;
+		}
+	} else {
+		// expected score matches the score obtained
+		g[0] = 1 - f;
+		g[1] = 0.5 - f;
+		g[2] = -f;
+	}
+
+	for (mean = 0, k = 0; k < 3; k++) mean += p[k] * g[k];
+	for (var = 0, k = 0; k < 3; k++) var += p[k] * sq(g[k] - mean);
+	*m = n * var;
+	*h = ml? *m: n * beta * f * (1 - f);
+}
+
+// in place, symmetric positive definite a (n x n) is replaced by its inverse
+static bool_t
+chol_inverse (double *a, ptrdiff_t n)
+{
+	ptrdiff_t i, j, k;
+	double *ri, *rj, *acc;
+	double s, x;
+
+	// Cholesky, lower triangle: a = L L'
+	for (i = 0; i < n; i++) {
+		ri = a + i*n;
+		for (j = 0; j <= i; j++) {
+			rj = a + j*n;
+			for (s = ri[j], k = 0; k < j; k++) {
+				s -= ri[k] * rj[k];
+			}
+			if (j < i) {
+				ri[j] = s / rj[j];
+			} else {
+				if (!(s > 0)) return FALSE;
+				ri[i] = sqrt (s);
+			}
+		}
+	}
+
+	if (NULL == (acc = memnew (sizeof(double) * (size_t)(n + 1)))) 
+		return FALSE;
+
+	// inverse of L, row by row, still lower triangular
+	for (i = 0; i < n; i++) {
+		ri = a + i*n;
+		for (j = 0; j < i; j++) acc[j] = 0;
+		for (k = 0; k < i; k++) {
+			rj = a + k*n;
+			x = ri[k];
+			for (j = 0; j <= k; j++) {
+				acc[j] += x * rj[j];
+			}
+		}
+		for (j = 0; j < i; j++) ri[j] = -acc[j] / ri[i];
+		ri[i] = 1 / ri[i];
+	}
+
+	// inverse of a = inv(L)' inv(L)
+	for (i = 0; i < n; i++) {
+		for (j = 0; j <= i; j++) acc[j] = 0;
+		for (k = i; k < n; k++) {
+			rj = a + k*n;
+			x = rj[i];
+			for (j = 0; j <= i; j++) {
+				acc[j] += x * rj[j];
+			}
+		}
+		ri = a + i*n;
+		for (j = 0; j <= i; j++) ri[j] = acc[j];
+	}
+	memrel (acc);
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i; j++) {
+			a[j*n+i] = a[i*n+j];
+		}
+	}
+	return TRUE;
+}
+
+static double
+dot (const double *x, const double *y, ptrdiff_t n)
+{
+	ptrdiff_t k;
+	double s = 0;
+	for (k = 0; k < n; k++) s += x[k] * y[k];
+	return s;
+}
+
+// row i of A M, from the terms of M
+static void
+sandwich_row (const double *a, ptrdiff_t np, const struct CTERM *term, ptrdiff_t term_n, ptrdiff_t i, double *bi /*@out@*/)
+{
+	ptrdiff_t t, x;
+	const double *ai = a + i*np;
+	double s;
+
+	for (x = 0; x < np; x++) bi[x] = 0;
+	for (t = 0; t < term_n; t++) {
+		if (term[t].m == 0) continue;
+		for (s = 0, x = 0; x < 3; x++) {
+			if (term[t].p[x] != NOPARAM) s += ai[term[t].p[x]] * term[t].c[x];
+		}
+		if (s == 0) continue;
+		s *= term[t].m;
+		for (x = 0; x < 3; x++) {
+			if (term[t].p[x] != NOPARAM) bi[term[t].p[x]] += s * term[t].c[x];
+		}
+	}
+}
+
+// the last row of A M is kept, callers go through the covariances row by row
+static double
+covar_get (struct CSOLVE *cs, ptrdiff_t i, ptrdiff_t j)
+{
+	ptrdiff_t x;
+	if (i == NOPARAM || j == NOPARAM)
+		return 0;
+	if (NULL == cs->term)
+		return cs->a[i*cs->np+j];
+	if (cs->brow_i == j) {
+		x = i; i = j; j = x; // symmetric
+	} else if (cs->brow_i != i) {
+		sandwich_row (cs->a, cs->np, cs->term, cs->term_n, i, cs->brow);
+		cs->brow_i = i;
+	}
+	return dot (cs->brow, cs->a + j*cs->np, cs->np);
+}
+
+//---------------------------------- sparse
+
+/*
+|	The solves go in blocks of nb right hand sides (up to CG_BLOCK), each
+|	one an independent conjugate gradient. A block of vectors of length nq
+|	is stored by rows, v[i*nb+k] being entry i of vector k, so that one pass
+|	over the terms serves the whole block.
+*/
+
+// y = H x, or M x if not curvature
+static void
+sparse_product (const struct CSOLVE *cs, bool_t curvature, int nb, const double *x, double *y /*@out@*/)
+{
+	const double *val = curvature || NULL == cs->mval? cs->hval: cs->mval;
+	const double *xj;
+	double acc[CG_BLOCK], h;
+	ptrdiff_t i, e;
+	int v;
+
+	for (i = 0; i < cs->nq; i++) {
+		for (v = 0; v < nb; v++) acc[v] = 0;
+		for (e = cs->rowstart[i]; e < cs->rowstart[i+1]; e++) {
+			h = val[e];
+			xj = x + cs->col[e] * nb;
+			for (v = 0; v < nb; v++) acc[v] += h * xj[v];
+		}
+		for (v = 0; v < nb; v++) y[i*nb+v] = acc[v];
+	}
+}
+
+// d[k] = sum over i of x[i*nb+k] * y[i*nb+k]
+static void
+block_dot (const double *x, const double *y, ptrdiff_t nq, int nb, double *d /*@out@*/)
+{
+	ptrdiff_t i;
+	int v;
+	for (v = 0; v < nb; v++) d[v] = 0;
+	for (i = 0; i < nq; i++) {
+		for (v = 0; v < nb; v++) d[v] += x[i*nb+v] * y[i*nb+v];
+	}
+}
+
+// x = A b, for a block of nb vectors. The ground of b is not used.
+// Returns FALSE if one of them does not converge.
+static bool_t
+cg_solve (const struct CSOLVE *cs, int nb, const double *b, double *x /*@out@*/, double *work /* CG_VECTORS blocks */)
+{
+	ptrdiff_t nq = cs->nq, n = nq * nb, i, iv;
+	double *r = work, *z = work + n, *p = work + 2*n, *q = work + 3*n;
+	double rz[CG_BLOCK], rz2[CG_BLOCK], pq[CG_BLOCK], rr[CG_BLOCK], bnorm[CG_BLOCK], alpha[CG_BLOCK], beta[CG_BLOCK], sum[CG_BLOCK];
+	bool_t active[CG_BLOCK];
+	int v, nactive;
+	long it;
+
+	for (i = 0; i < n; i++) {
+		r[i] = b[i];
+		x[i] = 0;
+	}
+	if (cs->ground != NOPARAM) {
+		// orthogonal to the ratings moving together
+		for (v = 0; v < nb; v++) sum[v] = 0;
+		for (i = 0; i < nq; i++) {
+			if (i == cs->pwa || i == cs->ground) continue;
+			for (v = 0; v < nb; v++) sum[v] += r[i*nb+v];
+		}
+		for (v = 0; v < nb; v++) r[cs->ground*nb+v] = -sum[v];
+	}
+
+	block_dot (r, r, nq, nb, bnorm);
+	for (nactive = 0, v = 0; v < nb; v++) {
+		bnorm[v] = sqrt (bnorm[v]);
+		active[v] = bnorm[v] > 0;
+		if (active[v]) nactive++;
+	}
+
+	for (i = 0; i < nq; i++) {
+		for (iv = i*nb, v = 0; v < nb; v++, iv++) p[iv] = z[iv] = r[iv] / cs->pdiag[i];
+	}
+	block_dot (r, z, nq, nb, rz);
+
+	for (it = 0; it < CG_MAX_ITER && nactive > 0; it++) {
+		sparse_product (cs, TRUE, nb, p, q);
+		block_dot (p, q, nq, nb, pq);
+		for (v = 0; v < nb; v++) {
+			alpha[v] = 0;
+			if (!active[v]) continue;
+			if (!(pq[v] > 0)) return FALSE;
+			alpha[v] = rz[v] / pq[v];
+		}
+		for (i = 0; i < nq; i++) {
+			for (iv = i*nb, v = 0; v < nb; v++, iv++) {
+				x[iv] += alpha[v] * p[iv];
+				r[iv] -= alpha[v] * q[iv];
+			}
+		}
+		block_dot (r, r, nq, nb, rr);
+		for (v = 0; v < nb; v++) {
+			if (active[v] && sqrt (rr[v]) <= CG_TOLERANCE * bnorm[v]) {
+				active[v] = FALSE;
+				nactive--;
+			}
+		}
+		for (i = 0; i < nq; i++) {
+			for (iv = i*nb, v = 0; v < nb; v++, iv++) z[iv] = r[iv] / cs->pdiag[i];
+		}
+		block_dot (r, z, nq, nb, rz2);
+		for (v = 0; v < nb; v++) {
+			beta[v] = active[v]? rz2[v] / rz[v]: 0;
+			rz[v] = rz2[v];
+		}
+		for (i = 0; i < nq; i++) {
+			for (iv = i*nb, v = 0; v < nb; v++, iv++) p[iv] = active[v]? z[iv] + beta[v] * p[iv]: 0;
+		}
+	}
+
+	if (cs->ground != NOPARAM) {
+		for (v = 0; v < nb; v++) sum[v] = x[cs->ground*nb+v];
+		for (i = 0; i < nq; i++) {
+			if (i == cs->pwa) continue;
+			for (v = 0; v < nb; v++) x[i*nb+v] -= sum[v];
+		}
+	}
+	return 0 == nactive;
+}
+
+// x = A b, then the variances b' A M A b, for a block
+static bool_t
+cg_variance (const struct CSOLVE *cs, int nb, const double *b, double *x /*@out@*/, double *var /*@out@*/, double *work /* CG_VECTORS+1 blocks */)
+{
+	double *y = work + CG_VECTORS * cs->nq * nb;
+	if (!cg_solve (cs, nb, b, x, work))
+		return FALSE;
+	if (cs->sandwich) {
+		sparse_product (cs, FALSE, nb, x, y);
+		block_dot (x, y, cs->nq, nb, var);
+	} else {
+		block_dot (b, x, cs->nq, nb, var);
+	}
+	return TRUE;
+}
+
+static double
+drawrate_sdev (bool_t ml, const struct ENCOUNTERS *enc, const double *ratingof, double white_advantage
+				, double deq, double beta, struct prior dr_prior)
+{
+	gamesnum_t e;
+	double lo, hi, n, dd, delta;
+	double pw, pd, pl, w1, d1, l1, w2, d2, l2;
+	double info = 0, num = 0, den = 0;
+
+	lo = deq - DRAW_STEP > 0? deq - DRAW_STEP: deq;
+	hi = deq + DRAW_STEP < 1? deq + DRAW_STEP: deq;
+	if (!(hi > lo)) return 0;
+
+	for (e = 0; e < enc->n; e++) {
+		n = (double)(enc->enc[e].W + enc->enc[e].D + enc->enc[e].L);
+		delta = ratingof[enc->enc[e].wh] + white_advantage - ratingof[enc->enc[e].bl];
+		get_pWDL (delta, &pw, &pd, &pl, deq, beta);
+		get_pWDL (delta, &w1, &d1, &l1, lo, beta);
+		get_pWDL (delta, &w2, &d2, &l2, hi, beta);
+		dd = (d2 - d1) / (hi - lo);
+		if (ml) {
+			// the score does not change with the draw rate, pw and pl move -dd/2 each
+			if (pd > 0) info += n * dd * dd / pd;
+			if (pw > 0) info += n * dd * dd / (4*pw);
+			if (pl > 0) info += n * dd * dd / (4*pl);
+		} else {
+			// draws expected match the draws obtained
+			num += n * pd * (1 - pd);
+			den += n * dd;
+		}
+	}
+
+	if (ml) {
+		if (dr_prior.isset && dr_prior.sigma > 0)
+			info += 1 / sq(dr_prior.sigma);
+		return info > 0? 1 / sqrt (info): 0;
+	}
+	return den != 0? sqrt (num) / fabs (den): 0;
+}
+
+static void
+csolve_init (struct CSOLVE *cs)
+{
+	cs->np = 0;
+	cs->nq = 0;
+	cs->pwa = NOPARAM;
+	cs->ground = NOPARAM;
+	cs->idx = NULL;
+	cs->flagged = NULL;
+	cs->notflagged = 0;
+	cs->centered = FALSE;
+	cs->sandwich = FALSE;
+	cs->a = NULL;
+	cs->pdiag = NULL;
+	cs->rowstart = NULL;
+	cs->col = NULL;
+	cs->hval = NULL;
+	cs->mval = NULL;
+	cs->term = NULL;
+	cs->term_n = 0;
+	cs->brow = NULL;
+	cs->brow_i = NOPARAM;
+	cs->vdiag = NULL;
+	cs->rowmean = NULL;
+	cs->cbar = 0;
+	cs->g = NULL;
+}
+
+static void
+csolve_done (struct CSOLVE *cs)
+{
+	if (cs->g) 			memrel (cs->g);
+	if (cs->rowmean) 	memrel (cs->rowmean);
+	if (cs->vdiag) 		memrel (cs->vdiag);
+	if (cs->brow) 		memrel (cs->brow);
+	if (cs->term) 		memrel (cs->term);
+	if (cs->pdiag) 		memrel (cs->pdiag);
+	if (cs->rowstart) 	memrel (cs->rowstart);
+	if (cs->col) 		memrel (cs->col);
+	if (cs->hval) 		memrel (cs->hval);
+	if (cs->mval) 		memrel (cs->mval);
+	if (cs->a) 			memrel (cs->a);
+	if (cs->idx) 		memrel (cs->idx);
+	csolve_init (cs);
+}
+
+static double
+player_var (const struct CSOLVE *cs, player_t j)
+{
+	ptrdiff_t i = cs->idx[j];
+	double var;
+	if (cs->flagged[j])
+		return 0;
+	var = i == NOPARAM? 0: cs->vdiag[i];
+	if (cs->centered)
+		var += cs->cbar - (i == NOPARAM? 0: 2 * cs->rowmean[i]);
+	return var;
+}
+
+static double
+pair_var_cov (const struct CSOLVE *cs, player_t a, player_t b, double cov)
+{
+	ptrdiff_t ia = cs->idx[a], ib = cs->idx[b];
+	if (cs->flagged[a] || cs->flagged[b])
+		return player_var (cs, a) + player_var (cs, b);
+	// differences do not depend on the average
+	return (ia == NOPARAM? 0: cs->vdiag[ia]) + (ib == NOPARAM? 0: cs->vdiag[ib]) - 2 * cov;
+}
+
+static double
+pair_var (struct CSOLVE *cs, player_t a, player_t b)
+{
+	if (cs->flagged[a] || cs->flagged[b])
+		return pair_var_cov (cs, a, b, 0);
+	return pair_var_cov (cs, a, b, covar_get (cs, cs->idx[a], cs->idx[b]));
+}
+
+static double
+var2sdev (double var)
+{
+	return var > 0? sqrt (var): 0;
+}
+
+//---------------------------------- sparse jobs, a block of solves each
+
+enum CJOB {CJOB_VDIAG, CJOB_TABLE, CJOB_LIST};
+
+#define CJOB_VECTORS (CG_VECTORS + 4)	// blocks of vectors
+
+struct CJOBS {
+	struct CSOLVE *		cs;
+	struct summations *	sm;
+	enum CJOB			kind;
+	long				n;		// items, CG_BLOCK per job
+	myatomic_t			next;
+	myatomic_t			failed;
+};
+
+static bool_t
+cjob_do (struct CSOLVE *cs, struct summations *sm, enum CJOB kind, long n, long r0, double *work /* CJOB_VECTORS blocks */)
+{
+	ptrdiff_t nq = cs->nq, i, k, r, ia, ib;
+	double *b = work, *x = work + nq*CG_BLOCK, *row = work + 2*nq*CG_BLOCK, *w = work + 3*nq*CG_BLOCK;
+	double var[CG_BLOCK], cov;
+	bool_t row_set[CG_BLOCK];
+	player_t a, c;
+	int nb, v;
+
+	nb = n - r0 < CG_BLOCK? (int)(n - r0): CG_BLOCK;
+	for (i = 0; i < nq * nb; i++) b[i] = 0;
+
+	switch (kind) {
+		case CJOB_VDIAG:
+			for (v = 0; v < nb; v++) b[(r0+v)*nb+v] = 1;
+			if (!cg_variance (cs, nb, b, x, var, w))
+				return FALSE;
+			for (v = 0; v < nb; v++) cs->vdiag[r0+v] = var[v];
+			break;
+
+		case CJOB_LIST:
+			for (v = 0; v < nb; v++) {
+				a = sm->pair[r0+v].a;
+				c = sm->pair[r0+v].b;
+				if (cs->flagged[a] || cs->flagged[c]) continue;
+				ia = cs->idx[a];
+				ib = cs->idx[c];
+				if (ia != NOPARAM) b[ia*nb+v] += 1;
+				if (ib != NOPARAM) b[ib*nb+v] -= 1;
+			}
+			if (!cg_variance (cs, nb, b, x, var, w))
+				return FALSE;
+			for (v = 0; v < nb; v++) {
+				a = sm->pair[r0+v].a;
+				c = sm->pair[r0+v].b;
+				if (cs->flagged[a] || cs->flagged[c]) 
+					var[v] = pair_var_cov (cs, a, c, 0);
+				sm->relative[r0+v].sdev = var2sdev (var[v]);
+			}
+			break;
+
+		case CJOB_TABLE:
+			// rows of the table, with the players before each of them
+			for (v = 0; v < nb; v++) {
+				r = r0 + v;
+				a = sm->table[r];
+				ia = cs->idx[a];
+				row_set[v] = r > 0 && !cs->flagged[a] && ia != NOPARAM;
+				if (row_set[v]) b[ia*nb+v] = 1;
+			}
+			if (!cg_solve (cs, nb, b, x, w))
+				return FALSE;
+			if (cs->sandwich) {
+				sparse_product (cs, FALSE, nb, x, b);
+				if (!cg_solve (cs, nb, b, row, w))
+					return FALSE;
+			} else {
+				for (i = 0; i < nq * nb; i++) row[i] = x[i];
+			}
+			for (v = 0; v < nb; v++) {
+				r = r0 + v;
+				a = sm->table[r];
+				for (k = 0; k < r; k++) {
+					c = sm->table[k];
+					ib = cs->idx[c];
+					cov = row_set[v] && ib != NOPARAM && !cs->flagged[c]? row[ib*nb+v]: 0;
+					sm->relative[(r*r-r)/2 + k].sdev = var2sdev (pair_var_cov (cs, a, c, cov));
+				}
+			}
+			break;
+	}
+	return TRUE;
+}
+
+static thread_return_t THREAD_CALL
+cjobs_process (void *p)
+{
+	struct CJOBS *t = p;
+	double *work;
+	long r;
+
+	if (NULL == (work = memnew (sizeof(double) * (size_t)(CJOB_VECTORS * CG_BLOCK * t->cs->nq)))) {
+		mythread_atomic_set (&t->failed, 1);
+	} else {
+		while (0 == mythread_atomic_get (&t->failed) && (r = mythread_atomic_add (&t->next, 1)) * CG_BLOCK < t->n) {
+			if (!cjob_do (t->cs, t->sm, t->kind, t->n, r * CG_BLOCK, work))
+				mythread_atomic_set (&t->failed, 1);
+		}
+		memrel (work);
+	}
+
+	mythread_exit ();
+	return (thread_return_t) 0;
+}
+
+// Returns FALSE if there is not enough memory, or a solve does not converge.
+static bool_t
+cjobs_run (struct CSOLVE *cs, struct summations *sm, enum CJOB kind, long n, int cpus)
+{
+	struct CJOBS jobs;
+	mythread_t *threadid;
+	int *err;
+	int t;
+
+	if (n < 1) return TRUE;
+	if (cpus < 1) cpus = 1;
+	if ((long)cpus > (n + CG_BLOCK - 1) / CG_BLOCK) cpus = (int)((n + CG_BLOCK - 1) / CG_BLOCK);
+
+	jobs.cs = cs;
+	jobs.sm = sm;
+	jobs.kind = kind;
+	jobs.n = n;
+	mythread_atomic_set (&jobs.next, 0);
+	mythread_atomic_set (&jobs.failed, 0);
+
+	threadid = memnew (sizeof(mythread_t) * (size_t)cpus);
+	err = memnew (sizeof(int) * (size_t)cpus);
+	if (NULL == threadid || NULL == err) {
+		if (threadid) memrel (threadid);
+		if (err) memrel (err);
+		return FALSE;
+	}
+	for (t = 0; t < cpus; t++) {
+		if (!mythread_create (&threadid[t], cjobs_process, &jobs, &err[t])) {
+			fprintf (stderr, "thread %d, fatal error at creating: %s\n", t, mythread_create_error(err[t]));
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t = 0; t < cpus; t++) {
+		if (0 == mythread_join (threadid[t])) {
+			fprintf (stderr, "thread %d: fatal problems at joining\n", t);
+			exit(EXIT_FAILURE);
+		}
+	}
+	memrel (err);
+	memrel (threadid);
+	return 0 == mythread_atomic_get (&jobs.failed);
+}
+
+//---------------------------------- build
+
+// covariance of every parameter with the average, C 1 / n, with C = A M A
+static bool_t
+csolve_center (struct CSOLVE *cs)
+{
+	ptrdiff_t i, t, x, np = cs->np, nq = cs->nq;
+	const struct CTERM *term = cs->term;
+	double *v, *w, *work;
+	double s;
+	bool_t ok;
+
+	cs->cbar = 0;
+	for (i = 0; i < np; i++) cs->rowmean[i] = 0;
+	if (!cs->centered)
+		return TRUE;
+
+	if (NULL == cs->a) {
+		// sparse, A 1 then A M A 1
+		if (NULL == (work = memnew (sizeof(double) * (size_t)((CG_VECTORS + 2) * nq))))
+			return FALSE;
+		v = work + CG_VECTORS * nq;
+		w = v + nq;
+		for (i = 0; i < nq; i++) v[i] = i == cs->pwa || i == cs->ground? 0: 1;
+		ok = cg_solve (cs, 1, v, w, work);
+		if (ok && cs->sandwich) {
+			sparse_product (cs, FALSE, 1, w, v);
+			ok = cg_solve (cs, 1, v, w, work);
+		}
+		for (i = 0; i < np; i++) cs->rowmean[i] = w[i] / (double)cs->notflagged;
+		memrel (work);
+		if (!ok)
+			return FALSE;
+	} else {
+		if (NULL == (v = memnew (sizeof(double) * (size_t)(np + 1))))
+			return FALSE;
+
+		for (i = 0; i < np; i++) v[i] = i == cs->pwa? 0: 1;
+		if (NULL != term) {
+			if (NULL == (w = memnew (sizeof(double) * (size_t)(np + 1)))) {
+				memrel (v);
+				return FALSE;
+			}
+			// A M A 1, from right to left
+			for (i = 0; i < np; i++) w[i] = dot (cs->a + i*np, v, np);
+			for (i = 0; i < np; i++) v[i] = 0;
+			for (t = 0; t < cs->term_n; t++) {
+				if (term[t].m == 0) continue;
+				for (s = 0, x = 0; x < 3; x++) {
+					if (term[t].p[x] != NOPARAM) s += w[term[t].p[x]] * term[t].c[x];
+				}
+				s *= term[t].m;
+				for (x = 0; x < 3; x++) {
+					if (term[t].p[x] != NOPARAM) v[term[t].p[x]] += s * term[t].c[x];
+				}
+			}
+			for (i = 0; i < np; i++) cs->rowmean[i] = dot (cs->a + i*np, v, np) / (double)cs->notflagged;
+			memrel (w);
+		} else {
+			for (i = 0; i < np; i++) cs->rowmean[i] = dot (cs->a + i*np, v, np) / (double)cs->notflagged;
+		}
+		memrel (v);
+	}
+
+	for (i = 0; i < np; i++) {
+		if (i != cs->pwa) cs->cbar += cs->rowmean[i];
+	}
+	cs->cbar /= (double)cs->notflagged;
+	return TRUE;
+}
+
+// Rows of H and M from the terms, merging the entries of the same pair of
+// unknowns, with the diagonal of H for the preconditioner.
+static bool_t
+csolve_sparse (struct CSOLVE *cs, const struct CTERM *term, ptrdiff_t term_n)
+{
+	ptrdiff_t nq = cs->nq, nnz, i, j, k, t, e, x;
+	ptrdiff_t *tstart, *tlist, *mark, *pos;
+	double ci;
+	bool_t ok;
+
+	// terms of each unknown
+	tstart	= memnew (sizeof(ptrdiff_t) * (size_t)(nq + 1));
+	tlist	= memnew (sizeof(ptrdiff_t) * (size_t)(3 * term_n + 1));
+	mark	= memnew (sizeof(ptrdiff_t) * (size_t)(nq + 1));
+	pos		= memnew (sizeof(ptrdiff_t) * (size_t)(nq + 1));
+	cs->rowstart = memnew (sizeof(ptrdiff_t) * (size_t)(nq + 1));
+	ok = NULL != tstart && NULL != tlist && NULL != mark && NULL != pos && NULL != cs->rowstart;
+
+	if (ok) {
+		for (i = 0; i <= nq; i++) tstart[i] = 0;
+		for (t = 0; t < term_n; t++) {
+			for (x = 0; x < 3; x++) {
+				if (term[t].p[x] != NOPARAM) tstart[term[t].p[x] + 1]++;
+			}
+		}
+		for (i = 0; i < nq; i++) tstart[i+1] += tstart[i];
+		for (i = 0; i < nq; i++) pos[i] = tstart[i];
+		for (t = 0; t < term_n; t++) {
+			for (x = 0; x < 3; x++) {
+				if (term[t].p[x] != NOPARAM) tlist[pos[term[t].p[x]]++] = t;
+			}
+		}
+
+		// pattern
+		for (i = 0; i < nq; i++) mark[i] = NOPARAM;
+		for (nnz = 0, i = 0; i < nq; i++) {
+			cs->rowstart[i] = nnz;
+			for (k = tstart[i]; k < tstart[i+1]; k++) {
+				t = tlist[k];
+				for (x = 0; x < 3; x++) {
+					j = term[t].p[x];
+					if (j != NOPARAM && mark[j] != i) {
+						mark[j] = i;
+						nnz++;
+					}
+				}
+			}
+		}
+		cs->rowstart[nq] = nnz;
+
+		cs->col  = memnew (sizeof(ptrdiff_t) * (size_t)(nnz + 1));
+		cs->hval = memnew (sizeof(double) * (size_t)(nnz + 1));
+		if (cs->sandwich)
+			cs->mval = memnew (sizeof(double) * (size_t)(nnz + 1));
+		ok = NULL != cs->col && NULL != cs->hval && (!cs->sandwich || NULL != cs->mval);
+	}
+
+	if (ok) {
+		for (i = 0; i < nq; i++) mark[i] = NOPARAM;
+		for (e = 0, i = 0; i < nq; i++) {
+			for (k = tstart[i]; k < tstart[i+1]; k++) {
+				t = tlist[k];
+				for (ci = 0, x = 0; x < 3; x++) {
+					if (term[t].p[x] == i) ci += term[t].c[x];
+				}
+				for (x = 0; x < 3; x++) {
+					j = term[t].p[x];
+					if (j == NOPARAM) continue;
+					if (mark[j] != i) {
+						mark[j] = i;
+						pos[j] = e;
+						cs->col[e] = j;
+						cs->hval[e] = 0;
+						if (cs->mval) cs->mval[e] = 0;
+						e++;
+					}
+					cs->hval[pos[j]] += term[t].h * ci * term[t].c[x];
+					if (cs->mval) cs->mval[pos[j]] += term[t].m * ci * term[t].c[x];
+				}
+			}
+			cs->pdiag[i] = mark[i] == i? cs->hval[pos[i]]: 0;
+		}
+	}
+
+	if (tstart)	memrel (tstart);
+	if (tlist)	memrel (tlist);
+	if (mark)	memrel (mark);
+	if (pos)	memrel (pos);
+	return ok;
+}
+
+// unknown of player j in the terms, the fixed player is one in the sparse system
+static ptrdiff_t
+term_param (const struct CSOLVE *cs, player_t fixed, player_t j)
+{
+	return j == fixed && cs->ground != NOPARAM? cs->ground: cs->idx[j];
+}
+
+// Returns FALSE if there is not enough memory, or the curvature cannot be
+// inverted (the games do not define the ratings). Encounters with flagged
+// players are skipped, flagged being the players out of the fit.
+static bool_t
+csolve_build	( struct CSOLVE *				cs		/*@out@*/
+				, int							cpus
+				, bool_t						ml
+				, bool_t						adjust_white_advantage
+				, bool_t						anchor_err_rel2avg
+				, double						beta
+				, double						white_advantage
+				, double						drawrate_evenmatch
+				, player_t						priored_n
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps
+				, struct prior					wa_prior
+				, const struct ENCOUNTERS *		enc
+				, const struct PLAYERS *		plyrs
+				, const bool_t *				flagged
+				, const double *				ratingof
+				, bool_t						keep_g
+				)
+{
+	player_t n = plyrs->n;
+	player_t j, fixed = -1;
+	ptrdiff_t np, term_n, term_max, i, k, x, y;
+	gamesnum_t e;
+	bool_t free_average, dense, ok;
+	double h, m, g[3];
+	struct CTERM *term;
+	const struct ENC *pe;
+
+	csolve_init (cs);
+
+	// without any anchor, only the differences are defined
+	free_average = 0 == plyrs->anchored_n && !(ml && priored_n > 0);
+	cs->centered = free_average || anchor_err_rel2avg;
+	cs->flagged = flagged;
+
+	if (NULL == (cs->idx = memnew (sizeof(ptrdiff_t) * (size_t)(n + 1))))
+		return FALSE;
+
+	for (np = 0, j = 0; j < n; j++) {
+		if (!flagged[j]) cs->notflagged++;
+		if (flagged[j] || plyrs->prefed[j]) {
+			cs->idx[j] = NOPARAM;
+		} else if (free_average && 1 == cs->notflagged) {
+			// with a free average, the first player is fixed to solve
+			cs->idx[j] = NOPARAM;
+			fixed = j;
+		} else {
+			cs->idx[j] = np++;
+		}
+	}
+	if (adjust_white_advantage)
+		cs->pwa = np++; // last parameter
+	cs->np = np;
+
+	dense = np <= COVAR_DENSE_MAX_PARAMS;
+	if (!dense && fixed != -1)
+		cs->ground = np;
+	cs->nq = cs->ground == NOPARAM? np: np + 1;
+
+	if (0 == cs->notflagged) {
+		csolve_done (cs);
+		return FALSE;
+	}
+
+	term_max = enc->n + n + (ml? rps->n: 0) + 1;
+	term		= memnew (sizeof(struct CTERM) * (size_t)term_max);
+	if (dense)
+		cs->a	= memnew (sizeof(double) * (size_t)(np * np + 1));
+	else
+		cs->pdiag = memnew (sizeof(double) * (size_t)(cs->nq + 1));
+	cs->vdiag	= memnew (sizeof(double) * (size_t)(np + 1));
+	cs->rowmean	= memnew (sizeof(double) * (size_t)(np + 1));
+	if (keep_g)
+		cs->g	= memnew (sizeof(double) * (size_t)(3 * enc->n + 1));
+
+	if (NULL == term || (dense? NULL == cs->a: NULL == cs->pdiag) || NULL == cs->vdiag || NULL == cs->rowmean
+		|| (keep_g && NULL == cs->g)) {
+		if (term) memrel (term);
+		csolve_done (cs);
+		return FALSE;
+	}
+
+	// terms of the encounters and priors
+	term_n = 0;
+	for (e = 0; e < enc->n; e++) {
+		pe = &enc->enc[e];
+		if (flagged[pe->wh] || flagged[pe->bl]) {
+			g[0] = g[1] = g[2] = 0;
+		} else {
+			enc_weights (ml, ratingof[pe->wh] + white_advantage - ratingof[pe->bl]
+						, (double)(pe->W + pe->D + pe->L), drawrate_evenmatch, beta, &h, &m, g);
+			cterm_set (&term[term_n++], term_param (cs, fixed, pe->wh), 1, term_param (cs, fixed, pe->bl), -1, cs->pwa, 1, h, m);
+		}
+		if (keep_g) {
+			for (x = 0; x < 3; x++) cs->g[3*e+x] = g[x];
+		}
+	}
+	if (ml) {
+		for (j = 0; j < n && NULL != pp; j++) {
+			if (pp[j].isset && pp[j].sigma > 0 && cs->idx[j] != NOPARAM) {
+				h = 1 / sq(pp[j].sigma);
+				cterm_set (&term[term_n++], cs->idx[j], 1, NOPARAM, 0, NOPARAM, 0, h, h);
+			}
+		}
+		for (i = 0; i < rps->n; i++) {
+			if (rps->x[i].sigma > 0) {
+				h = 1 / sq(rps->x[i].sigma);
+				cterm_set (&term[term_n++], term_param (cs, fixed, rps->x[i].player_a), 1
+										  , term_param (cs, fixed, rps->x[i].player_b), -1, NOPARAM, 0, h, h);
+			}
+		}
+		if (cs->pwa != NOPARAM && wa_prior.isset && wa_prior.sigma > 0) {
+			h = 1 / sq(wa_prior.sigma);
+			cterm_set (&term[term_n++], cs->pwa, 1, NOPARAM, 0, NOPARAM, 0, h, 0);
+		}
+	}
+	for (k = 0; k < term_n; k++) {
+		if (term[k].m != term[k].h) cs->sandwich = TRUE;
+	}
+
+	if (!dense) {
+		ok = csolve_sparse (cs, term, term_n);
+		memrel (term);
+		for (i = 0; ok && i < cs->nq; i++) {
+			if (!(cs->pdiag[i] > 0)) ok = FALSE;
+		}
+		ok = ok && csolve_center (cs) && cjobs_run (cs, NULL, CJOB_VDIAG, (long)np, cpus);
+		if (!ok)
+			csolve_done (cs);
+		return ok;
+	}
+
+	// curvature, then its inverse
+	for (i = 0; i < np * np; i++) cs->a[i] = 0;
+	for (k = 0; k < term_n; k++) {
+		for (x = 0; x < 3; x++) {
+			if (term[k].p[x] == NOPARAM) continue;
+			for (y = 0; y < 3; y++) {
+				if (term[k].p[y] == NOPARAM) continue;
+				cs->a[term[k].p[x]*np + term[k].p[y]] += term[k].h * term[k].c[x] * term[k].c[y];
+			}
+		}
+	}
+	ok = chol_inverse (cs->a, np);
+
+	// sandwich, unless the ratings maximize the likelihood
+	if (ok && cs->sandwich) {
+		cs->term	= term;
+		cs->term_n	= term_n;
+		if (NULL == (cs->brow = memnew (sizeof(double) * (size_t)(np + 1))))
+			ok = FALSE;
+	} else {
+		memrel (term);
+	}
+
+	if (ok) {
+		for (i = 0; i < np; i++) {
+			cs->vdiag[i] = covar_get (cs, i, i);
+		}
+		ok = csolve_center (cs);
+	}
+	if (!ok)
+		csolve_done (cs);
+	return ok;
+}
+
+// standard deviations of the players, the pairs in scope and the white advantage
+static bool_t
+csolve_sdev (struct CSOLVE *cs, int cpus, struct summations *sm /*@out@*/)
+{
+	ptrdiff_t i, k;
+	player_t j;
+
+	for (j = 0; j < sm->nplayers; j++) {
+		sm->sdev[j] = var2sdev (player_var (cs, j));
+	}
+	sm->wa_sdev = cs->pwa == NOPARAM? 0: var2sdev (cs->vdiag[cs->pwa]);
+
+	if (NULL == cs->a) {
+		if (sm->pairmode == PAIRS_TABLE)
+			return cjobs_run (cs, sm, CJOB_TABLE, (long)sm->table_n, cpus);
+		if (sm->pairmode == PAIRS_LIST)
+			return cjobs_run (cs, sm, CJOB_LIST, (long)sm->pair_n, cpus);
+		return TRUE;
+	}
+
+	if (sm->pairmode == PAIRS_TABLE) {
+		for (i = 0; i < sm->table_n; i++) {
+			// row i of the triangular table is contiguous, see summations_update_block()
+			for (k = 0; k < i; k++) {
+				sm->relative[(i*i-i)/2 + k].sdev = var2sdev (pair_var (cs, sm->table[i], sm->table[k]));
+			}
+		}
+	}
+	if (sm->pairmode == PAIRS_LIST) {
+		for (k = 0; k < sm->pair_n; k++) {
+			sm->relative[k].sdev = var2sdev (pair_var (cs, sm->pair[k].a, sm->pair[k].b));
+		}
+	}
+	return TRUE;
+}
+
+//---------------------------------- end statics
+
+// no globals
+// Returns FALSE if there is not enough memory, or the curvature cannot be
+// inverted (the games do not define the ratings).
+bool_t
+covar_errors	( int							cpus
+				, bool_t						ml
+				, bool_t						adjust_white_advantage
+				, bool_t						adjust_draw_rate
+				, bool_t						anchor_err_rel2avg
+				, double						beta
+				, double						white_advantage
+				, double						drawrate_evenmatch
+				, player_t						priored_n
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps
+				, struct prior					wa_prior
+				, struct prior					dr_prior
+				, const struct ENCOUNTERS *		enc
+				, const struct PLAYERS *		plyrs
+				, const struct RATINGS *		rat
+				, struct summations *			sm		/*@out@*/
+				)
+{
+	struct CSOLVE cs;
+	player_t j;
+	bool_t ok;
+
+	if (!csolve_build	( &cs
+						, cpus
+						, ml
+						, adjust_white_advantage
+						, anchor_err_rel2avg
+						, beta
+						, white_advantage
+						, drawrate_evenmatch
+						, priored_n
+						, pp
+						, rps
+						, wa_prior
+						, enc
+						, plyrs
+						, plyrs->flagged
+						, rat->ratingof_results
+						, FALSE))
+		return FALSE;
+
+	ok = csolve_sdev (&cs, cpus, sm);
+	csolve_done (&cs);
+	if (!ok)
+		return FALSE;
+
+	for (j = 0; j < plyrs->n; j++) {
+		sm->mean[j] = rat->ratingof_results[j];
+	}
+	sm->wa_mean = white_advantage;
+	sm->dr_mean = drawrate_evenmatch;
+	sm->dr_sdev = adjust_draw_rate
+				? drawrate_sdev (ml, enc, rat->ratingof_results, white_advantage, drawrate_evenmatch, beta, dr_prior)
+				: 0;
+	return TRUE;
+}
+
+// no globals
+// Returns FALSE if there is not enough memory, or the curvature cannot be
+// inverted. The exact variances of the prediction go to the control
+// accumulators of sm, allocated with summations_control_calloc().
+bool_t
+covlin_init		( struct COVLIN *				cl		/*@out@*/
+				, int							cpus
+				, bool_t						ml
+				, bool_t						adjust_white_advantage
+				, bool_t						anchor_err_rel2avg
+				, double						beta
+				, double						white_advantage
+				, double						drawrate_evenmatch
+				, player_t						priored_n
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps
+				, struct prior					wa_prior
+				, const struct ENCOUNTERS *		pairing
+				, const struct PLAYERS *		plyrs
+				, const struct RATINGS *		rat
+				, struct summations *			sm		/*@out@*/
+				)
+{
+	struct CSOLVE cs;
+	player_t j;
+	ptrdiff_t k;
+
+	assert (sm->control != NULL && (sm->relative_n == 0 || sm->control_rel != NULL));
+
+	cl->idx = NULL;
+	cl->flagged = NULL;
+	cl->solve = NULL;
+	cl->g = NULL;
+
+	if (NULL == (cl->flagged = memnew (sizeof(bool_t) * (size_t)(plyrs->n + 1))))
+		return FALSE;
+
+	// all-wins and all-losses players are purged in almost every run,
+	// and their rating is not linear with the results
+	for (j = 0; j < plyrs->n; j++) {
+		cl->flagged[j] = plyrs->flagged[j] || (plyrs->perf_set && plyrs->performance_type[j] != PERF_NORMAL);
+	}
+
+	if (!csolve_build	( &cs
+						, cpus
+						, ml
+						, adjust_white_advantage
+						, anchor_err_rel2avg
+						, beta
+						, white_advantage
+						, drawrate_evenmatch
+						, priored_n
+						, pp
+						, rps
+						, wa_prior
+						, pairing
+						, plyrs
+						, cl->flagged
+						, rat->ratingof_results
+						, TRUE)) {
+		memrel (cl->flagged);
+		cl->flagged = NULL;
+		return FALSE;
+	}
+
+	// variances in place of the standard deviations, until the runs are done
+	if (!csolve_sdev (&cs, cpus, sm) || NULL == (cl->solve = memnew (sizeof(struct CSOLVE)))) {
+		csolve_done (&cs);
+		memrel (cl->flagged);
+		cl->flagged = NULL;
+		return FALSE;
+	}
+	for (j = 0; j < sm->nplayers; j++) {
+		sm->control[j].var = sq(sm->sdev[j]);
+		sm->sdev[j] = 0;
+	}
+	for (k = 0; k < sm->relative_n; k++) {
+		sm->control_rel[k].var = sq(sm->relative[k].sdev);
+		sm->relative[k].sdev = 0;
+	}
+	sm->wa_sdev = 0;
+
+	cl->ml			= ml;
+	cl->centered	= cs.centered;
+	cl->nplayers	= plyrs->n;
+	cl->np			= cs.np;
+	cl->pwa			= cs.pwa;
+	cl->enc_n		= pairing->n;
+	cl->work_n		= NULL != cs.a? cs.np: (2 + CG_VECTORS) * cs.nq;
+
+	// the rest is not needed to predict
+	cl->idx	= cs.idx;	cs.idx	= NULL;
+	cl->g	= cs.g;		cs.g	= NULL;
+	memrel (cs.vdiag);		cs.vdiag = NULL;
+	memrel (cs.rowmean);	cs.rowmean = NULL;
+	if (cs.brow) {
+		memrel (cs.brow);	cs.brow = NULL;
+	}
+	if (cs.a && cs.term) {
+		memrel (cs.term);	cs.term = NULL;
+	}
+	*cl->solve = cs;
+	return TRUE;
+}
+
+void
+covlin_done (struct COVLIN *cl)
+{
+	if (cl->solve) {
+		csolve_done (cl->solve);
+		memrel (cl->solve);
+	}
+	if (cl->g)			memrel (cl->g);
+	if (cl->idx)		memrel (cl->idx);
+	if (cl->flagged)	memrel (cl->flagged);
+	cl->g		= NULL;
+	cl->solve	= NULL;
+	cl->idx		= NULL;
+	cl->flagged	= NULL;
+}
+
+// no globals
+// Prediction of the ratings from the results of full, simulated with the
+// same pairing, and the priors moved from pp_ori to pp (rps_ori to rps).
+// Players fixed or flagged are 0, before moving to the average.
+void
+covlin_predict	( const struct COVLIN *			cl
+				, const struct ENCOUNTERS *		full
+				, const struct prior *			pp_ori
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps_ori
+				, const struct rel_prior_set *	rps
+				, double *						work	// cl->work_n
+				, double *						lin		/*@out@*/
+				)
+{
+	const ptrdiff_t *idx = cl->idx;
+	const struct CSOLVE *cs = cl->solve;
+	const double *g;
+	const struct ENC *pe;
+	double *s = work;
+	double *dx = NULL;
+	double x, mean;
+	gamesnum_t e;
+	ptrdiff_t i, a, b;
+	player_t j, navg;
+
+	assert (full->n == cl->enc_n);
+
+	// change of the equations
+	for (i = 0; i < cs->nq; i++) s[i] = 0;
+	for (e = 0; e < full->n; e++) {
+		pe = &full->enc[e];
+		g = cl->g + 3*e;
+		x = (double)pe->W * g[0] + (double)pe->D * g[1] + (double)pe->L * g[2];
+		if (x == 0) continue;
+		if (idx[pe->wh] != NOPARAM) s[idx[pe->wh]] += x;
+		if (idx[pe->bl] != NOPARAM) s[idx[pe->bl]] -= x;
+		if (cl->pwa != NOPARAM) s[cl->pwa] += x;
+	}
+	if (cl->ml) {
+		for (j = 0; j < cl->nplayers; j++) {
+			if (pp_ori[j].isset && pp_ori[j].sigma > 0 && idx[j] != NOPARAM)
+				s[idx[j]] += (pp[j].value - pp_ori[j].value) / sq(pp_ori[j].sigma);
+		}
+		for (i = 0; i < rps_ori->n; i++) {
+			if (!(rps_ori->x[i].sigma > 0)) continue;
+			x = (rps->x[i].delta - rps_ori->x[i].delta) / sq(rps_ori->x[i].sigma);
+			a = idx[rps_ori->x[i].player_a];
+			b = idx[rps_ori->x[i].player_b];
+			if (a != NOPARAM) s[a] += x;
+			if (b != NOPARAM) s[b] -= x;
+		}
+	}
+
+	// change of the parameters, a solve converges as it did for the variances
+	if (NULL == cs->a) {
+		dx = work + cs->nq;
+		(void) cg_solve (cs, 1, s, dx, work + 2 * cs->nq);
+	}
+
+	for (mean = 0, navg = 0, j = 0; j < cl->nplayers; j++) {
+		if (idx[j] == NOPARAM)
+			lin[j] = 0;
+		else
+			lin[j] = NULL != cs->a? dot (cs->a + idx[j]*cl->np, s, cl->np): dx[idx[j]];
+		if (!cl->flagged[j]) {
+			mean += lin[j];
+			navg++;
+		}
+	}
+	if (cl->centered && navg > 0) {
+		mean /= (double)navg;
+		for (j = 0; j < cl->nplayers; j++) {
+			if (!cl->flagged[j]) lin[j] -= mean;
+		}
+	}
+}
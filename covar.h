@@ -0,0 +1,118 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(H_COVAR)
+#define H_COVAR
+/*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
+
+#include <stddef.h>
+
+#include "boolean.h"
+#include "mytypes.h"
+
+/*
+|	Errors from the curvature of the fit at the ratings obtained, without
+|	simulations. They are the errors that simulations converge to when the
+|	number of games is large, and fill the same fields of the summations
+|	(sdev of every player, of the pairs in scope, white advantage and draw
+|	rate), so the reports do not know where they came from.
+*/
+
+#define COVAR_DENSE_MAX_PARAMS 4000	// above it, conjugate gradients instead of the np x np inverse
+
+extern bool_t
+covar_errors	( int							cpus	// threads for the solves, if sparse
+				, bool_t						ml		// likelihood with priors, otherwise expected scores match
+				, bool_t						adjust_white_advantage
+				, bool_t						adjust_draw_rate
+				, bool_t						anchor_err_rel2avg
+				, double						beta
+				, double						white_advantage
+				, double						drawrate_evenmatch
+				, player_t						priored_n
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps
+				, struct prior					wa_prior
+				, struct prior					dr_prior
+				, const struct ENCOUNTERS *		enc		// without flagged players
+				, const struct PLAYERS *		plyrs
+				, const struct RATINGS *		rat
+				, struct summations *			sm		/*@out@*/
+				);
+
+/*
+|	Linear prediction of the ratings of a simulated run from its results,
+|	with the same curvature. Its variance is known exactly, so it is used
+|	as a control variate: the errors from the simulations only keep the
+|	noise of what the prediction does not explain.
+*/
+
+struct CSOLVE;
+
+struct COVLIN {
+	bool_t		ml;
+	bool_t		centered;	// relative to the average
+	player_t	nplayers;
+	bool_t *	flagged;	// out of the prediction and of the average
+	ptrdiff_t	np;			// parameters
+	ptrdiff_t	pwa;		// parameter of the white advantage, or -1
+	ptrdiff_t *	idx;		// parameter of each player, -1 if fixed or flagged
+	struct CSOLVE *	solve;	// inverse of the curvature, dense or by conjugate gradients
+	double *	g;			// change of the equations with each result, 3 per encounter
+	gamesnum_t	enc_n;
+	ptrdiff_t	work_n;		// doubles of the work area of covlin_predict()
+};
+
+extern bool_t
+covlin_init		( struct COVLIN *				cl		/*@out@*/
+				, int							cpus
+				, bool_t						ml
+				, bool_t						adjust_white_advantage
+				, bool_t						anchor_err_rel2avg
+				, double						beta
+				, double						white_advantage
+				, double						drawrate_evenmatch
+				, player_t						priored_n
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps
+				, struct prior					wa_prior
+				, const struct ENCOUNTERS *		pairing	// every game, as simulated
+				, const struct PLAYERS *		plyrs
+				, const struct RATINGS *		rat
+				, struct summations *			sm		/*@out@*/
+				);
+
+extern void
+covlin_done		(struct COVLIN *cl);
+
+extern void
+covlin_predict	( const struct COVLIN *			cl
+				, const struct ENCOUNTERS *		full	// simulated run
+				, const struct prior *			pp_ori
+				, const struct prior *			pp
+				, const struct rel_prior_set *	rps_ori
+				, const struct rel_prior_set *	rps
+				, double *						work	// cl->work_n
+				, double *						lin		/*@out@*/
+				);
+
+/*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
+#endif
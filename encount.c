@@ -131,6 +131,28 @@ encounters_calculate
 					, e->enc);
 }
 
+// no globals
+void
+encounters_select
+				( int selectivity
+				, const struct ENCOUNTERS *full
+				, const bool_t *flagged
+				, struct ENCOUNTERS	*e
+) 
+{
+	gamesnum_t i, n = 0;
+	const struct ENC *f = full->enc;
+
+	assert(e->size >= full->n);
+
+	for (i = 0; i < full->n; i++) {
+		if (selectivity == ENCOUNTERS_NOFLAGGED && (flagged[f[i].wh] || flagged[f[i].bl]))
+			continue;
+		e->enc[n++] = f[i];
+	}
+	e->n = n;
+}
+
 // no globals
 static gamesnum_t
 calc_encounters ( int selectivity
@@ -44,6 +44,15 @@ encounters_calculate
 				, struct ENCOUNTERS	*e
 );
 
+// same as encounters_calculate(), from encounters already calculated with ENCOUNTERS_FULL
+extern void
+encounters_select
+				( int selectivity
+				, const struct ENCOUNTERS *full
+				, const bool_t *flagged
+				, struct ENCOUNTERS	*e
+);
+
 // no globals
 extern void
 calc_obtained_playedby 	( const struct ENC *enc
@@ -29,88 +29,50 @@
 #include "ordolim.h"
 #include "mytypes.h"
 
-typedef struct GROUP 		group_t;
-typedef struct CONNECT 		connection_t;
-typedef struct NODE 		node_t;
-typedef struct PARTICIPANT 	participant_t;
-
-struct GROUP {
-	group_t *		next;
-	group_t *		prev;
-	group_t *		combined;
-	participant_t *	pstart;
-	participant_t *	plast;
-	connection_t *	cstart; // beat to
-	connection_t *	clast;
-	connection_t *	lstart; // lost to
-	connection_t *	llast;
-	player_t		id;
-	bool_t			isolated;
-};
-
-struct CONNECT {
-	connection_t *	next;
-	node_t	*		node;
-};
-
-struct NODE {
-	group_t *		group;
-};
-
-struct PARTICIPANT {
-	participant_t *	next;
-	const char	*	name;
-	player_t		id;
-};
-
-struct GROUP_BUFFER {
-	group_t	*		list; //buffer
-	group_t	*		tail;
-	group_t	*		prehead;
-	player_t		n;
-	player_t		max;
-};
-
-struct PARTICIPANT_BUFFER {
-	participant_t *	list; //buffer
-	player_t		n;
-	player_t		max;
-};
-
-struct CONNECT_BUFFER {
-	connection_t *	list; //buffer
-	gamesnum_t		n;
-	gamesnum_t		max;
+// components of the players and the links between them, see groups.c
+struct WELLCONN {
+	player_t		nplayers;	// capacity
+	gamesnum_t		nenc;		// capacity
+	player_t *		parent;		// union-find of the players
+	gamesnum_t *	start;		// links out of each component, in adj
+	gamesnum_t *	rstart;		// links into each component, in radj
+	player_t *		stack;
+	int *			mark;
+	player_t *		from;		// links, winner to loser
+	player_t *		to;
+	player_t *		adj;
+	player_t *		radj;
 };
 
 struct GROUPCELL {
-	group_t * 	group;
-	player_t 	count;
+	player_t		scc;		// strongly connected component of the links
+	player_t		count;		// participants
+	player_t		start;		// first participant in member[]
+	const char *	first;		// lowest name of the participants
+	bool_t			linked;		// links with other groups
+	bool_t			active;		// participants present in the games
 };
 
 typedef struct GROUPCELL groupcell_t;
 
 struct GROUPVAR {
 	player_t		nplayers;
-	player_t	*	groupbelong;
-	player_t *		getnewid;
-	groupcell_t	*	groupfinallist;
+	struct WELLCONN	wc;				// components and links between them
+	player_t *		groupbelong;	// group of each participant, NO_ID for the rest
+	player_t *		sccof;			// strongly connected component of each component
+	player_t *		index;			// Tarjan
+	player_t *		lowlink;
+	player_t *		call;
+	gamesnum_t *	edge;
+	player_t *		rank;			// group of each strongly connected component
+	const char **	member;			// names of the participants, by group
+	groupcell_t	*	groupfinallist;	// groups, sorted
 	player_t		groupfinallist_n;
-	node_t	*		node;
-	player_t *		gchain;
-
-	group_t **		tofindgroup;
-
-	struct GROUP_BUFFER 		groupbuffer;
-	struct PARTICIPANT_BUFFER	participantbuffer;
-	struct CONNECT_BUFFER		connectionbuffer;
-
 };
 
 typedef struct GROUPVAR group_var_t;
 
 
-
 extern player_t			groupvar_build(group_var_t *gv, player_t N_plyers
 											, const char **name, const struct PLAYERS *players, const struct ENCOUNTERS *encounters);
 extern bool_t 			groupvar_init (group_var_t *gv, player_t nplayers, gamesnum_t nenc);
@@ -125,6 +87,10 @@ extern void				GV_groupid (group_var_t *gv, player_t *groupid_out);
 
 extern player_t 		GV_non_empty_groups_pop (group_var_t *gv, const struct PLAYERS *players);
 
+extern bool_t			wellconn_init (struct WELLCONN *w, player_t nplayers, gamesnum_t nenc);
+extern void				wellconn_done (struct WELLCONN *w);
+extern bool_t			wellconn_check (struct WELLCONN *w, const struct ENCOUNTERS *pEncounters, const struct PLAYERS *pPlayers);
+
 extern bool_t			well_connected (const struct ENCOUNTERS *pEncounters, const struct PLAYERS *pPlayers);
 
 extern void 			timer_reset(void);
@@ -0,0 +1,586 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+|	Ratings of each group apart
+|
+|	When the database is not well connected, every group (see groups.c)
+|	is a problem of its own. The players with all wins or all losses, which
+|	do not belong to any group, join the group of their opponents. The
+|	games between different groups are not used. Each group has the anchor
+|	if it is there, or the pool average otherwise, and the groups are rated
+|	in parallel. A group left without enough games among its own players
+|	is not rated.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "grprate.h"
+#include "groups.h"
+#include "inidone.h"
+#include "encount.h"
+#include "plyrs.h"
+#include "ra.h"
+#include "rtngcalc.h"
+#include "pgnget.h"
+#include "mymem.h"
+#include "sysport.h"
+
+#define NO_ID -1
+
+//---------------------------------- GROUPS ----------------------------------
+
+struct GROUPORDER {
+	player_t		id;
+	player_t		count;
+	const char *	first;
+};
+
+static int compare_order (const void * a, const void * b)
+{
+	const struct GROUPORDER *ap = a;
+	const struct GROUPORDER *bp = b;
+
+	if (ap->count < bp->count) return  1;
+	if (ap->count > bp->count) return -1;
+	return strcmp (ap->first, bp->first);
+}
+
+static player_t
+uf_find (player_t *parent, player_t x)
+{
+	while (parent[x] != x) {
+		parent[x] = parent[parent[x]]; // halving
+		x = parent[x];
+	}
+	return x;
+}
+
+/*
+|	Players with all wins or all losses join the group of an opponent, and
+|	the ones that played each other go together. gid[] is io, parent[] is
+|	scratch memory for n players.
+*/
+static void
+purged_join (const struct GAMES *games, const struct PLAYERS *plyrs, player_t *gid, player_t *pgroups, player_t *parent)
+{
+	const struct gamei *ga = games->ga;
+	const bool_t *flagged = plyrs->flagged;
+	gamesnum_t k;
+	player_t i, w, b, x, y;
+
+	for (i = 0; i < plyrs->n; i++) {
+		parent[i] = i;
+	}
+	for (k = 0; k < games->n; k++) {
+		if (ga[k].score >= DISCARD) continue;
+		w = ga[k].whiteplayer;
+		b = ga[k].blackplayer;
+		if (flagged[w] && flagged[b]) {
+			x = uf_find (parent, w);
+			y = uf_find (parent, b);
+			if (x != y) parent[x < y? y: x] = x < y? x: y;
+		}
+	}
+	for (k = 0; k < games->n; k++) {
+		if (ga[k].score >= DISCARD) continue;
+		w = ga[k].whiteplayer;
+		b = ga[k].blackplayer;
+		if (flagged[w] && !flagged[b] && gid[b] != NO_ID) {
+			x = uf_find (parent, w);
+			if (gid[x] == NO_ID) gid[x] = gid[b];
+		} else
+		if (flagged[b] && !flagged[w] && gid[w] != NO_ID) {
+			x = uf_find (parent, b);
+			if (gid[x] == NO_ID) gid[x] = gid[w];
+		}
+	}
+
+	// only opponents like them, a new group
+	for (i = 0; i < plyrs->n; i++) {
+		if (flagged[i] && plyrs->present_in_games[i]) {
+			x = uf_find (parent, i);
+			if (gid[x] == NO_ID) gid[x] = (*pgroups)++;
+			gid[i] = gid[x];
+		}
+	}
+}
+
+static bool_t
+groupsub_init (struct GROUPSUB *s, player_t n, gamesnum_t ng)
+{
+	gamesnum_t m = ng > 0? ng: 1;
+
+	s->idx = NULL;
+	s->anchor_use = FALSE;
+	s->anchor = 0;
+	s->anchor_rating = 0;
+	s->white_advantage = 0;
+	s->drawrate = 0;
+	s->rated = FALSE;
+	s->activestats.steps = 0;
+	s->activestats.full = 0;
+	s->activestats.last = 0;
+
+	if (NULL == (s->idx = memnew (sizeof(player_t) * (size_t)n))) {
+		return FALSE;
+	} else
+	if (!players_init (n, &s->plyrs)) {
+		memrel (s->idx);
+		return FALSE;
+	} else
+	if (!games_init (m, &s->games)) {
+		memrel (s->idx);
+		players_done (&s->plyrs);
+		return FALSE;
+	} else
+	if (!encounters_init (m, &s->enc)) {
+		memrel (s->idx);
+		players_done (&s->plyrs);
+		games_done (&s->games);
+		return FALSE;
+	} else
+	if (!ratings_init (n, &s->rat)) {
+		memrel (s->idx);
+		players_done (&s->plyrs);
+		games_done (&s->games);
+		encounters_done (&s->enc);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+groupsub_done (struct GROUPSUB *s)
+{
+	memrel (s->idx);
+	players_done (&s->plyrs);
+	games_done (&s->games);
+	encounters_done (&s->enc);
+	ratings_done (&s->rat);
+	s->idx = NULL;
+}
+
+/*
+|	The groups of the players, from the encounters without the players
+|	with all wins or all losses (flagged), and the games and anchors of each.
+*/
+bool_t
+grouprate_split	( const struct GAMES *games
+				, const struct PLAYERS *plyrs
+				, const struct RATINGS *rat
+				, const struct ENCOUNTERS *enc
+				, player_t anchor				// NO_ID if not used
+				, struct GROUPRATE *gr /*@out@*/)
+{
+	group_var_t *gv;
+	player_t *gid, *loc, *rank;
+	player_t *count;
+	gamesnum_t *ngames;
+	struct GROUPORDER *order;
+	const struct gamei *ga = games->ga;
+	player_t n = plyrs->n;
+	player_t i, g, j, groups, r;
+	gamesnum_t k;
+	bool_t ok;
+	size_t np = (size_t)n + 1;
+
+	gr->n = 0;
+	gr->apart = 0;
+	gr->g = NULL;
+
+	gid 	= memnew (sizeof(player_t) * np);
+	loc 	= memnew (sizeof(player_t) * np);
+	rank 	= memnew (sizeof(player_t) * np);
+	count 	= memnew (sizeof(player_t) * np);
+	ngames 	= memnew (sizeof(gamesnum_t) * np);
+	order 	= memnew (sizeof(struct GROUPORDER) * np);
+	ok = NULL != gid && NULL != loc && NULL != rank && NULL != count && NULL != ngames && NULL != order;
+
+	if (ok && NULL == (gv = GV_make (enc, plyrs))) {
+		ok = FALSE;
+	}
+	if (ok) {
+		GV_groupid (gv, gid);
+		groups = GV_counter (gv);
+		GV_kill (gv);
+
+		// 0 to groups-1, players with all wins or all losses are not in any yet
+		for (i = 0; i < n; i++) {
+			if (plyrs->flagged[i] || !plyrs->present_in_games[i] || gid[i] < 1)
+				gid[i] = NO_ID;
+			else
+				gid[i]--;
+		}
+		// renumbered without the groups left empty, so that no more than n are needed
+		for (g = 0; g < groups; g++) {
+			rank[g] = NO_ID;
+		}
+		for (groups = 0, i = 0; i < n; i++) {
+			if (gid[i] == NO_ID) continue;
+			if (rank[gid[i]] == NO_ID) rank[gid[i]] = groups++;
+			gid[i] = rank[gid[i]];
+		}
+		purged_join (games, plyrs, gid, &groups, loc);
+
+		// the largest first
+		for (g = 0; g < groups; g++) {
+			order[g].id = g;
+			order[g].count = 0;
+			order[g].first = NULL;
+		}
+		for (i = 0; i < n; i++) {
+			if (gid[i] == NO_ID) continue;
+			g = gid[i];
+			order[g].count++;
+			if (order[g].first == NULL || strcmp (plyrs->name[i], order[g].first) < 0)
+				order[g].first = plyrs->name[i];
+		}
+		qsort (order, (size_t)groups, sizeof(struct GROUPORDER), compare_order);
+		for (r = 0; r < groups; r++) {
+			rank[order[r].id] = r;
+		}
+		gr->n = r;
+
+		// players and games of each
+		for (r = 0; r < gr->n; r++) {
+			count[r] = 0;
+			ngames[r] = 0;
+		}
+		for (i = 0; i < n; i++) {
+			if (gid[i] == NO_ID) continue;
+			gid[i] = rank[gid[i]];
+			loc[i] = count[gid[i]]++;
+		}
+		for (k = 0; k < games->n; k++) {
+			player_t w = ga[k].whiteplayer;
+			player_t b = ga[k].blackplayer;
+			if (gid[w] != NO_ID && gid[w] == gid[b]) {
+				ngames[gid[w]]++;
+			} else if (ga[k].score < DISCARD) {
+				gr->apart++;
+			}
+		}
+
+		ok = NULL != (gr->g = memnew (sizeof(struct GROUPSUB) * (size_t)(gr->n > 0? gr->n: 1)));
+		for (r = 0; ok && r < gr->n; r++) {
+			if (!groupsub_init (&gr->g[r], count[r], ngames[r])) {
+				while (r-- > 0) groupsub_done (&gr->g[r]);
+				memrel (gr->g);
+				gr->g = NULL;
+				ok = FALSE;
+			}
+		}
+	}
+
+	if (ok) {
+		for (r = 0; r < gr->n; r++) {
+			gr->g[r].plyrs.n = count[r];
+			gr->g[r].games.n = 0;
+		}
+		for (i = 0; i < n; i++) {
+			struct GROUPSUB *s;
+			if (gid[i] == NO_ID) continue;
+			s = &gr->g[gid[i]];
+			j = loc[i];
+			s->idx[j] = i;
+			s->plyrs.name[j] = plyrs->name[i];
+			s->plyrs.flagged[j] = FALSE;
+			s->plyrs.present_in_games[j] = TRUE;
+			s->plyrs.prefed[j] = plyrs->prefed[i];
+			s->plyrs.priored[j] = FALSE;
+			s->plyrs.performance_type[j] = PERF_NORMAL;
+			s->rat.ratingof[j] = rat->ratingof[i];
+			if (plyrs->prefed[i])
+				s->plyrs.anchored_n++;
+			if (i == anchor) {
+				s->anchor_use = TRUE;
+				s->anchor = j;
+				s->anchor_rating = rat->ratingof[i];
+			} else if (plyrs->prefed[i] && !s->anchor_use) {
+				s->anchor = j;
+				s->anchor_rating = rat->ratingof[i];
+			}
+		}
+		for (r = 0; r < gr->n; r++) {
+			// a group with a single fixed player takes it as its own anchor
+			if (gr->g[r].plyrs.anchored_n == 1)
+				gr->g[r].anchor_use = TRUE;
+		}
+		for (k = 0; k < games->n; k++) {
+			player_t w = ga[k].whiteplayer;
+			player_t b = ga[k].blackplayer;
+			if (gid[w] != NO_ID && gid[w] == gid[b]) {
+				struct GAMES *x = &gr->g[gid[w]].games;
+				x->ga[x->n].whiteplayer = loc[w];
+				x->ga[x->n].blackplayer = loc[b];
+				x->ga[x->n].score = ga[k].score;
+				x->n++;
+			}
+		}
+	}
+
+	if (gid) 	memrel (gid);
+	if (loc) 	memrel (loc);
+	if (rank) 	memrel (rank);
+	if (count) 	memrel (count);
+	if (ngames) memrel (ngames);
+	if (order) 	memrel (order);
+
+	return ok;
+}
+
+void
+grouprate_done (struct GROUPRATE *gr)
+{
+	player_t r;
+	for (r = 0; r < gr->n; r++) {
+		groupsub_done (&gr->g[r]);
+	}
+	if (gr->g) memrel (gr->g);
+	gr->g = NULL;
+	gr->n = 0;
+	gr->apart = 0;
+}
+
+//---------------------------------- RATINGS ---------------------------------
+
+struct GROUPSOLVE {
+	bool_t			prior_mode;
+	bool_t			adjust_wadv;
+	bool_t			adjust_drate;
+	bool_t			anchor_err_rel2avg;
+	bool_t			active_set;
+	double			general_average;
+	double			beta;
+	struct prior	wa_prior;
+	struct prior	dr_prior;
+	double			white_advantage;
+	double			drawrate;
+};
+
+// games dropped between groups may leave players of the group without a rating
+static bool_t
+groupsub_connected (struct GROUPSUB *s)
+{
+	struct PLAYERS *p = &s->plyrs;
+	bool_t ok;
+	player_t j;
+
+	if (s->enc.n == 0) return FALSE;
+
+	for (j = 0; j < p->n; j++) p->present_in_games[j] = !p->flagged[j];
+	ok = well_connected (&s->enc, p);
+	for (j = 0; j < p->n; j++) p->present_in_games[j] = TRUE;
+
+	return ok;
+}
+
+// same steps as the whole pool in main()
+static void
+groupsub_rate (struct GROUPSUB *s, const struct GROUPSOLVE *q)
+{
+	struct PLAYERS *p = &s->plyrs;
+	struct RATINGS *rat = &s->rat;
+	struct ENCOUNTERS full;
+	struct rel_prior_set rps = {0, NULL};
+	struct prior *PP;
+	double average = s->anchor_use? s->anchor_rating: q->general_average;
+	player_t j;
+
+	s->white_advantage = q->white_advantage;
+	s->drawrate = q->drawrate;
+
+	for (j = 0; j < p->n; j++) {
+		if (!p->prefed[j]) rat->ratingof[j] = q->general_average;
+		rat->ratingbk[j] = rat->ratingof[j];
+	}
+
+	encounters_calculate (ENCOUNTERS_FULL, &s->games, p->flagged, &s->enc);
+
+	if (!encounters_init (s->enc.n > 0? s->enc.n: 1, &full) || NULL == (PP = priorlist_init (p->n))) {
+		fprintf (stderr, "Not enough memory to rate the groups\n");
+		exit(EXIT_FAILURE);
+	}
+	encounters_select (ENCOUNTERS_FULL, &s->enc, p->flagged, &full);
+	for (j = 0; j < p->n; j++) {
+		PP[j].value = 0;
+		PP[j].sigma = 1;
+		PP[j].isset = FALSE;
+	}
+
+	players_set_priored_info (PP, &rps, p);
+	if (0 < players_set_super (TRUE, &s->enc, p)) {
+		players_purge (TRUE, p);
+		encounters_calculate (ENCOUNTERS_NOFLAGGED, &s->games, p->flagged, &s->enc);
+	}
+
+	s->rated = groupsub_connected (s);
+	if (!s->rated) {
+		encounters_done (&full);
+		priorlist_done (&PP);
+		return;
+	}
+
+	s->enc.n = calc_rating	( TRUE
+							, q->prior_mode
+							, q->adjust_wadv
+							, q->adjust_drate
+							, s->anchor_use
+							, q->anchor_err_rel2avg
+							, WARM_NONE
+							, 1		// groups are already spread over the threads
+							, q->active_set? &s->activestats: NULL
+
+							, average
+							, s->anchor
+							, 0
+							, q->beta
+
+							, &s->enc
+							, &rps
+							, p
+							, rat
+							, &full
+							, s->games.n
+
+							, PP
+							, q->wa_prior
+							, q->dr_prior
+
+							, &s->white_advantage
+							, &s->drawrate
+							, NULL
+							);
+
+	ratings_results	( q->anchor_err_rel2avg
+					, s->anchor_use
+					, s->anchor
+					, average
+					, p
+					, rat);
+
+	encounters_done (&full);
+	priorlist_done (&PP);
+}
+
+struct GROUPTHREAD {
+	struct GROUPRATE *			gr;
+	const struct GROUPSOLVE *	q;
+	myatomic_t *				next;	// next group to be rated
+};
+
+static thread_return_t THREAD_CALL
+grouprate_process (void *p)
+{
+	struct GROUPTHREAD *t = p;
+	long r;
+
+	while ((r = mythread_atomic_add (t->next, 1)) < (long)t->gr->n) {
+		groupsub_rate (&t->gr->g[r], t->q);
+	}
+
+	mythread_exit ();
+	return (thread_return_t) 0;
+}
+
+/*
+|	White advantage and draw rate, if adjusted, come from the largest group,
+|	then they are fixed for the rest.
+*/
+void
+grouprate_solve	( struct GROUPRATE *gr
+				, int cpus
+				, bool_t prior_mode
+				, bool_t adjust_wadv
+				, bool_t adjust_drate
+				, bool_t anchor_err_rel2avg
+				, bool_t active_set
+				, double general_average
+				, double beta
+				, struct prior wa_prior
+				, struct prior dr_prior
+				, double white_advantage
+				, double drawrate)
+{
+	struct GROUPSOLVE q;
+	struct GROUPTHREAD arg;
+	myatomic_t next;
+	mythread_t *threadid;
+	int *err;
+	int t;
+
+	if (gr->n < 1) return;
+
+	q.prior_mode			= prior_mode;
+	q.adjust_wadv			= adjust_wadv;
+	q.adjust_drate			= adjust_drate;
+	q.anchor_err_rel2avg	= anchor_err_rel2avg;
+	q.active_set			= active_set;
+	q.general_average		= general_average;
+	q.beta					= beta;
+	q.wa_prior				= wa_prior;
+	q.dr_prior				= dr_prior;
+	q.white_advantage		= white_advantage;
+	q.drawrate				= drawrate;
+
+	mythread_atomic_set (&next, 0);
+
+	if (adjust_wadv || adjust_drate) {
+		groupsub_rate (&gr->g[0], &q);
+		q.adjust_wadv		= FALSE;
+		q.adjust_drate		= FALSE;
+		q.white_advantage	= gr->g[0].white_advantage;
+		q.drawrate			= gr->g[0].drawrate;
+		mythread_atomic_set (&next, 1);
+	}
+
+	if (cpus < 1) cpus = 1;
+	if ((long)cpus > (long)gr->n) cpus = (int)gr->n;
+
+	arg.gr = gr;
+	arg.q = &q;
+	arg.next = &next;
+
+	threadid = memnew (sizeof(mythread_t) * (size_t)cpus);
+	err = memnew (sizeof(int) * (size_t)cpus);
+	if (NULL == threadid || NULL == err) {
+		fprintf (stderr, "Memory for %d threads could not be allocated\n", cpus);
+		exit(EXIT_FAILURE);
+	}
+	for (t = 0; t < cpus; t++) {
+		if (!mythread_create (&threadid[t], grouprate_process, &arg, &err[t])) {
+			fprintf (stderr, "thread %d, fatal error at creating: %s\n", t, mythread_create_error(err[t]));
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t = 0; t < cpus; t++) {
+		if (0 == mythread_join (threadid[t])) {
+			fprintf (stderr, "thread %d: fatal problems at joining\n", t);	
+			exit(EXIT_FAILURE);	
+		}
+	}
+	memrel (err);
+	memrel (threadid);
+}
@@ -0,0 +1,75 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(H_GRPRATE)
+#define H_GRPRATE
+/*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
+
+#include "boolean.h"
+#include "mytypes.h"
+
+// one group of players (see groups.c), rated on its own
+struct GROUPSUB {
+	player_t *			idx;		// index of each player in the whole pool
+	struct PLAYERS		plyrs;
+	struct GAMES		games;		// only between players of the group
+	struct ENCOUNTERS	enc;
+	struct RATINGS		rat;
+	bool_t				anchor_use;	// the anchor is in this group
+	player_t			anchor;
+	double				anchor_rating;
+	double				white_advantage;
+	double				drawrate;
+	bool_t				rated;		// FALSE if not enough games within the group
+	struct ACTIVESTATS	activestats;	// work of the active set, if used
+};
+
+struct GROUPRATE {
+	player_t			n;			// groups, the largest first
+	gamesnum_t			apart;		// games between different groups, not used
+	struct GROUPSUB *	g;
+};
+
+extern bool_t	grouprate_split	( const struct GAMES *games
+								, const struct PLAYERS *plyrs
+								, const struct RATINGS *rat
+								, const struct ENCOUNTERS *enc
+								, player_t anchor
+								, struct GROUPRATE *gr /*@out@*/);
+
+extern void		grouprate_solve	( struct GROUPRATE *gr
+								, int cpus
+								, bool_t prior_mode
+								, bool_t adjust_wadv
+								, bool_t adjust_drate
+								, bool_t anchor_err_rel2avg
+								, bool_t active_set
+								, double general_average
+								, double beta
+								, struct prior wa_prior
+								, struct prior dr_prior
+								, double white_advantage
+								, double drawrate);
+
+extern void		grouprate_done	(struct GROUPRATE *gr);
+
+/*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
+#endif
@@ -27,288 +27,330 @@
 #include "ordolim.h"
 #include "xpect.h"
 #include "mymem.h"
+#include "sysport.h"
 
 //===============================================================
 
-#if 1
+/*
+|	The rating of a player alone, given the ratings of the opponents, is the
+|	root of an increasing function of x. It is found by Newton steps, kept
+|	inside a bracket of the root and replaced by a bisection when they fall
+|	out of it.
+*/
+
+#define ROOT_TOLERANCE	0.000001	// rating points
+#define ROOT_MAXSTEPS	100
+#define ROOT_DX			0.01		// numerical derivatives
+
+struct INDFN {
+	const double *	rtng;	// ratings of the opponents
+	const double *	weig;	// games against each
+	int				r;
+	int				perf_type;
+	double			target;
+	double			deq;
+	double			beta;
+};
+
+typedef double (*indfn_t) (double x, const struct INDFN *p, double *dfdx);
+
+// expected score minus the target
 static double
-ind_expected (double x, double *rtng, double *weig, int n, double beta)
+fn_expected (double x, const struct INDFN *p, double *dfdx)
 {
 	int i;
-	double cume = 0;
-	for (i = 0; i < n; i++) {
-		cume += weig[i] * xpect (x, rtng[i], beta);
+	double e, cume = 0, dcume = 0;
+	for (i = 0; i < p->r; i++) {
+		e = xpect (x, p->rtng[i], p->beta);
+		cume  += p->weig[i] * e;
+		dcume += p->weig[i] * p->beta * e * (1 - e);
 	}
-	return cume;
+	*dfdx = dcume;
+	return cume - p->target;
 }
 
-static double 
-adjust_x (double x, double xp, double sc, double delta, double kappa)
+// log of the probability of getting all wins (or not all losses), minus the target
+static double
+log_absolute (double x, const struct INDFN *p)
 {
-	double y;
-	double	d;
-	d = xp - sc;
-	
-	d = d < 0? -d: d;
-	y = d / (kappa+d);
-	if (xp > sc) {
-		x -= delta * y;
-	} else {
-		x += delta * y;
+	int i;
+	double pwin, pdraw, ploss;
+	double cume = 0;
+	for (i = 0; i < p->r; i++) {
+		get_pWDL(x - p->rtng[i], &pwin, &pdraw, &ploss, p->deq, p->beta);
+		cume += p->weig[i] * log (PERF_SUPERWINNER == p->perf_type? pwin: ploss);
 	}
-	return x;	
+	return PERF_SUPERWINNER == p->perf_type? cume - p->target: p->target - cume;
 }
 
-
 static double
-calc_ind_rating(double cume_score, double *rtng, double *weig, int r, double beta)
+fn_absolute (double x, const struct INDFN *p, double *dfdx)
 {
-	int 	i;
-	double 	olddev, curdev;
-	int		rounds = 10000;
-	double 	delta = 200.0;
-	double 	kappa = 0.05;
-	double 	denom = 2;
-	int 	phase = 0;
-	int 	n = 20;
-
-	double  D,sc,oldx;
-
-	double x = 2000;
-	double xp;
-
-	D = cume_score - ind_expected(x,rtng,weig,r,beta) ;
-	curdev = D*D;
-	olddev = curdev;
-
-	while (n-->0) {
-		double kk = 1.0;
-		for (i = 0; i < rounds; i++) {
-			oldx = x;
-			olddev = curdev;
-
-			sc = cume_score;
-			xp = ind_expected(x,rtng,weig,r,beta);
-			x  = adjust_x (x, xp, sc, delta, kappa*kk);
-			xp = ind_expected(x,rtng,weig,r,beta);
-			D = xp - sc;
-			curdev = D*D;
-
-			if (curdev >= olddev) {
-				x = oldx;
-#if 0
-				D = cume_score - ind_expected(x,rtng,weig,r,beta) ;
-				curdev = D*D;	
-				assert (curdev == olddev);
-#else
-				curdev = olddev;
-#endif	
-
-				break;
-			};	
-
-			if (curdev < 0.000001) break;
-			kk *= 0.995;
-		}
-
-		delta /= denom;
-		kappa *= denom;
-
-		phase++;
-
-		if (curdev < 0.000001) break;
-	}
-
-	return x;
+	*dfdx = (log_absolute (x + ROOT_DX, p) - log_absolute (x - ROOT_DX, p)) / (2 * ROOT_DX);
+	return log_absolute (x, p);
 }
-#endif
-
-//=========================================
-
 
 static double
-prob2absolute_result (int perftype, double myrating, double *rtng, double *weig, int n, double deq, double beta)
+root_increasing (indfn_t f, const struct INDFN *p, double x, double step)
 {
+	double lo, hi, fx, dfdx, xn;
 	int i;
-	double p, cume;
-	double pwin, pdraw, ploss;
-	assert(n);
-	assert(perftype == PERF_SUPERWINNER || perftype == PERF_SUPERLOSER);
-	assert(deq <= 1 && deq >= 0);
 
-	cume = 1.0;
-	if (PERF_SUPERWINNER == perftype) {
-		for (i = 0; i < n; i++) {
-			get_pWDL(myrating - rtng[i], &pwin, &pdraw, &ploss, deq, beta);
-			p = pwin;
-			cume *= exp(weig[i] * log (p)); // p ^ weight
-		}	
+	// bracket
+	fx = f (x, p, &dfdx);
+	if (fx == 0) return x;
+	if (fx < 0) {
+		for (lo = x, hi = x + step, i = 0; f (hi, p, &dfdx) < 0 && i < ROOT_MAXSTEPS; i++) {
+			lo = hi;
+			step *= 2;
+			hi += step;
+		}
 	} else {
-		for (i = 0; i < n; i++) {
-			get_pWDL(myrating - rtng[i], &pwin, &pdraw, &ploss, deq, beta);
-			p = ploss;
-			cume *= exp(weig[i] * log (p)); // p ^ weight
+		for (hi = x, lo = x - step, i = 0; f (lo, p, &dfdx) > 0 && i < ROOT_MAXSTEPS; i++) {
+			hi = lo;
+			step *= 2;
+			lo -= step;
 		}
 	}
-	return cume;
-}
 
+	x = (lo + hi) / 2;
+	for (i = 0; i < ROOT_MAXSTEPS && hi - lo > ROOT_TOLERANCE; i++) {
+		fx = f (x, p, &dfdx);
+		if (fx < 0) {
+			lo = x;
+		} else if (fx > 0) {
+			hi = x;
+		} else {
+			break;
+		}
+		xn = dfdx > 0? x - fx / dfdx: (lo + hi) / 2;
+		if (!(xn > lo && xn < hi)) 
+			xn = (lo + hi) / 2;
+		if (fabs (xn - x) < ROOT_TOLERANCE) {
+			x = xn;
+			break;
+		}
+		x = xn;
+	}
+
+	return x;
+}
 
 static double
-calc_ind_rating_superplayer (int perf_type, double x_estimated, double *rtng, double *weig, int r, double deq, double beta)
+calc_ind_rating (double cume_score, const double *rtng, const double *weig, int r, double beta)
 {
-	int 	i;
-	double 	old_unfit, cur_unfit;
-	int		rounds = 2000;
-	double 	delta = 200.0;
-	double 	denom = 2;
-	double fdelta;
-	double  D, oldx;
-	double x = x_estimated;
+	struct INDFN p;
+	p.rtng = rtng;
+	p.weig = weig;
+	p.r = r;
+	p.perf_type = PERF_NORMAL;
+	p.target = cume_score;
+	p.deq = 0;
+	p.beta = beta;
+	return root_increasing (fn_expected, &p, 2000, 200);
+}
 
+// rating that makes the probability of the result (all wins or all losses) 50%
+static double
+calc_ind_rating_superplayer (int perf_type, double x_estimated, const double *rtng, const double *weig, int r, double deq, double beta)
+{
+	struct INDFN p;
 	assert(r);
+	assert(perf_type == PERF_SUPERWINNER || perf_type == PERF_SUPERLOSER);
+	assert(deq <= 1 && deq >= 0);
+	p.rtng = rtng;
+	p.weig = weig;
+	p.r = r;
+	p.perf_type = perf_type;
+	p.target = log (0.5);
+	p.deq = deq;
+	p.beta = beta;
+	return root_increasing (fn_absolute, &p, x_estimated, 200);
+}
 
-	if (perf_type == PERF_SUPERLOSER) 
-		D = - 0.5 + prob2absolute_result(perf_type, x, rtng, weig, r, deq, beta);		
-	else
-		D = + 0.5 - prob2absolute_result(perf_type, x, rtng, weig, r, deq, beta);
-
-	cur_unfit = D * D;
-	old_unfit = cur_unfit;
-
-	fdelta = D < 0? -delta:  delta;	
-
-	for (i = 0; i < rounds; i++) {
+//=========================================
 
-		oldx = x;
-		old_unfit = cur_unfit;
+// one player with all wins or all losses
+struct SUPERONE {
+	player_t	j;
+	int			perf_type;
+	gamesnum_t	start;	// opponents in rtng[] and weig[]
+	int			r;
+	double		cume_score;
+	double		x;		// rating, output
+};
+
+struct SUPERSET {
+	struct SUPERONE *	s;
+	player_t			n;
+	const double *		rtng;
+	const double *		weig;
+	double				deq;
+	double				beta;
+	myatomic_t			next;	// next one to be rated, by the threads
+};
 
-		x += fdelta;
+static void
+superone_rate (struct SUPERONE *o, const struct SUPERSET *q)
+{
+	const double *rtng = q->rtng + o->start;
+	const double *weig = q->weig + o->start;
+	double bias = o->perf_type == PERF_SUPERWINNER? -0.25: 0.25;
+	double ori_estimation = calc_ind_rating (o->cume_score + bias, rtng, weig, o->r, q->beta); 
+	o->x = calc_ind_rating_superplayer (o->perf_type, ori_estimation, rtng, weig, o->r, q->deq, q->beta);
+}
 
-		if (perf_type == PERF_SUPERLOSER) 
-			D = - 0.5 + prob2absolute_result(perf_type, x, rtng, weig, r, deq, beta);		
-		else
-			D = + 0.5 - prob2absolute_result(perf_type, x, rtng, weig, r, deq, beta);
+static thread_return_t THREAD_CALL
+superset_process (void *p)
+{
+	struct SUPERSET *q = p;
+	long i;
 
-		cur_unfit = D * D;
-		fdelta = D < 0? -delta: delta;
+	while ((i = mythread_atomic_add (&q->next, 1)) < (long)q->n) {
+		superone_rate (&q->s[i], q);
+	}
 
+	mythread_exit ();
+	return (thread_return_t) 0;
+}
 
-		if (cur_unfit >= old_unfit) {
-			x = oldx;
-			cur_unfit = old_unfit;
-			delta /= denom;
+#define MIN_SUPER_PER_THREAD 64
 
-		} else {
+static void
+superset_rate (struct SUPERSET *q, int cpus)
+{
+	mythread_t *threadid;
+	int *err;
+	int t;
+	player_t i;
 
-		}	
+	if ((long)cpus > (long)(q->n / MIN_SUPER_PER_THREAD)) 
+		cpus = (int)(q->n / MIN_SUPER_PER_THREAD);
 
-		if (cur_unfit < 0.0000000001) break;
+	if (cpus < 2) {
+		for (i = 0; i < q->n; i++) {
+			superone_rate (&q->s[i], q);
+		}
+		return;
 	}
 
-	return x;
+	mythread_atomic_set (&q->next, 0);
+	threadid = memnew (sizeof(mythread_t) * (size_t)cpus);
+	err = memnew (sizeof(int) * (size_t)cpus);
+	if (NULL == threadid || NULL == err) {
+		fprintf (stderr, "Memory for %d threads could not be allocated\n", cpus);
+		exit(EXIT_FAILURE);
+	}
+	for (t = 0; t < cpus; t++) {
+		if (!mythread_create (&threadid[t], superset_process, q, &err[t])) {
+			fprintf (stderr, "thread %d, fatal error at creating: %s\n", t, mythread_create_error(err[t]));
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t = 0; t < cpus; t++) {
+		if (0 == mythread_join (threadid[t])) {
+			fprintf (stderr, "thread %d: fatal problems at joining\n", t);	
+			exit(EXIT_FAILURE);	
+		}
+	}
+	memrel (err);
+	memrel (threadid);
 }
 
-static double calc_ind_rating(double cume_score, double *rtng, double *weig, int r, double beta);
-static double calc_ind_rating_superplayer (int perf_type, double x_estimated, double *rtng, double *weig, int r, double deq, double beta);
-
+/*
+|	The games of all the players with all wins or all losses are gathered
+|	first, with the ratings of their opponents before any of them changes,
+|	so the result does not depend on the order or on the threads.
+*/
 static void
 rate_super_players_internal
 					( bool_t quiet
-					, struct ENC *enc
-					, size_t N_enc
+					, const struct ENC *enc
+					, gamesnum_t N_enc
 					, int *performance_type
 					, player_t n_players
 					, double *ratingof
 					, double white_advantage
 					, bool_t *flagged
 					, const char *Name[]
-					, double deq
-					, double beta
-					, struct ENC *myenc
-					, double weig[]
-					, double rtng[]
+					, int cpus
+					, struct SUPERSET *q
+					, struct SUPERONE *s		// n_players
+					, player_t *pos				// n_players
+					, double *rtng				// N_enc * 2
+					, double *weig				// N_enc * 2
 )
 {
-	size_t e;
-	player_t j;
-	size_t myenc_n = 0;
-
-		for (j = 0; j < n_players; j++) {
-
-			if (performance_type[j] != PERF_SUPERWINNER && performance_type[j] != PERF_SUPERLOSER) 
-				continue;
-
-			myenc_n = 0; // reset
-
-			for (e = 0; e < N_enc; e++) {
-				player_t w = enc[e].wh;
-				player_t b = enc[e].bl;
-				if (j == w) { 
-					myenc[myenc_n++] = enc[e];
-				} else
-				if (j == b) { 
-					myenc[myenc_n++] = enc[e];
-				}
-			}
+	gamesnum_t e, k;
+	player_t j, w, b;
+	player_t n = 0;
+
+	for (j = 0; j < n_players; j++) {
+		pos[j] = -1;
+		if (performance_type[j] == PERF_SUPERWINNER || performance_type[j] == PERF_SUPERLOSER) {
+			s[n].j = j;
+			s[n].perf_type = performance_type[j];
+			s[n].r = 0;
+			s[n].cume_score = 0;
+			pos[j] = n++;
+		}
+	}
+	if (n == 0) return;
 
-			if (!quiet) {
-				if (0 == myenc_n) {
-					printf ("  no games   --> %s\n", Name[j]);
-				} else
-				if (performance_type[j] == PERF_SUPERWINNER) {
-					printf ("  all wins   --> %s\n", Name[j]);
-				} else
-				if (performance_type[j] == PERF_SUPERLOSER) {
-					printf ("  all losses --> %s\n", Name[j]);
-				}
-			}
+	// opponents of each, in place
+	for (e = 0; e < N_enc; e++) {
+		if (pos[enc[e].wh] >= 0) s[pos[enc[e].wh]].r++;
+		if (pos[enc[e].bl] >= 0) s[pos[enc[e].bl]].r++;
+	}
+	for (k = 0, j = 0; j < n; j++) {
+		s[j].start = k;
+		k += s[j].r;
+		s[j].r = 0;
+	}
+	for (e = 0; e < N_enc; e++) {
+		w = enc[e].wh;
+		b = enc[e].bl;
+		if (pos[w] >= 0) {
+			struct SUPERONE *o = &s[pos[w]];
+			weig[o->start + o->r  ] = (double)enc[e].played;
+			rtng[o->start + o->r++] = ratingof[b] - white_advantage;
+			o->cume_score += enc[e].wscore;
+		}
+		if (pos[b] >= 0) {
+			struct SUPERONE *o = &s[pos[b]];
+			weig[o->start + o->r  ] = (double)enc[e].played;
+			rtng[o->start + o->r++] = ratingof[w] + white_advantage;
+			o->cume_score += (double)enc[e].played - enc[e].wscore;
+		}
+	}
 
-			if (0 != myenc_n)
-			{
-				double	cume_score = 0; 
-				double	cume_total = 0;
-				int		r = 0;
-
-				while (myenc_n-->0) {
-					size_t n = myenc_n;
-					if (myenc[n].wh == j) { 
-						player_t opp = myenc[n].bl;
-						weig[r	] = (double)myenc[n].played;
-						rtng[r++] = ratingof[opp] - white_advantage;
-						cume_score += myenc[n].wscore;
-						cume_total += (double)myenc[n].played;
-				 	} else 
-					if (myenc[myenc_n].bl == j) { 
-						player_t opp = myenc[n].wh;
-						weig[r	] = (double)myenc[n].played;
-						rtng[r++] = ratingof[opp] + white_advantage;
-						cume_score += (double)myenc[n].played - myenc[n].wscore;
-						cume_total += (double)myenc[n].played;
-					} else {
-						fprintf(stderr,"ERROR!! function rate_super_players()\n");
-						exit(0);
-						continue;
-					} 
-				}
-
-				if (performance_type[j] == PERF_SUPERWINNER) {
-					double ori_estimation = calc_ind_rating (cume_score-0.25, rtng, weig, r, beta); 
-					assert(r);
-					ratingof[j] = calc_ind_rating_superplayer (PERF_SUPERWINNER, ori_estimation, rtng, weig, r, deq, beta);
-				}
-				if (performance_type[j] == PERF_SUPERLOSER) {
-					double ori_estimation = calc_ind_rating (cume_score+0.25, rtng, weig, r, beta); 
-					assert(r);
-					ratingof[j] = calc_ind_rating_superplayer (PERF_SUPERLOSER,  ori_estimation, rtng, weig, r, deq, beta);
-				}
-				flagged[j] = FALSE;
+	if (!quiet) {
+		for (j = 0; j < n; j++) {
+			if (0 == s[j].r) {
+				printf ("  no games   --> %s\n", Name[s[j].j]);
+			} else
+			if (s[j].perf_type == PERF_SUPERWINNER) {
+				printf ("  all wins   --> %s\n", Name[s[j].j]);
 			} else {
-				assert (performance_type[j] == PERF_NOGAMES);
-				flagged[j] = TRUE;
+				printf ("  all losses --> %s\n", Name[s[j].j]);
 			}
-
 		}
+	}
+
+	// the ones with games
+	for (k = 0, j = 0; j < n; j++) {
+		if (s[j].r > 0) s[k++] = s[j];
+	}
+	q->s = s;
+	q->n = (player_t)k;
+	q->rtng = rtng;
+	q->weig = weig;
+	superset_rate (q, cpus);
+
+	for (j = 0; j < q->n; j++) {
+		ratingof[s[j].j] = s[j].x;
+		flagged[s[j].j] = FALSE;
+	}
 
 	return;
 }
@@ -326,49 +368,50 @@ rate_super_players	( bool_t quiet
 					, const char *Name[]
 					, double deq
 					, double beta
+					, int cpus
 )
 {
-	struct ENC 	*myenc = NULL;
-	double 		*weig = NULL;
-	double 		*rtng = NULL;
-	bool_t		ok;
-	size_t		np = (size_t) n_players;
-	size_t		ne = (size_t) N_enc;
-
-	if (NULL != (weig = memnew(sizeof(double) * ne))) {
-		if (NULL != (rtng = memnew(sizeof(double) * ne))) {
-			if (NULL != (myenc = memnew (sizeof(struct ENC) * ne))) {
-
-				rate_super_players_internal
-					( quiet
-					, enc
-					, ne
-					, performance_type
-					, (player_t) np
-					, ratingof
-					, white_advantage
-					, flagged
-					, Name
-					, deq
-					, beta
-					, myenc
-					, weig
-					, rtng
-					);
-
-				memrel(myenc);
-			}
-			memrel(rtng);
-		}
-		memrel(weig);
-	} 
-	ok = myenc != NULL && rtng != NULL && weig != NULL;
-
-	if (!ok) {
+	struct SUPERSET q;
+	struct SUPERONE *s;
+	player_t *pos;
+	double *rtng, *weig;
+	size_t np = (size_t)n_players + 1;
+	size_t ne = 2 * (size_t)N_enc + 1;
+
+	s		= memnew (sizeof(struct SUPERONE) * np);
+	pos		= memnew (sizeof(player_t) * np);
+	rtng	= memnew (sizeof(double) * ne);
+	weig	= memnew (sizeof(double) * ne);
+
+	if (NULL == s || NULL == pos || NULL == rtng || NULL == weig) {
 		fprintf(stderr,"not enough memory for allocation in rate_super_players.");
 		exit(EXIT_FAILURE);
 	}
 
-	return;
+	q.deq = deq;
+	q.beta = beta;
+	q.n = 0;
+
+	rate_super_players_internal
+		( quiet
+		, enc
+		, N_enc
+		, performance_type
+		, n_players
+		, ratingof
+		, white_advantage
+		, flagged
+		, Name
+		, cpus
+		, &q
+		, s
+		, pos
+		, rtng
+		, weig
+		);
+
+	memrel (weig);
+	memrel (rtng);
+	memrel (pos);
+	memrel (s);
 }
-
@@ -42,6 +42,7 @@ rate_super_players 	( bool_t quiet
 					, const char *Name[]
 					, double deq
 					, double beta
+					, int cpus
 );
 
 /*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
@@ -216,6 +216,8 @@ players_init (player_t n, struct PLAYERS *x)
 	x->performance_type = pv[5]; 
 
 	x->perf_set = FALSE;
+	x->nameidx = NULL;
+	x->nameidx_size = 0;
 
 	return TRUE;
 }
@@ -225,22 +227,28 @@ players_done (struct PLAYERS *x)
 {
 	assert(x->name);
 	assert(x->flagged);
+	assert(x->present_in_games);
 	assert(x->prefed);
 	assert(x->priored);
 	assert(x->performance_type);
 
 	memrel(x->name);
 	memrel(x->flagged);
+	memrel(x->present_in_games);
 	memrel(x->prefed);
 	memrel(x->priored);
 	memrel(x->performance_type);
+	if (x->nameidx) memrel(x->nameidx);
 	x->n = 0;
 	x->size	= 0;
 	x->name = NULL;
 	x->flagged = NULL;
+	x->present_in_games = NULL;
 	x->prefed = NULL;
 	x->priored = NULL;
 	x->performance_type = NULL;
+	x->nameidx = NULL;
+	x->nameidx_size = 0;
 } 
 
 #include "plyrs.h"
@@ -50,6 +50,7 @@
 #include "mymem.h"
 #include "report.h"
 #include "plyrs.h"
+#include "warmst.h"
 #include "namehash.h"
 #include "relprior.h"
 #include "inidone.h"
@@ -57,6 +58,11 @@
 #include "ra.h"
 #include "sim.h"
 #include "summations.h"
+#include "pairlist.h"
+#include "simfile.h"
+#include "simckpt.h"
+#include "covar.h"
+#include "grprate.h"
 #include "myopt.h"
 #include "sysport/sysport.h"
 
@@ -153,7 +159,23 @@ struct helpline SH[] = {
 {'j',	"head2head",	required_argument,	"FILE",		0,	"output file with head to head information"},
 {'g',	"groups",		required_argument,	"FILE",		0,	"outputs group connection info (no rating output)"},
 {'G',	"force",		no_argument,		NULL,		0,	"force program to run ignoring isolated-groups warning"},
+{'\0',	"groups-apart",	no_argument,		NULL,		0,	"if the database is not well connected, rate each group (see -g) on its own, in parallel with -n"},
 {'s',	"simulations",	required_argument,	"NUM",		0,	"perform NUM simulations to calculate errors"},
+{'\0',	"bootstrap",	required_argument,	"MODE",		0,	"simulations resample the games (MODE = games) or the encounters (MODE = encounters) instead of using the ratings obtained"},
+{'\0',	"sim-warm",		no_argument,		NULL,		0,	"each simulation starts from the ratings obtained, not from the pool average"},
+{'\0',	"sim-pairs",	required_argument,	"MODE",		0,	"pairs with simulated errors: auto, none, adjacent, all or NUM (top NUM players)"},
+{'\0',	"sim-pairs-file",required_argument,	"FILE",		0,	"extra pairs with simulated errors, each line from FILE being \"PlayerA\",\"PlayerB\""},
+{'\0',	"sim-save",		required_argument,	"FILE",		0,	"save every simulated run (ratings, white advantage and draw rate) to FILE"},
+{'\0',	"sim-query",	required_argument,	"FILE",		0,	"errors, CFS and intervals from FILE (saved with --sim-save) without simulating again"},
+{'\0',	"sim-checkpoint",required_argument,	"FILE",		0,	"save the progress of the simulations to FILE from time to time (see --resume)"},
+{'\0',	"sim-checkpoint-every",required_argument,"NUM",	0,	"seconds between checkpoints (default=600)"},
+{'\0',	"resume",		no_argument,		NULL,		0,	"continue the simulations saved with --sim-checkpoint"},
+{'\0',	"sim-precision",	required_argument,	"<a,b>",	0,	"simulate until the errors have a standard error below a, for the top b players (optional), -s is the maximum"},
+{'\0',	"sim-shard",		required_argument,	"<i/N>",	0,	"only simulate the part i of N, saved with --sim-checkpoint (see --sim-merge)"},
+{'\0',	"sim-merge",		required_argument,	"FILE",		0,	"errors from the parts saved by --sim-shard, FILE is the list of their files"},
+{'\0',	"sim-control",	no_argument,		NULL,		0,	"simulations use the linear prediction of their ratings as control variates, fewer are needed (see --analytic-errors)"},
+{'\0',	"analytic-errors",no_argument,		NULL,		0,	"errors from the curvature of the fit at the ratings obtained, instead of simulations (-s)"},
+{'\0',	"seed",			required_argument,	"NUM",		0,	"seed for the random numbers of the simulations (default=1324561)"},
 {'e',	"error-matrix",	required_argument,	"FILE",		0,	"save an error matrix (use of -s required)"},
 {'C',	"cfs-matrix",	required_argument,	"FILE",		0,	"save a matrix (comma separated value .csv) with confidence for superiority (-s was used)"},
 {'J',	"cfs-show",		no_argument,		NULL,		0,	"output an extra column with confidence for superiority (relative to the player in the next row)"},
@@ -162,7 +184,7 @@ struct helpline SH[] = {
 {'t',	"threshold",	required_argument,	"NUM",		0,	"threshold of games for a participant to be included"},
 {'N',	"decimals",		required_argument,	"<a,b>",	0,	"a=rating decimals, b=score decimals (optional)"},
 {'M',	"ML",			no_argument,		NULL,		0,	"force maximum-likelihood estimation to obtain ratings"},
-{'n',	"cpus",			required_argument,	"NUM",		0,	"number of processors used in simulations"},
+{'n',	"cpus",			required_argument,	"NUM",		0,	"number of processors used in simulations and analytic errors"},
 {'U',	"columns",		required_argument,	"<a,..,z>",	0,	"info in output (default columns are \"0,1,2,3,4,5\")"},
 {'Y',	"synonyms",		required_argument,	"FILE",		0,	"name synonyms (comma separated value format). Each line: main,syn1,syn2 or \"main\",\"syn1\",\"syn2\""},
 {'\0',	"aliases",		required_argument,	"FILE",		0,	"same as --synonyms FILE"},
@@ -170,6 +192,9 @@ struct helpline SH[] = {
 {'x',	"exclude",		required_argument,	"FILE",		0,	"names in FILE will not have their games included"},
 {'\0',	"no-warnings",	no_argument,		NULL,		0,	"supress warnings of names from -x or -i that do not match names in input file"},
 {'b',	"column-format",required_argument,	"FILE",		0,	"format column output, each line form FILE being <column>,<width>,\"Header\""},
+{'\0',	"warm-start",	required_argument,	"FILE",		0,	"ratings from FILE (output of -c or --warm-save) are the starting point of the calculation"},
+{'\0',	"warm-save",	required_argument,	"FILE",		0,	"save ratings, white advantage and draw rate to FILE to be used later with --warm-start"},
+{'\0',	"active-set",	no_argument,		NULL,		0,	"players that stopped moving are frozen during the calculation (faster with unevenly connected pools)"},
 
 {0,		NULL,			0,					NULL,		0,	NULL},
 
@@ -197,6 +222,13 @@ static double	General_average = 2300.0;
 
 static long 	Simulate = 0;
 
+#define SIMULATE_MAX_DEFAULT 100000	// with --sim-precision and no -s
+#define ERRORS_ANALYTIC 2			// for the reports, as if errors were simulated (they show errors after 2 or more)
+
+enum 			SimPairs	{SIMPAIRS_AUTO, SIMPAIRS_NONE, SIMPAIRS_ADJACENT, SIMPAIRS_ALL, SIMPAIRS_TOP};
+static int		Sim_pairs = SIMPAIRS_AUTO;
+static player_t	Sim_pairs_top = 0;
+
 #define INVBETA 175.25
 
 static double	White_advantage = 0;
@@ -273,6 +305,302 @@ strlist_multipush (strlist_t *sl, const char *finp_name)
 |
 \*--------------------------------------------------------------*/
 
+// report from a file of simulated runs (--sim-query), no input games needed
+static void
+simulations_query (const char *fname, const char *pairsfile, const char *outname, bool_t quietmode)
+{
+	struct SIMSAMPLES ss;
+	struct PLAYERS plyrs;
+	struct PAIRLIST pl;
+	FILE *f;
+
+	if (!simsamples_load (fname, &ss)) {
+		fprintf (stderr, "Problems reading the file of simulated runs \"%s\"\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!pairlist_init (&pl)) {
+		fprintf (stderr, "Not enough memory for the list of pairs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (NULL != pairsfile) {
+		// only the names are needed to find the players of each pair
+		memset (&plyrs, 0, sizeof(plyrs));
+		plyrs.n 	= ss.n;
+		plyrs.name 	= ss.name;
+		plyrs.nameidx = NULL;
+		pairlist_load (quietmode, pairsfile, &plyrs, &pl);
+	}
+
+	if (NULL == outname) {
+		f = stdout;
+	} else if (NULL == (f = fopen (outname, "w"))) {
+		fprintf (stderr, "Errors with file: %s\n", outname);
+		exit(EXIT_FAILURE);
+	}
+
+	simsamples_report (f, &ss, Confidence/100.0, confidence2x(Confidence/100.0), &pl, OUTDECIMALS);
+
+	if (f != stdout) fclose (f);
+	pairlist_done (&pl);
+	simsamples_done (&ss);
+}
+
+// decides which pairs of players keep their simulated errors, and allocates sfe
+static void
+summations_scope	( bool_t quietmode
+					, bool_t matrices 		// -e or -C need all the pairs
+					, bool_t head2head
+					, const char *pairsfile
+					, const struct PLAYERS *plyrs
+					, const struct RATINGS *rat
+					, const struct ENCOUNTERS *enc
+					, struct output_qualifiers outqual
+					, struct summations *sm /*@out@*/)
+{
+	struct PAIRLIST pl;
+	player_t *top = NULL;
+	player_t top_n = 0;
+	int pairmode;
+	size_t mem;
+	double mb;
+
+	if (!pairlist_init (&pl)) {
+		fprintf (stderr, "Not enough memory for the list of pairs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (matrices || Sim_pairs == SIMPAIRS_ALL) {
+		pairmode = PAIRS_TABLE;
+		top_n = plyrs->n;
+		if (matrices && Sim_pairs != SIMPAIRS_ALL && Sim_pairs != SIMPAIRS_AUTO && !quietmode)
+			printf ("Error or CFS matrix requested (-e/-C), errors kept for all pairs of players\n");
+	} else if (Sim_pairs == SIMPAIRS_TOP) {
+		pairmode = PAIRS_TABLE;
+		if (NULL == (top = memnew (sizeof(player_t) * (size_t)(Sim_pairs_top + 1)))) {
+			fprintf (stderr, "Not enough memory for the list of top players\n");
+			exit(EXIT_FAILURE);
+		}
+		top_n = report_top_players (plyrs, rat, outqual, Sim_pairs_top, top);
+	} else {
+		if (Sim_pairs != SIMPAIRS_NONE)
+			report_adjacent_pairs (plyrs, rat, &RPset, Hide_old_ver, outqual, &pl);
+		if (Sim_pairs == SIMPAIRS_AUTO && head2head)
+			pairlist_opponents (enc, &pl);
+		if (NULL != pairsfile)
+			pairlist_load (quietmode, pairsfile, plyrs, &pl);
+		pairmode = pl.n > 0? PAIRS_LIST: PAIRS_NONE;
+	}
+
+	mem = summations_memory (plyrs->n, pairmode, top_n, pl.n);
+	mb = (double)mem / (1024.0 * 1024.0);
+
+	if (!quietmode) {
+		if (pairmode == PAIRS_TABLE)
+			printf ("Simulated errors kept for all pairs among %ld players, memory %.1f MB\n", (long)top_n, mb);
+		else if (pairmode == PAIRS_LIST)
+			printf ("Simulated errors kept for up to %ld pairs of players, memory %.1f MB\n", (long)pl.n, mb);
+		else
+			printf ("Simulated errors kept for individual players only, memory %.1f MB\n", mb);
+	}
+
+	if (!summations_calloc (sm, plyrs->n, pairmode, top, top_n, pl.x, pl.n)) {
+		fprintf (stderr, "Not enough memory for the simulation errors (%.1f MB)\n", mb);
+		fprintf (stderr, "Try restricting the pairs of players with --sim-pairs (e.g. adjacent or none)\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (top) memrel(top);
+	pairlist_done (&pl);
+}
+
+// switches that change the simulated runs, a checkpoint is only valid with the same ones
+static unsigned
+simckpt_options	( bool_t prior_mode
+				, bool_t adjust_white_advantage
+				, bool_t adjust_draw_rate
+				, bool_t anchor_use
+				, bool_t anchor_err_rel2avg
+				, bool_t sim_warm
+				, bool_t active_set
+				, bool_t control
+				, int resample)
+{
+	unsigned x = 0;
+	if (prior_mode) 			x |= 1u << 0;
+	if (adjust_white_advantage)	x |= 1u << 1;
+	if (adjust_draw_rate)		x |= 1u << 2;
+	if (anchor_use)				x |= 1u << 3;
+	if (anchor_err_rel2avg)		x |= 1u << 4;
+	if (sim_warm)				x |= 1u << 5;
+	if (active_set)				x |= 1u << 6;
+	if (control)				x |= 1u << 7;
+	x |= (unsigned)resample << 8;
+	return x;
+}
+
+// work saved by --active-set
+static void
+activeset_report (const struct ACTIVESTATS *a)
+{
+	printf ("Active set: %.1f%s of the player updates calculated, %ld players active in the last round\n"
+			, a->full > 0? 100.0 * (double)a->steps / (double)a->full: 100.0, "%"
+			, (long)a->last);
+}
+
+// loads the checkpoint of --sim-checkpoint into sm, if there is one (--resume)
+static void
+simulations_resume	( bool_t quietmode
+					, bool_t shard
+					, struct SIMCKPT *ckpt		// io, first and last expected
+					, const struct RATINGS *rat
+					, double wadv
+					, double drate
+					, struct summations *sm)
+{
+	long first = ckpt->first;
+	long last = ckpt->last;
+
+	switch (simckpt_load (ckpt, rat->ratingof_results, wadv, drate, sm)) {
+		case SIMCKPT_LOADED:
+			// a whole simulation could continue with more runs, a shard could not
+			if (ckpt->first != first || (shard && ckpt->last != last)) {
+				fprintf (stderr, "Checkpoint \"%s\" is for simulations %ld to %ld, not %ld to %ld\n"
+						, ckpt->fname, ckpt->first + 1, ckpt->last, first + 1, last);
+				exit(EXIT_FAILURE);
+			}
+			if (ckpt->done > last) {
+				fprintf (stderr, "Checkpoint \"%s\" has %ld simulations, more than the %ld requested\n", ckpt->fname, ckpt->done, last);
+				exit(EXIT_FAILURE);
+			}
+			ckpt->last = last;
+			if (!quietmode)
+				printf ("Resuming from checkpoint \"%s\", %ld of %ld simulations done\n", ckpt->fname, ckpt->done - first, last - first);
+			break;
+		case SIMCKPT_ABSENT:
+			if (!quietmode)
+				printf ("No checkpoint \"%s\" to resume, simulations start from the beginning\n", ckpt->fname);
+			break;
+		case SIMCKPT_MISMATCH:
+			fprintf (stderr, "Checkpoint \"%s\" was saved with different games or switches\n", ckpt->fname);
+			exit(EXIT_FAILURE);
+		default:
+			fprintf (stderr, "Problems reading the checkpoint file \"%s\"\n", ckpt->fname);
+			exit(EXIT_FAILURE);
+	}
+}
+
+struct SHARDFILE {
+	const char *	fname;
+	long			first;
+	long			last;
+};
+
+static int
+compare_shardfile (const void *a, const void *b)
+{
+	const struct SHARDFILE *x = a;
+	const struct SHARDFILE *y = b;
+	return x->first < y->first? -1: (x->first > y->first? 1: 0);
+}
+
+static void
+shard_load (const struct SIMCKPT *settings, const char *fname, const struct RATINGS *rat, double wadv, double drate
+			, struct SIMCKPT *c /*@out@*/, struct summations *part /*@out@*/)
+{
+	*c = *settings;
+	c->fname = fname;
+	switch (simckpt_load (c, rat->ratingof_results, wadv, drate, part)) {
+		case SIMCKPT_LOADED:
+			if (c->done == c->last) 
+				return;
+			fprintf (stderr, "Shard \"%s\" is not finished, %ld of %ld simulations done\n", fname, c->done - c->first, c->last - c->first);
+			break;
+		case SIMCKPT_ABSENT:
+			fprintf (stderr, "Shard \"%s\" could not be opened\n", fname);
+			break;
+		case SIMCKPT_MISMATCH:
+			fprintf (stderr, "Shard \"%s\" was simulated with different games or switches\n", fname);
+			break;
+		default:
+			fprintf (stderr, "Problems reading the shard file \"%s\"\n", fname);
+			break;
+	}
+	exit(EXIT_FAILURE);
+}
+
+// summations of all the runs from the shards listed in file "listname" (--sim-merge)
+static void
+simulations_merge	( bool_t quietmode
+					, const char *listname
+					, const struct SIMCKPT *settings
+					, const struct RATINGS *rat
+					, double wadv
+					, double drate
+					, long simulate
+					, struct summations *sm 	// allocated, cleared
+					)
+{
+	strlist_t sl;
+	struct SHARDFILE *shard;
+	struct SIMCKPT c;
+	struct summations part;
+	const char *fname;
+	long i, n;
+
+	if (!strlist_init (&sl) || !strlist_multipush (&sl, listname)) {
+		fprintf (stderr, "Errors in file \"%s\", or lack of memory\n", listname);
+		exit(EXIT_FAILURE);
+	}
+	for (n = 0, strlist_rwnd (&sl); NULL != strlist_next (&sl); n++) {}
+
+	if (NULL == (shard = memnew (sizeof(struct SHARDFILE) * (size_t)(n > 0? n: 1)))
+		|| !summations_calloc (&part, sm->nplayers, sm->pairmode, sm->table, sm->table_n, sm->pair, sm->pair_n)
+		|| (sm->control && !summations_control_calloc (&part))) {
+		fprintf (stderr, "Not enough memory to merge the shards\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// the shards could be listed in any order, but they are merged in the order of the runs
+	for (i = 0, strlist_rwnd (&sl); NULL != (fname = strlist_next (&sl)); i++) {
+		shard_load (settings, fname, rat, wadv, drate, &c, &part);
+		shard[i].fname = fname;
+		shard[i].first = c.first;
+		shard[i].last  = c.last;
+	}
+	qsort (shard, (size_t)n, sizeof(struct SHARDFILE), compare_shardfile);
+
+	for (i = 0; i < n; i++) {
+		long expected = i > 0? shard[i-1].last: 0;
+		if (shard[i].first > expected) {
+			fprintf (stderr, "Shards do not have simulations %ld to %ld\n", expected + 1, shard[i].first);
+			exit(EXIT_FAILURE);
+		}
+		if (shard[i].first < expected) {
+			fprintf (stderr, "Shards repeat simulations %ld to %ld\n", shard[i].first + 1, expected);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (n == 0 || shard[n-1].last != simulate) {
+		fprintf (stderr, "Shards have %ld simulations, %ld were requested (-s)\n", n > 0? shard[n-1].last: 0, simulate);
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < n; i++) {
+		shard_load (settings, shard[i].fname, rat, wadv, drate, &c, &part);
+		summations_merge (sm, &part, (double)shard[i].first, (double)(shard[i].last - shard[i].first));
+	}
+	summations_calc_sdev (sm, (double)simulate);
+
+	if (!quietmode)
+		printf ("Simulations merged from %ld shards\n", n);
+
+	summations_done (&part);
+	memrel (shard);
+	strlist_done (&sl);
+}
+
 #include "strlist.h"
 
 static bool_t
@@ -298,6 +626,7 @@ int main (int argc, char *argv[])
 	struct PLAYERS 		Players;
 	struct RATINGS 		RA;
 	struct ENCOUNTERS 	Encounters;
+	struct ENCOUNTERS 	Encounters_full;	// every game, no player excluded
 
 	double white_advantage_result;
 	double drawrate_evenmatch_result;
@@ -311,6 +640,7 @@ int main (int argc, char *argv[])
 	FILE *csvf;
 	FILE *textf;
 	FILE *groupf;
+	FILE *samplef = NULL;
 
 	bool_t quiet_mode;
 	bool_t sim_updates;
@@ -331,13 +661,32 @@ int main (int argc, char *argv[])
 
 	const char *textstr, *csvstr, *ematstr, *groupstr, *pinsstr;
 	const char *priorsstr, *relstr;
+	const char *warmstr, *warmsavestr;
 	const char *head2head_str;
 	const char *ctsmatstr, *synstr;
+	const char *simpairsfile_str, *simsave_str, *simquery_str, *simckpt_str, *simmerge_str;
 	const char *output_columns;
 	const char *output_decimals;
 	const char *includes_str, *excludes_str, *columns_format_str, *multi_pgn, *single_pgn;
 	int version_mode, help_mode, switch_mode, license_mode, input_mode, table_mode;
-	bool_t group_is_output, Elostat_output, Ignore_draws, groupcheck, Forces_ML, cfs_column;
+	bool_t group_is_output, Elostat_output, Ignore_draws, groupcheck, Forces_ML, cfs_column, sim_warm, active_set;
+	unsigned long rnd_seed;
+	long ckpt_interval;
+	long shard_i, shard_n;
+	long precision_top;
+	double precision;
+	player_t *precision_watch;
+	struct SIMTARGET target;
+	bool_t resume_mode;
+	struct SIMCKPT ckpt;
+	bool_t analytic_mode;
+	bool_t control_mode;
+	struct COVLIN covlin;
+	bool_t apart_mode;
+	struct GROUPRATE grouprate;
+	struct ACTIVESTATS activestats = {0, 0, 0};
+	int sim_resample;
+	long errors_sim;	// reports have errors when > 1, as after that many simulations
 	bool_t switch_w=FALSE, switch_W=FALSE, switch_u=FALSE, switch_d=FALSE, switch_k=FALSE, switch_D=FALSE;
 
 	strlist_t SL;
@@ -360,9 +709,27 @@ int main (int argc, char *argv[])
 	csvstr       			= NULL;
 	ematstr 	 			= NULL;
 	ctsmatstr	 			= NULL;
+	simpairsfile_str		= NULL;
+	simsave_str				= NULL;
+	simquery_str			= NULL;
+	simckpt_str				= NULL;
+	simmerge_str			= NULL;
+	precision				= 0;
+	precision_top			= 0;
+	precision_watch			= NULL;
+	shard_i					= 0;
+	shard_n					= 0;
+	ckpt_interval			= 600;
+	resume_mode				= FALSE;
+	analytic_mode			= FALSE;
+	control_mode			= FALSE;
+	apart_mode				= FALSE;
+	sim_resample			= SIM_PARAMETRIC;
 	pinsstr		 			= NULL;
 	priorsstr	 			= NULL;
 	relstr		 			= NULL;
+	warmstr		 			= NULL;
+	warmsavestr	 			= NULL;
 	synstr					= NULL;
 	includes_str			= NULL;
 	excludes_str			= NULL;
@@ -379,6 +746,9 @@ int main (int argc, char *argv[])
 	Ignore_draws 			= FALSE;
 	Forces_ML 	 			= FALSE;
 	cfs_column      		= FALSE;
+	sim_warm				= FALSE;
+	active_set				= FALSE;
+	rnd_seed				= 1324561;
 	dowarning				= TRUE;
 
 	// global default
@@ -408,6 +778,79 @@ int main (int argc, char *argv[])
 							dowarning = FALSE;
 						} else if (!strcmp(long_options[longoidx].name, "timelog")) {
 							TIMELOG = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "warm-start")) {
+							warmstr = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "warm-save")) {
+							warmsavestr = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "active-set")) {
+							active_set = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "bootstrap")) {
+							if (!strcmp(opt_arg, "games")) {
+								sim_resample = SIM_BOOTSTRAP_GAMES;
+							} else if (!strcmp(opt_arg, "encounters")) {
+								sim_resample = SIM_BOOTSTRAP_ENC;
+							} else {
+								fprintf(stderr, "wrong bootstrap parameter\n");
+								exit(EXIT_FAILURE);
+							}
+						} else if (!strcmp(long_options[longoidx].name, "sim-warm")) {
+							sim_warm = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "sim-pairs")) {
+							long top;
+							if (!strcmp(opt_arg, "auto")) {
+								Sim_pairs = SIMPAIRS_AUTO;
+							} else if (!strcmp(opt_arg, "none")) {
+								Sim_pairs = SIMPAIRS_NONE;
+							} else if (!strcmp(opt_arg, "adjacent")) {
+								Sim_pairs = SIMPAIRS_ADJACENT;
+							} else if (!strcmp(opt_arg, "all")) {
+								Sim_pairs = SIMPAIRS_ALL;
+							} else if (1 == sscanf(opt_arg,"%ld", &top) && top > 0) {
+								Sim_pairs = SIMPAIRS_TOP;
+								Sim_pairs_top = (player_t)top;
+							} else {
+								fprintf(stderr, "wrong sim-pairs parameter\n");
+								exit(EXIT_FAILURE);
+							}
+						} else if (!strcmp(long_options[longoidx].name, "sim-pairs-file")) {
+							simpairsfile_str = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "sim-save")) {
+							simsave_str = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "sim-query")) {
+							simquery_str = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "sim-checkpoint")) {
+							simckpt_str = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "sim-checkpoint-every")) {
+							if (1 != sscanf(opt_arg,"%ld", &ckpt_interval) || ckpt_interval < 1) {
+								fprintf(stderr, "wrong sim-checkpoint-every parameter\n");
+								exit(EXIT_FAILURE);
+							}
+						} else if (!strcmp(long_options[longoidx].name, "resume")) {
+							resume_mode = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "sim-precision")) {
+							int n = sscanf(opt_arg,"%lf,%ld", &precision, &precision_top);
+							if (n < 1 || precision <= 0 || (n == 2 && precision_top < 1)) {
+								fprintf(stderr, "wrong sim-precision parameter\n");
+								exit(EXIT_FAILURE);
+							}
+						} else if (!strcmp(long_options[longoidx].name, "sim-shard")) {
+							if (2 != sscanf(opt_arg,"%ld/%ld", &shard_i, &shard_n) || shard_n < 1 || shard_i < 1 || shard_i > shard_n) {
+								fprintf(stderr, "wrong sim-shard parameter\n");
+								exit(EXIT_FAILURE);
+							}
+						} else if (!strcmp(long_options[longoidx].name, "sim-merge")) {
+							simmerge_str = opt_arg;
+						} else if (!strcmp(long_options[longoidx].name, "analytic-errors")) {
+							analytic_mode = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "sim-control")) {
+							control_mode = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "groups-apart")) {
+							apart_mode = TRUE;
+						} else if (!strcmp(long_options[longoidx].name, "seed")) {
+							if (1 != sscanf(opt_arg,"%lu", &rnd_seed)) {
+								fprintf(stderr, "wrong seed parameter\n");
+								exit(EXIT_FAILURE);
+							}
 						} else {
 							fprintf (stderr, "ERROR: %d\n", op);
 							exit(EXIT_FAILURE);
@@ -607,6 +1050,50 @@ int main (int argc, char *argv[])
 		table_output(Rtng_76);
 		exit (EXIT_SUCCESS);
 	}
+	if (NULL != simquery_str) {
+		simulations_query (simquery_str, simpairsfile_str, textstr, quiet_mode);
+		exit (EXIT_SUCCESS);
+	}
+	if (resume_mode && NULL == simckpt_str) {
+		fprintf (stderr, "Switch --resume needs the file given by --sim-checkpoint\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (shard_n > 0 && NULL == simckpt_str) {
+		fprintf (stderr, "Switch --sim-shard needs the file given by --sim-checkpoint to save the part simulated\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (NULL != simmerge_str && (shard_n > 0 || NULL != simckpt_str || NULL != simsave_str)) {
+		fprintf (stderr, "Switch --sim-merge does not simulate, it cannot be used with --sim-shard, --sim-checkpoint or --sim-save\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (precision > 0 && (shard_n > 0 || NULL != simmerge_str)) {
+		fprintf (stderr, "Switch --sim-precision cannot be used with --sim-shard or --sim-merge, they need a fixed number of simulations\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (analytic_mode && (Simulate > 1 || precision > 0 || shard_n > 0 || NULL != simmerge_str 
+							|| NULL != simckpt_str || NULL != simsave_str || sim_resample != SIM_PARAMETRIC || control_mode)) {
+		fprintf (stderr, "Switch --analytic-errors does not simulate, it cannot be used with -s or the other simulation switches\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (precision > 0 && Simulate < 2) {
+		Simulate = SIMULATE_MAX_DEFAULT;
+	}
+	if (control_mode && sim_resample != SIM_PARAMETRIC) {
+		fprintf (stderr, "Switch --sim-control cannot be used with --bootstrap\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (control_mode && Simulate < 2) {
+		fprintf (stderr, "Switch --sim-control needs simulations (-s)\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if (sim_resample != SIM_PARAMETRIC && Simulate < 2) {
+		fprintf (stderr, "Switch --bootstrap needs simulations (-s)\n\n");
+		exit(EXIT_FAILURE);
+	}
+	if ((shard_n > 0 || NULL != simmerge_str) && Simulate < 2) {
+		fprintf (stderr, "Switches --sim-shard and --sim-merge need the total number of simulations (-s)\n\n");
+		exit(EXIT_FAILURE);
+	}
 	if (!input_mode && argc == opt_index) {
 		fprintf (stderr, "Need file name to proceed\n\n");
 		exit(EXIT_FAILURE);
@@ -687,10 +1174,19 @@ int main (int argc, char *argv[])
 		fprintf (stderr, "Switches -g and -G cannot be used at the same time\n\n");
 		exit(EXIT_FAILURE);
 	}				
+	if (apart_mode && (!groupcheck || Simulate > 1 || analytic_mode || NULL != priorsstr || NULL != relstr 
+						|| NULL != head2head_str || Elostat_output || NULL != warmstr || NULL != warmsavestr)) {
+		fprintf (stderr, "Switch --groups-apart cannot be used with -G, -s, --analytic-errors, -y, -r, -j, -E, --warm-start or --warm-save\n\n");
+		exit(EXIT_FAILURE);
+	}				
 	if (includes_str && excludes_str) {
 		fprintf (stderr, "Switches -x and -i cannot be used at the same time\n\n");
 		exit(EXIT_FAILURE);
 	}	
+	if (simpairsfile_str && (Sim_pairs == SIMPAIRS_ALL || Sim_pairs == SIMPAIRS_TOP)) {
+		fprintf (stderr, "Switch --sim-pairs-file only works with --sim-pairs auto, none or adjacent\n\n");
+		exit(EXIT_FAILURE);
+	}	
 
 	Prior_mode = switch_k || switch_u || NULL != relstr || NULL != priorsstr;
 
@@ -792,6 +1288,14 @@ int main (int argc, char *argv[])
 
 	/*==== more memory initialization ====*/
 
+	if (!players_name_index_build (&Players)) {
+		ratings_done (&RA);
+		games_done (&Games);
+		encounters_done (&Encounters);
+		players_done(&Players);
+		fprintf (stderr, "Could not initialize Players name index memory\n"); exit(EXIT_FAILURE);
+	}
+
 	if (!supporting_auxmem_init (Players.n, &PP, &PP_store)) {
 		ratings_done (&RA);
 		games_done (&Games);
@@ -930,6 +1434,17 @@ int main (int argc, char *argv[])
 		}
 	}
 
+	// warm start, previous ratings as a starting point
+	if (warmstr != NULL) {
+		double wa = White_advantage;
+		double dr = Drawrate_evenmatch;
+		warmstart_load (quiet_mode, warmstr, &Players, &RA, &wa, &dr);
+		if (adjust_white_advantage)
+			White_advantage = wa;
+		if (adjust_draw_rate && dr > 0.0 && dr < 1.0)
+			Drawrate_evenmatch = dr;
+	}
+
 	// open files
 	textf = NULL;
 	textf_opened = FALSE;
@@ -973,12 +1488,10 @@ int main (int argc, char *argv[])
 	|  BEGIN...
 	\*----------------------------------*/
 
-	mythread_mutex_init		(&Smpcount);
-	mythread_mutex_init		(&Groupmtx);
 	mythread_mutex_init		(&Summamtx);
 	mythread_mutex_init		(&Printmtx);
 
-	randfast_init (1324561);
+	randfast_init ((uint32_t)rnd_seed);
 
 	BETA = (-log(1.0/0.76-1.0)) / Rtng_76;
 
@@ -1044,13 +1557,18 @@ int main (int argc, char *argv[])
 	assert(players_have_clear_flags(&Players));
 	encounters_calculate(ENCOUNTERS_FULL, &Games, Players.flagged, &Encounters);
 
+	if (!encounters_init (Encounters.n, &Encounters_full)) {
+		fprintf (stderr, "Could not initialize Encounters memory\n"); exit(EXIT_FAILURE);
+	}
+	encounters_select (ENCOUNTERS_FULL, &Encounters, Players.flagged, &Encounters_full);
+
 	players_set_priored_info (PP, &RPset, &Players);
 	if (0 < players_set_super (quiet_mode, &Encounters, &Players)) {
 		players_purge (quiet_mode, &Players);
 		encounters_calculate(ENCOUNTERS_NOFLAGGED, &Games, Players.flagged, &Encounters);
 	}
 
-	if (groupcheck && !well_connected (&Encounters, &Players)) {
+	if (groupcheck && !apart_mode && !well_connected (&Encounters, &Players)) {
 			fprintf (stderr, "\n\n");
 			fprintf (stderr, "*************************[ WARNING ]*************************\n");
 			fprintf (stderr, "*       Database is not well connected by games...          *\n");
@@ -1063,6 +1581,83 @@ int main (int argc, char *argv[])
 			exit(EXIT_FAILURE);
 	}
 
+	if (groupcheck && apart_mode && !well_connected (&Encounters, &Players)) {
+		player_t g;
+		struct rel_prior_set no_rps = {0, NULL};
+
+		timelog("rate groups apart...");
+		if (!grouprate_split (&Games, &Players, &RA, &Encounters, Anchor_use? Anchor: -1, &grouprate)) {
+			fprintf (stderr, "Not enough memory to rate the groups apart\n");
+			exit(EXIT_FAILURE);
+		}
+		if (!quiet_mode) {
+			printf ("Database is not well connected, groups rated apart = %ld\n", (long)grouprate.n);
+			printf ("Games between groups, not used = %ld\n\n", (long)grouprate.apart);
+		}
+
+		grouprate_solve	( &grouprate
+						, cpus
+						, Forces_ML || Prior_mode
+						, adjust_white_advantage
+						, adjust_draw_rate
+						, Anchor_err_rel2avg
+						, active_set
+						, General_average
+						, BETA
+						, Wa_prior
+						, Dr_prior
+						, White_advantage
+						, Drawrate_evenmatch);
+
+		if (!quiet_mode && active_set) {
+			for (g = 0; g < grouprate.n; g++) {
+				if (!grouprate.g[g].rated) continue;
+				printf ("Group %ld, ", (long)g+1);
+				activeset_report (&grouprate.g[g].activestats);
+			}
+			printf ("\n");
+		}
+
+		timelog("output reports...");
+		for (g = 0; g < grouprate.n; g++) {
+			struct GROUPSUB *s = &grouprate.g[g];
+			if (textf) fprintf (textf, "\nGroup %ld\n", (long)g+1);
+			if (csvf) fprintf (csvf, "\"Group %ld\"\n", (long)g+1);
+			if (!s->rated) {
+				if (textf) fprintf (textf, "Not enough games within the group to be rated\n");
+				continue;
+			}
+			all_report 	( &s->games
+						, &s->plyrs
+						, &s->rat
+						, &no_rps
+						, &s->enc
+						, NULL
+						, 0
+						, Hide_old_ver
+						, Confidence_factor
+						, csvf
+						, textf
+						, s->white_advantage
+						, s->drawrate
+						, decimals_array_n > 0? decimals_array[0]: 1 //OUTDECIMALS
+						, decimals_array_n > 1? decimals_array[1]: 1 //OUTDECIMALS
+						, outqual
+						, 0
+						, 0
+						, NULL
+						, cfs_column
+						, columns
+						);
+		}
+		grouprate_done (&grouprate);
+
+		if (textf_opened) 	fclose (textf);
+		if (csvf_opened)  	fclose (csvf); 
+		if (!quiet_mode) printf ("\ndone!\n");
+		exit(EXIT_SUCCESS);
+	}
+
 	timelog("calculate rating...");
 
 	Encounters.n = calc_rating 	( quiet_mode
@@ -1071,6 +1666,9 @@ int main (int argc, char *argv[])
 								, adjust_draw_rate
 								, Anchor_use
 								, Anchor_err_rel2avg
+								, warmstr != NULL? WARM_PREVIOUS: WARM_NONE
+								, cpus
+								, active_set? &activestats: NULL
 
 								, General_average
 								, Anchor
@@ -1081,7 +1679,8 @@ int main (int argc, char *argv[])
 								, &RPset
 								, &Players
 								, &RA
-								, &Games
+								, &Encounters_full
+								, Games.n
 
 								, PP
 								, Wa_prior
@@ -1089,9 +1688,14 @@ int main (int argc, char *argv[])
 
 								, &White_advantage
 								, &Drawrate_evenmatch
-
+								, NULL
 								);
 
+	if (!quiet_mode && active_set) {
+		activeset_report (&activestats);
+		printf ("\n");
+	}
+
 	ratings_results	( Anchor_err_rel2avg
 					, Anchor_use 
 					, Anchor
@@ -1102,48 +1706,208 @@ int main (int argc, char *argv[])
 	white_advantage_result = White_advantage;
 	drawrate_evenmatch_result = Drawrate_evenmatch;
 
+	if (warmsavestr != NULL) {
+		warmstart_save (warmsavestr, &Players, &RA, white_advantage_result, drawrate_evenmatch_result);
+	}
+
 	/*== simulation ========*/
 
 	/* Simulation block, begin */
 	if (Simulate > 1) {
-		timelog("simulation block...");
-		simul_smp
-				( cpus
-				, Simulate
-				, sim_updates
-				, quiet_mode
-				, Forces_ML || Prior_mode
-				, adjust_white_advantage
-				, adjust_draw_rate
-				, Anchor_use
-				, Anchor_err_rel2avg
-
-				, General_average
-				, Anchor
-				, Priored_n
-				, BETA
+		timelog("allocate summations for errors...");
+		summations_scope	( quiet_mode
+							, NULL != ematstr || NULL != ctsmatstr
+							, NULL != head2head_str
+							, simpairsfile_str
+							, &Players
+							, &RA
+							, &Encounters
+							, outqual
+							, &sfe);
+
+		// all the runs, or only those of a shard
+		ckpt.first = shard_n > 0? (shard_i - 1) * Simulate / shard_n: 0;
+		ckpt.last  = shard_n > 0? shard_i * Simulate / shard_n: Simulate;
+		ckpt.done  = ckpt.first;
+
+		// settings that a checkpoint or a shard must have
+		ckpt.fname				= simckpt_str;
+		ckpt.interval			= ckpt_interval;
+		ckpt.seed				= (uint32_t)rnd_seed;
+		ckpt.options			= simckpt_options (Forces_ML || Prior_mode, adjust_white_advantage, adjust_draw_rate
+												, Anchor_use, Anchor_err_rel2avg, sim_warm, active_set, control_mode, sim_resample);
+		ckpt.anchor				= Anchor;
+		ckpt.beta				= BETA;
+		ckpt.general_average	= General_average;
+
+		// before a checkpoint or the shards are loaded, they have the controls too
+		if (control_mode) {
+			timelog("control variates...");
+			if (!summations_control_calloc (&sfe)
+				|| !covlin_init	( &covlin
+								, cpus
+								, Forces_ML || Prior_mode
+								, adjust_white_advantage
+								, Anchor_err_rel2avg
+								, BETA
+								, white_advantage_result
+								, drawrate_evenmatch_result
+								, Priored_n
+								, PP
+								, &RPset
+								, Wa_prior
+								, &Encounters_full
+								, &Players
+								, &RA
+								, &sfe)) {
+				fprintf (stderr, "Control variates could not be prepared (not enough memory, or ratings not defined by the games), use -s without --sim-control\n");
+				exit(EXIT_FAILURE);
+			}
+		}
 
-				, drawrate_evenmatch_result
-				, white_advantage_result
-				, &RPset
-				, PP
-				, Wa_prior
-				, Dr_prior
+		if (NULL != simckpt_str && resume_mode) {
+			simulations_resume (quiet_mode, shard_n > 0, &ckpt, &RA, white_advantage_result, drawrate_evenmatch_result, &sfe);
+		}
 
-				, &Encounters
-				, &Players
-				, &RA
-				, &Games
+		if (NULL != simmerge_str) {
+			simulations_merge (quiet_mode, simmerge_str, &ckpt, &RA, white_advantage_result, drawrate_evenmatch_result, Simulate, &sfe);
+		} else {
+			if (NULL != simsave_str) {
+				if (ckpt.done > ckpt.first) {
+					samplef = simfile_reopen (simsave_str, Players.n, ckpt.done - ckpt.first);
+				} else {
+					samplef = simfile_create (simsave_str, &Players, RA.ratingof_results, white_advantage_result, drawrate_evenmatch_result);
+				}
+				if (NULL == samplef) {
+					if (ckpt.done > ckpt.first)
+						fprintf (stderr, "File %s does not have the %ld simulations of the checkpoint\n", simsave_str, ckpt.done - ckpt.first);
+					fprintf (stderr, "Errors with file: %s\n", simsave_str);
+					exit(EXIT_FAILURE);
+				}
+			}
 
-				, RPset_store
-				, PP_store
+			if (precision > 0) {
+				if (NULL == (precision_watch = memnew (sizeof(player_t) * (size_t)(Players.n + 1)))) {
+					fprintf (stderr, "Not enough memory for the list of players\n");
+					exit(EXIT_FAILURE);
+				}
+				target.precision	= precision;
+				target.factor		= Confidence_factor;
+				target.watch		= precision_watch;
+				target.watch_n		= report_top_players (&Players, &RA, outqual
+										, precision_top > 0? (player_t)precision_top: Players.n, precision_watch);
+			}
 
-				, &sfe
-				);
+			timelog("simulation block...");
+			Simulate = simul_smp
+					( cpus
+					, Simulate
+					, sim_updates
+					, quiet_mode
+					, Forces_ML || Prior_mode
+					, adjust_white_advantage
+					, adjust_draw_rate
+					, Anchor_use
+					, Anchor_err_rel2avg
+					, sim_warm
+					, active_set
+					, sim_resample
+
+					, General_average
+					, Anchor
+					, Priored_n
+					, BETA
+
+					, drawrate_evenmatch_result
+					, white_advantage_result
+					, &RPset
+					, PP
+					, Wa_prior
+					, Dr_prior
+
+					, &Encounters_full
+					, Games.n
+					, &Players
+					, &RA
+
+					, RPset_store
+					, PP_store
+
+					, &sfe
+					, samplef
+					, NULL != simckpt_str? &ckpt: NULL
+					, precision > 0? &target: NULL
+					, control_mode? &covlin: NULL
+					);
+
+			if (precision > 0) {
+				if (!quiet_mode)
+					printf ("Simulations done = %ld, largest standard error of the errors = %.2f (target %.2f)\n", Simulate
+							, Confidence_factor * summations_sdev_stderr (&sfe, target.watch, target.watch_n, (double)Simulate), precision);
+				memrel (precision_watch);
+				precision_watch = NULL;
+			}
+
+			if (NULL != samplef && 0 != fclose (samplef)) {
+				fprintf (stderr, "Errors with file: %s\n", simsave_str);
+				exit(EXIT_FAILURE);
+			}
+			samplef = NULL;
+		}
+
+		if (control_mode) {
+			double ess_smallest, ess_median;
+			if (!quiet_mode && summations_control_ess (&sfe, (double)Simulate, &ess_smallest, &ess_median))
+				printf ("Control variates, effective number of simulations = %.0f (median of the players), %.0f (smallest)\n"
+						, ess_median, ess_smallest);
+			covlin_done (&covlin);
+		}
 
+		if (shard_n > 0) {
+			if (!quiet_mode)
+				printf ("Simulations %ld to %ld (shard %ld of %ld) saved to \"%s\"\n", ckpt.first + 1, ckpt.last, shard_i, shard_n, simckpt_str);
+			exit(EXIT_SUCCESS);
+		}
 	}
 	/* Simulation block, end */
 
+	errors_sim = Simulate;
+
+	if (analytic_mode) {
+		timelog("analytical errors...");
+		summations_scope	( quiet_mode
+							, NULL != ematstr || NULL != ctsmatstr
+							, NULL != head2head_str
+							, simpairsfile_str
+							, &Players
+							, &RA
+							, &Encounters
+							, outqual
+							, &sfe);
+
+		if (!covar_errors	( cpus
+							, Forces_ML || Prior_mode
+							, adjust_white_advantage
+							, adjust_draw_rate
+							, Anchor_err_rel2avg
+							, BETA
+							, white_advantage_result
+							, drawrate_evenmatch_result
+							, Priored_n
+							, PP
+							, &RPset
+							, Wa_prior
+							, Dr_prior
+							, &Encounters
+							, &Players
+							, &RA
+							, &sfe)) {
+			fprintf (stderr, "Errors could not be calculated analytically (not enough memory, or ratings not defined by the games), use -s instead\n");
+			exit(EXIT_FAILURE);
+		}
+		errors_sim = ERRORS_ANALYTIC;
+	}
+
 	if (Simulate > 1) {
 		/* retransform database, to restore original data */
 		database_transform(pdaba, &Games, &Players, &Game_stats); 
@@ -1169,7 +1933,7 @@ int main (int argc, char *argv[])
 				, &RPset
 				, &Encounters
 				, sfe.sdev
-				, Simulate
+				, errors_sim
 				, Hide_old_ver
 				, Confidence_factor
 				, csvf
@@ -1181,7 +1945,7 @@ int main (int argc, char *argv[])
 				, outqual
 				, sfe.wa_sdev
 				, sfe.dr_sdev
-				, sfe.relative
+				, &sfe
 				, cfs_column
 				, columns
 				);
@@ -1206,11 +1970,11 @@ int main (int argc, char *argv[])
 				, BETA);
 	#endif
 
-	if (Simulate > 1 && NULL != ematstr) {
-		errorsout(&Players, &RA, sfe.relative, ematstr, Confidence_factor);
+	if (errors_sim > 1 && NULL != ematstr) {
+		errorsout(&Players, &RA, &sfe, ematstr, Confidence_factor);
 	}
-	if (Simulate > 1 && NULL != ctsmatstr) {
-		ctsout (&Players, &RA, sfe.relative, ctsmatstr);
+	if (errors_sim > 1 && NULL != ctsmatstr) {
+		ctsout (&Players, &RA, &sfe, ctsmatstr);
 	}
 
 	if (head2head_str != NULL) {
@@ -1221,10 +1985,10 @@ int main (int argc, char *argv[])
 					, &RA
 					, &Encounters
 					, sfe.sdev
-					, Simulate
+					, errors_sim
 					, Confidence_factor
 					, &Game_stats
-					, sfe.relative
+					, &sfe
 					, head2head_str
 					, OUTDECIMALS
 					);
@@ -1238,10 +2002,10 @@ int main (int argc, char *argv[])
 					, &RA
 					, &Encounters
 					, sfe.sdev
-					, Simulate
+					, errors_sim
 					, Confidence_factor
 					, &Game_stats
-					, sfe.relative
+					, &sfe
 					, outqual
 					, Decimals_set? OUTDECIMALS: 0);
 	}
@@ -1262,6 +2026,7 @@ int main (int argc, char *argv[])
 	ratings_done (&RA);
 	games_done (&Games);
 	encounters_done (&Encounters);
+	encounters_done (&Encounters_full);
 	players_done (&Players);
 	supporting_auxmem_done (&PP, &PP_store);
 
@@ -1271,8 +2036,6 @@ int main (int argc, char *argv[])
 	name_storage_done();
 	report_columns_done();
 
-	mythread_mutex_destroy (&Smpcount);
-	mythread_mutex_destroy (&Groupmtx);
 	mythread_mutex_destroy (&Summamtx);
 	mythread_mutex_destroy (&Printmtx);
 
@@ -72,6 +72,7 @@
 
 //===============================================
 
+#include <stddef.h>
 #include "boolean.h"
 
 enum Player_Performance_Type {
@@ -81,6 +82,12 @@ enum Player_Performance_Type {
 	PERF_NOGAMES = 3
 };
 
+enum Warm_Start_Type {
+	WARM_NONE = 0,		// from the pool average
+	WARM_PREVIOUS = 1,	// ratings of a previous run, --warm-start
+	WARM_RESULTS = 2	// ratings of the original results in a simulation, --sim-warm
+};
+
 typedef int64_t gamesnum_t;
 
 typedef int64_t player_t;
@@ -117,6 +124,13 @@ struct GAMESTATS {
 		noresult;
 };
 
+// work of the active-set mode (--active-set), added up over the calls
+struct ACTIVESTATS {
+	gamesnum_t	steps;	// player updates calculated
+	gamesnum_t	full;	// player updates without the active set
+	player_t	last;	// active players in the last round
+};
+
 struct prior {
 	double value;
 	double sigma;	
@@ -131,21 +145,50 @@ struct relprior {
 };
 
 struct DEVIATION_ACC {
-	double sum1;
-	double sum2;
+	double mean;
+	double m2;	// sum of squared differences from the mean
 	double sdev;
 };
 
+// run by run, a variable correlated with the one accumulated, of known variance
+struct CONTROL_ACC {
+	double mean;
+	double m2;
+	double co;	// sum of products of the differences from the means, with the accumulated one
+	double var;	// exact variance
+};
+
+
+struct PAIR {
+	player_t a;
+	player_t b;
+};
+
+// pairs of players that have an accumulator in summations.relative
+#define PAIRS_NONE  0
+#define PAIRS_TABLE 1	// all the pairs among a set of players
+#define PAIRS_LIST  2	// explicit list of pairs
 
 struct summations {
 	struct DEVIATION_ACC *relative; // to be dynamically assigned
-	double	*sum1; // to be dynamically assigned
-	double	*sum2; // to be dynamically assigned
+	ptrdiff_t		relative_n;
+	int				pairmode;
+	player_t		nplayers;
+	player_t		table_n;	// PAIRS_TABLE, players in the table
+	player_t *		table;		// PAIRS_TABLE, player of each slot
+	player_t *		slot;		// PAIRS_TABLE, slot of each player, -1 if absent
+	struct PAIR *	pair;		// PAIRS_LIST, sorted (a > b), relative[k] is for pair[k]
+	ptrdiff_t		pair_n;
+	double	*mean; // to be dynamically assigned
+	double	*m2;   // to be dynamically assigned
 	double	*sdev; // to be dynamically assigned 
-	double wa_sum1;
-	double wa_sum2;				
-	double dr_sum1;
-	double dr_sum2; 
+	struct CONTROL_ACC *control;		// of the players, NULL if not used
+	struct CONTROL_ACC *control_rel;	// of the pairs, NULL if not used
+	double wa_mean;
+	double wa_m2;				
+	double dr_mean;
+	double dr_m2; 
+	double wadr_n;	// samples of white advantage and draw rate
 	double wa_sdev;				
 	double dr_sdev;
 };
@@ -163,6 +206,8 @@ struct PLAYERS {
 	bool_t		*prefed;
 	bool_t		*priored;
 	int			*performance_type; 
+	player_t	*nameidx;		/* hash index of names, open addressing, -1 == empty */
+	player_t	nameidx_size;	/* power of 2, 0 if index not built */
 };
 
 struct RATINGS {
@@ -0,0 +1,149 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <ctype.h>
+
+#include "pairlist.h"
+#include "csv.h"
+#include "plyrs.h"
+#include "mymem.h"
+
+#define MAX_MYLINE MAXSIZE_CSVLINE
+
+static char *skipblanks(char *p) {while (isspace(*p)) p++; return p;}
+
+//================================================
+
+bool_t
+pairlist_init (struct PAIRLIST *pl)
+{
+	assert(pl);
+	pl->n  = 0;
+	pl->sz = 1024;
+	pl->x  = memnew (sizeof(struct PAIR) * (size_t)pl->sz);
+	return pl->x != NULL;
+}
+
+void
+pairlist_done (struct PAIRLIST *pl)
+{
+	assert(pl);
+	if (pl->x) memrel(pl->x);
+	pl->x  = NULL;
+	pl->n  = 0;
+	pl->sz = 0;
+}
+
+bool_t
+pairlist_add (struct PAIRLIST *pl, player_t a, player_t b)
+{
+	assert(pl && pl->x);
+	if (pl->n == pl->sz) {
+		struct PAIR *q;
+		ptrdiff_t i;
+		if (NULL == (q = memnew (sizeof(struct PAIR) * (size_t)(2 * pl->sz))))
+			return FALSE;
+		for (i = 0; i < pl->n; i++) q[i] = pl->x[i];
+		memrel(pl->x);
+		pl->x  = q;
+		pl->sz = 2 * pl->sz;
+	}
+	pl->x[pl->n].a = a;
+	pl->x[pl->n].b = b;
+	pl->n++;
+	return TRUE;
+}
+
+// pairs of players that met in the encounters
+void
+pairlist_opponents (const struct ENCOUNTERS *e, struct PAIRLIST *pl)
+{
+	gamesnum_t i;
+	for (i = 0; i < e->n; i++) {
+		if (!pairlist_add (pl, e->enc[i].wh, e->enc[i].bl)) {
+			fprintf (stderr, "Not enough memory for the list of pairs\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// file with rows of "PlayerA","PlayerB"
+void
+pairlist_load (bool_t quietmode, const char *f_name, const struct PLAYERS *plyrs, struct PAIRLIST *pl)
+{
+	FILE *fil;
+	char myline[MAX_MYLINE];
+	csv_line_t csvln;
+	player_t a = 0, b = 0;
+	bool_t file_success = TRUE;
+	bool_t names_success = TRUE;
+	ptrdiff_t loaded = 0;
+
+	assert(NULL != f_name);
+
+	if (NULL != (fil = fopen (f_name, "r"))) {
+
+		while (file_success && NULL != fgets(myline, MAX_MYLINE, fil)) {
+
+			if (*skipblanks(myline) == '\0') continue;
+
+			if (!csv_line_init(&csvln, myline)) {
+				fprintf (stderr, "Failure to input the file of pairs\n");	
+				exit(EXIT_FAILURE);
+			}
+
+			if (csvln.n != 2) {
+				file_success = FALSE;
+			} else if (players_name2idx (plyrs, csvln.s[0], &a) && players_name2idx (plyrs, csvln.s[1], &b)) {
+				if (!pairlist_add (pl, a, b)) {
+					fprintf (stderr, "Not enough memory for the list of pairs\n");
+					exit(EXIT_FAILURE);
+				}
+				loaded++;
+			} else {
+				fprintf (stderr, "Pair, %s, %s --> FAILED, name/s not found in input file\n", csvln.s[0], csvln.s[1]);					
+				names_success = FALSE;
+			}
+
+			csv_line_done(&csvln);		
+		}
+
+		fclose(fil);
+	} else {
+		file_success = FALSE;
+	}
+
+	if (!file_success) {
+		fprintf (stderr, "Errors in file \"%s\"\n",f_name);
+		exit(EXIT_FAILURE);
+	}
+	if (!names_success) {
+		fprintf (stderr, "Errors in file \"%s\" (not matching names)\n",f_name);
+		exit(EXIT_FAILURE);
+	}
+	if (!quietmode) 
+		printf ("Pairs loaded from \"%s\" = %ld\n", f_name, (long)loaded);
+
+	return;
+}
@@ -0,0 +1,48 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(H_PAIRLIST)
+#define H_PAIRLIST
+/*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
+
+#include <stddef.h>
+#include "boolean.h"
+#include "mytypes.h"
+
+// growing list of pairs of players, for the errors of the simulations
+
+struct PAIRLIST {
+	struct PAIR *	x;
+	ptrdiff_t		n;
+	ptrdiff_t		sz;
+};
+
+extern bool_t	pairlist_init 		(struct PAIRLIST *pl);
+extern void		pairlist_done 		(struct PAIRLIST *pl);
+extern bool_t	pairlist_add 		(struct PAIRLIST *pl, player_t a, player_t b);
+extern void		pairlist_opponents 	(const struct ENCOUNTERS *e, struct PAIRLIST *pl);
+extern void		pairlist_load 		( bool_t quietmode
+									, const char *f_name
+									, const struct PLAYERS *plyrs
+									, struct PAIRLIST *pl /*@out@*/);
+
+/*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
+#endif
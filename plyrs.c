@@ -26,10 +26,11 @@
 #include "mymem.h"
 #include "mytypes.h"
 #include "plyrs.h"
+#include "namehash.h"
 
 
-bool_t
-players_name2idx (const struct PLAYERS *plyrs, const char *player_name, player_t *pi)
+static bool_t
+players_name2idx_linear (const struct PLAYERS *plyrs, const char *player_name, player_t *pi)
 {
 	player_t j;
 	bool_t found;
@@ -42,6 +43,66 @@ players_name2idx (const struct PLAYERS *plyrs, const char *player_name, player_t
 	return found;
 }
 
+bool_t
+players_name2idx (const struct PLAYERS *plyrs, const char *player_name, player_t *pi)
+{
+	player_t	*idx  = plyrs->nameidx;
+	uint32_t	mask;
+	uint32_t	h;
+	player_t	j;
+
+	if (idx == NULL)
+		return players_name2idx_linear (plyrs, player_name, pi);
+
+	mask = (uint32_t)plyrs->nameidx_size - 1;
+	for (h = namehash(player_name) & mask; -1 != (j = idx[h]); h = (h + 1) & mask) {
+		if (!strcmp(plyrs->name[j], player_name)) {
+			*pi = j;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Index of names to speed up players_name2idx(). Names do not change
+// after database_transform(), so it is built once and kept until players_done()
+
+bool_t
+players_name_index_build (struct PLAYERS *plyrs)
+{
+	player_t	*idx;
+	player_t	sz;
+	player_t	j;
+	uint32_t	mask;
+	uint32_t	h;
+
+	if (plyrs->nameidx) {
+		memrel(plyrs->nameidx);
+		plyrs->nameidx = NULL;
+		plyrs->nameidx_size = 0;
+	}
+
+	for (sz = 16; sz < 2 * plyrs->n; sz *= 2) {}  // load factor <= 0.5
+
+	if (NULL == (idx = memnew (sizeof(player_t) * (size_t)sz)))
+		return FALSE;
+
+	for (j = 0; j < sz; j++) idx[j] = -1;
+
+	mask = (uint32_t)sz - 1;
+	for (j = 0; j < plyrs->n; j++) {
+		for (h = namehash(plyrs->name[j]) & mask; -1 != idx[h]; h = (h + 1) & mask) {
+			// first registered wins, like the linear scan
+			if (!strcmp(plyrs->name[idx[h]], plyrs->name[j])) break;
+		}
+		if (-1 == idx[h]) idx[h] = j;
+	}
+
+	plyrs->nameidx = idx;
+	plyrs->nameidx_size = sz;
+	return TRUE;
+}
+
 //
 
 void
@@ -202,6 +263,69 @@ players_set_super (bool_t quiet, const struct ENCOUNTERS *ee, struct PLAYERS *pl
 	return super;
 }
 
+/*
+|	Same as players_set_super(), but counting the wins, draws and losses of
+|	each encounter, and in the work memory of the caller, so it can be
+|	called for every simulated run. work[] has 3 counters per player that
+|	must be zero, and they are left zero on return.
+*/
+player_t
+players_set_super_wdl (bool_t quiet, const struct ENCOUNTERS *ee, struct PLAYERS *pl, gamesnum_t *work)
+{
+	gamesnum_t N_enc = ee->n;
+	const struct ENC *enc = ee->enc;
+	player_t n_players = pl->n;
+	int *perftype  = pl->performance_type;
+	const bool_t *ispriored = pl->priored; 
+	gamesnum_t *pla = work;						// games played
+	gamesnum_t *notlost = work + n_players;		// games won or drawn
+	gamesnum_t *notwon = work + 2 * n_players;	// games drawn or lost
+	gamesnum_t e;
+	player_t j, w, b;
+	player_t super = 0;
+	player_t counter_nogames = 0, counter_all_W = 0, counter_all_L = 0;
+
+	for (e = 0; e < N_enc; e++) {
+		w = enc[e].wh;
+		b = enc[e].bl;
+		pla[w] += enc[e].played;
+		pla[b] += enc[e].played;
+		notlost[w] += enc[e].W + enc[e].D;
+		notlost[b] += enc[e].L + enc[e].D;
+		notwon[w] += enc[e].L + enc[e].D;
+		notwon[b] += enc[e].W + enc[e].D;
+	}
+
+	for (j = 0; j < n_players; j++) {
+		perftype[j] = PERF_NORMAL;
+		if (pla[j] == 0) {
+			perftype[j] = PERF_NOGAMES;			
+			counter_nogames++;
+		} else {
+			if (notlost[j] == 0) {
+				perftype[j] = ispriored[j]? PERF_NORMAL: PERF_SUPERLOSER;			
+				counter_all_L++;
+			}	
+			if (notwon[j] == 0) {
+				perftype[j] = ispriored[j]? PERF_NORMAL: PERF_SUPERWINNER;
+				counter_all_W++;
+			}
+		}
+		if (perftype[j] != PERF_NORMAL || pl->flagged[j]) super++;
+		pla[j] = notlost[j] = notwon[j] = 0;
+	}
+	pl->perf_set = TRUE;
+
+	if (!quiet) {
+		printf ("\n");
+		printf ("players with no games = %ld\n", counter_nogames);
+		printf ("players with all wins = %ld\n", counter_all_W);
+		printf ("players w/ all losses = %ld\n", counter_all_L);
+	}
+
+	return super;
+}
+
 
 void	
 players_copy (const struct PLAYERS *source, struct PLAYERS *target)
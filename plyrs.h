@@ -26,10 +26,12 @@
 #include "mytypes.h"
 
 extern bool_t 	players_name2idx (const struct PLAYERS *plyrs, const char *player_name, player_t *pi);
+extern bool_t	players_name_index_build (struct PLAYERS *plyrs);
 extern void		players_purge (bool_t quiet, struct PLAYERS *pl);
 extern void		players_set_priored_info (const struct prior *pr, const struct rel_prior_set *rps, struct PLAYERS *pl /*@out@*/);
 extern void		players_flags_reset (struct PLAYERS *pl);
 extern player_t	players_set_super (bool_t quiet, const struct ENCOUNTERS *ee, struct PLAYERS *pl);
+extern player_t	players_set_super_wdl (bool_t quiet, const struct ENCOUNTERS *ee, struct PLAYERS *pl, gamesnum_t *work);
 extern void 	players_copy (const struct PLAYERS *source, struct PLAYERS *target);
 
 #if !defined(NDEBUG)
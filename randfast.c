@@ -19,99 +19,243 @@
 */
 
 
+#include <math.h>
+
 #include "randfast.h"
 #include "datatype.h"
 
 /*
 |
-|	Random number generator taken from
-|	http://www.burtleburtle.net/bob/rand/talksmall.html
+|	Counter based random numbers (Philox 2x32-10, Salmon et al. 2011).
+|	Each stream is keyed by the global seed and its own index, so a 
+|	simulated run gets the same numbers whichever thread calculates it.
 |
 */
 
-typedef struct ranctx { 
-	uint32_t a; 
-	uint32_t b; 
-	uint32_t c; 
-	uint32_t d; 
-} ranctx;
-
-static ranctx Rndseries;
+#define PHILOX_M	0xD256D34BU
+#define PHILOX_W	0x9E3779B9U
 
-#define rot(x,k) (((x)<<(k))|((x)>>(32-(k))))
+static uint32_t Rndseed = 1324561;
 
-static uint32_t 
-ranval( ranctx *x ) 
+static void
+philox2x32 (uint32_t c0, uint32_t c1, uint32_t key, uint32_t *o0, uint32_t *o1)
 {
-    uint32_t e = x->a - rot(x->b, 27);
-    x->a = x->b ^ rot(x->c, 17);
-    x->b = x->c + x->d;
-    x->c = x->d + e;
-    x->d = e + x->a;
-    return x->d;
+	uint64_t prod;
+	int i;
+	for (i = 0; i < 10; i++) {
+		prod = (uint64_t)PHILOX_M * c0;
+		c0 = (uint32_t)(prod >> 32) ^ key ^ c1;
+		c1 = (uint32_t)prod;
+		key += PHILOX_W;
+	}
+	*o0 = c0;
+	*o1 = c1;
 }
 
-static void raninit ( ranctx *x, uint32_t seed ) 
+void randfast_init (uint32_t seed)
 {
-    uint32_t i;
-    x->a = 0xf1ea5eed, x->b = x->c = x->d = seed;
-    for (i = 0; i < 20; ++i) {
-        (void)ranval(x);
-    }
+	Rndseed = seed; 
 }
 
-void randfast_init (uint32_t seed)
+void randstream_init (randstream_t *r, uint32_t stream)
 {
-	raninit (&Rndseries, seed); 
+	r->stream 	= stream;
+	r->counter 	= 0;
+	r->buffer 	= 0;
+	r->buffered	= FALSE;
+	r->gauss	= 0;
+	r->gauss_buffered = FALSE;
 }
 
-uint32_t randfast32 (void)
+uint32_t randstream32 (randstream_t *r)
 {
-	return ranval (&Rndseries); 
+	uint32_t x;
+	if (r->buffered) {
+		r->buffered = FALSE;
+		return r->buffer;
+	}
+	philox2x32 (r->counter++, r->stream, Rndseed, &x, &r->buffer);
+	r->buffered = TRUE;
+	return x;
 }
 
 
 //==========================================
-#include "gauss.h"
 
+/*
+|	Normal deviates by the polar method (Marsaglia 1964) from uniforms of
+|	53 bits. They come in pairs, the second one is kept in the stream for
+|	the next call, so the numbers still depend only on the stream.
+*/
+
+// uniform in [0,1)
 static double
-rand_area (void)
+rand_uniform53 (randstream_t *rs)
 {
-	uint32_t r;
-	double rr;
-	do {
-		r = randfast32();
-	} while (r == 0);
-	r &= 8191;
-	rr = (double) r;
-	rr = rr/8192;
-	return rr;
+	uint32_t a = randstream32(rs) >> 5;	// 27 bits
+	uint32_t b = randstream32(rs) >> 6;	// 26 bits
+	return ((double)a * 67108864.0 + (double)b) * (1.0 / 9007199254740992.0);
 }
 
-
 static double
-rand_gauss_normalized(void)
+rand_gauss_normalized(randstream_t *rs)
 {
-	double xi, yi, area, slope;
-	double limit = 0.00001;
-	int n;
+	double u, v, s, f;
 
-	area = rand_area();
-	n = 0;
-	xi = 0;
+	if (rs->gauss_buffered) {
+		rs->gauss_buffered = FALSE;
+		return rs->gauss;
+	}
 	do {
-		yi = gauss_integral (xi) - area;
-		slope = gauss_density (xi);
-		xi = xi - yi / slope;
-		n++;
-	} while (n < 100 && (yi > limit || yi < -limit));
+		u = 2 * rand_uniform53(rs) - 1;
+		v = 2 * rand_uniform53(rs) - 1;
+		s = u * u + v * v;
+	} while (s >= 1 || s == 0);
 
-	return xi;
+	f = sqrt (-2 * log (s) / s);
+	rs->gauss = v * f;
+	rs->gauss_buffered = TRUE;
+	return u * f;
 }
 
 double
-rand_gauss(double x, double s)
+rand_gauss(randstream_t *rs, double x, double s)
 {
-	double z = rand_gauss_normalized();
+	double z = rand_gauss_normalized(rs);
 	return x + z * s;
 }
+
+//==========================================
+
+/*
+|	Binomial deviates. With few successes expected (n p < 30) by inversion,
+|	adding up the probabilities from 0. Otherwise by BTPE (Kachitvichyanukul
+|	& Schmeiser 1988), which takes about the same time for any n. Both work
+|	with p <= 1/2 and the result is mirrored for bigger p.
+*/
+
+#define BINOMIAL_INVERSION_MAX 30.0
+
+static gamesnum_t
+binomial_inversion (randstream_t *rs, gamesnum_t n, double p)
+{
+	double q = 1 - p, qn = exp ((double)n * log (q)), np = (double)n * p;
+	double bound = fmin ((double)n, np + 10 * sqrt (np * q + 1));
+	double px = qn, u = rand_uniform53(rs);
+	gamesnum_t x = 0;
+
+	while (u > px) {
+		x++;
+		if ((double)x > bound) {
+			x = 0;
+			px = qn;
+			u = rand_uniform53(rs);
+		} else {
+			u -= px;
+			px = ((double)(n - x + 1) * p * px) / ((double)x * q);
+		}
+	}
+	return x;
+}
+
+// Stirling's series of the correction of the log factorial, for the final test of BTPE
+static double
+stirling_tail (double x)
+{
+	double x2 = x * x;
+	return (13860. - (462. - (132. - (99. - 140. / x2) / x2) / x2) / x2) / x / 166320.;
+}
+
+static gamesnum_t
+binomial_btpe (randstream_t *rs, gamesnum_t n, double p)
+{
+	double dn = (double)n, q = 1 - p, nrq = dn * p * q;
+	double fm = dn * p + p, m = floor (fm);
+	double p1 = floor (2.195 * sqrt (nrq) - 4.6 * q) + 0.5;
+	double xm = m + 0.5, xl = xm - p1, xr = xm + p1;
+	double c = 0.134 + 20.5 / (15.3 + m);
+	double a, laml, lamr, p2, p3, p4;
+	double u, v, x, y, k, f, s, i, rho, t, lv, x1, f1, z, w;
+
+	a = (fm - xl) / (fm - xl * p);
+	laml = a * (1 + a / 2);
+	a = (xr - fm) / (xr * q);
+	lamr = a * (1 + a / 2);
+	p2 = p1 * (1 + 2 * c);
+	p3 = p2 + c / laml;
+	p4 = p3 + c / lamr;
+
+	for (;;) {
+		u = rand_uniform53(rs) * p4;
+		v = rand_uniform53(rs);
+		if (u <= p1) {
+			// triangle in the middle, accepted right away
+			return (gamesnum_t)floor (xm - p1 * v + u);
+		}
+		if (u <= p2) {
+			// parallelograms
+			x = xl + (u - p1) / c;
+			v = v * c + 1 - fabs (m - x + 0.5) / p1;
+			if (v > 1) continue;
+			y = floor (x);
+		} else if (u <= p3) {
+			// left tail
+			if (v == 0) continue;
+			y = floor (xl + log (v) / laml);
+			if (y < 0) continue;
+			v = v * (u - p2) * laml;
+		} else {
+			// right tail
+			if (v == 0) continue;
+			y = floor (xr - log (v) / lamr);
+			if (y > dn) continue;
+			v = v * (u - p3) * lamr;
+		}
+
+		k = fabs (y - m);
+		if (k <= 20 || k >= nrq / 2 - 1) {
+			// f(y) / f(m) by recursion
+			s = p / q;
+			a = s * (dn + 1);
+			f = 1;
+			if (m < y) {
+				for (i = m + 1; i <= y; i++) f *= a / i - s;
+			} else if (m > y) {
+				for (i = y + 1; i <= m; i++) f /= a / i - s;
+			}
+			if (v <= f) return (gamesnum_t)y;
+			continue;
+		}
+
+		// squeeze, then the log of f(y) / f(m) from Stirling's formula
+		rho = (k / nrq) * ((k * (k / 3 + 0.625) + 0.1666666666666) / nrq + 0.5);
+		t = -k * k / (2 * nrq);
+		lv = log (v);
+		if (lv < t - rho) return (gamesnum_t)y;
+		if (lv > t + rho) continue;
+
+		x1 = y + 1;
+		f1 = m + 1;
+		z = dn + 1 - m;
+		w = dn - y + 1;
+		if (lv <= xm * log (f1 / x1) + (dn - m + 0.5) * log (z / w) + (y - m) * log (w * p / (x1 * q))
+				+ stirling_tail (f1) + stirling_tail (z) + stirling_tail (x1) + stirling_tail (w))
+			return (gamesnum_t)y;
+	}
+}
+
+gamesnum_t
+rand_binomial (randstream_t *rs, gamesnum_t n, double p)
+{
+	gamesnum_t x;
+	double r = p > 0.5? 1 - p: p;
+
+	if (n <= 0 || r <= 0)
+		x = 0;
+	else if ((double)n * r < BINOMIAL_INVERSION_MAX)
+		x = binomial_inversion (rs, n, r);
+	else
+		x = binomial_btpe (rs, n, r);
+
+	return p > 0.5? n - x: x;
+}
@@ -23,13 +23,27 @@
 #define H_RANDF
 /*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
 
+#include "boolean.h"
 #include "datatype.h"
 #include "mytypes.h"
 
+struct RANDSTREAM {
+	uint32_t	stream;
+	uint32_t	counter;
+	uint32_t	buffer;
+	bool_t		buffered;
+	double		gauss;		// second normal deviate of a pair
+	bool_t		gauss_buffered;
+};
+
+typedef struct RANDSTREAM randstream_t;
+
 extern void 		randfast_init (uint32_t seed);
-extern uint32_t 	randfast32 (void);
+extern void 		randstream_init (randstream_t *r, uint32_t stream);
+extern uint32_t 	randstream32 (randstream_t *r);
 
-extern double		rand_gauss(double x, double s);
+extern double		rand_gauss(randstream_t *r, double x, double s);
+extern gamesnum_t	rand_binomial (randstream_t *r, gamesnum_t n, double p);
 
 /*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
 #endif
@@ -34,12 +34,15 @@
 #include "mytimer.h"
 
 #define START_DELTA           100
+#define SIM_WARM_DELTA        50    // simulated run started from the original results
 #define MIN_DEVIA             0.0000001
 #define MIN_RESOL             0.000001
 #define START_RESOL        10.0
 #define ACCEPTABLE_RESOL      MIN_RESOL
 #define PRECISIONERROR        (1E-16)
 #define DRAWRATE_RESOLUTION   0.0000001
+#define ACTIVE_FRACTION       0.01  // relative to the biggest step, smaller ones count as quiet
+#define ACTIVE_ROUNDS         2     // quiet rounds before a player is frozen
 
 #if !defined(NDEBUG)
 static bool_t is_nan (double x) {if (x != x) return TRUE; else return FALSE;}
@@ -47,6 +50,8 @@ static bool_t is_nan (double x) {if (x != x) return TRUE; else return FALSE;}
 
 static double adjust_drawrate (double start_wadv, const double *ratingof, gamesnum_t n_enc, const struct ENC *enc, double beta);
 
+static double absol(double x) {return x >= 0? x: -x;}
+
 static void
 ratings_copyto (player_t n_players, const double *r_fr, double *r_to)
 {
@@ -74,6 +79,235 @@ deviation (player_t n_players, const bool_t *flagged, const double *expected, co
 	return accum;
 }
 
+//========================= LAZY EXPECTED SCORES ================================
+
+/*
+|	Expected scores are updated only from the encounters of the players
+|	whose rating changed since the last time they were calculated.
+|	A change is any change, so the results are the same as recalculating
+|	everything. A tolerance was tried: on a 20000 player pool it made the
+|	deviation approximate, more steps failed, and it was slower.
+|	In the default mode every player moves a little in every round, so a
+|	step needs the full calculation. The cache saves the calls where
+|	nothing moved (after a step, when the center does not need to move),
+|	about half of them, and restores a failed step exactly. Players stop
+|	moving when --active-set freezes them (see adjust_rating), and then
+|	only their encounters are recalculated. Beyond a quarter of the
+|	players, the full calculation in encounter order is faster.
+*/
+
+struct XCACHE {
+	gamesnum_t *	first;		// per player, index of the first encounter in "list"
+	gamesnum_t *	list;		// encounters of each player, contiguous
+	double *		wperf;		// white expected score of each encounter
+	double *		rcache;		// rating used for the cached values
+	player_t *		changed;
+	bool_t *		ischanged;
+	player_t *		touched;	// changed players and their opponents
+	bool_t *		istouched;
+	double			wadv;
+	bool_t			valid;
+};
+
+static bool_t
+xcache_init (struct XCACHE *x, const struct ENC *enc, gamesnum_t n_enc, player_t n_players)
+{
+	gamesnum_t e;
+	player_t j;
+
+	x->first	 = memnew (sizeof(gamesnum_t) * (size_t)(n_players+1));
+	x->list		 = memnew (sizeof(gamesnum_t) * (size_t)(2*n_enc+1));
+	x->wperf	 = memnew (sizeof(double)     * (size_t)(n_enc+1));
+	x->rcache	 = memnew (sizeof(double)     * (size_t)n_players);
+	x->changed	 = memnew (sizeof(player_t)   * (size_t)n_players);
+	x->ischanged = memnew (sizeof(bool_t)     * (size_t)n_players);
+	x->touched	 = memnew (sizeof(player_t)   * (size_t)n_players);
+	x->istouched = memnew (sizeof(bool_t)     * (size_t)n_players);
+	x->wadv		 = 0;
+	x->valid	 = FALSE;
+
+	if (!x->first || !x->list || !x->wperf || !x->rcache || !x->changed || !x->ischanged || !x->touched || !x->istouched) {
+		if (x->first) 		memrel(x->first);
+		if (x->list) 		memrel(x->list);
+		if (x->wperf) 		memrel(x->wperf);
+		if (x->rcache) 		memrel(x->rcache);
+		if (x->changed) 	memrel(x->changed);
+		if (x->ischanged) 	memrel(x->ischanged);
+		if (x->touched) 	memrel(x->touched);
+		if (x->istouched) 	memrel(x->istouched);
+		return FALSE;
+	}
+
+	// count, accumulate and fill (encounters indexed by player)
+	for (j = 0; j <= n_players; j++) x->first[j] = 0;
+	for (e = 0; e < n_enc; e++) {
+		x->first[enc[e].wh+1]++;
+		x->first[enc[e].bl+1]++;
+	}
+	for (j = 0; j < n_players; j++) {
+		x->first[j+1] += x->first[j];
+		x->ischanged[j] = FALSE;
+		x->istouched[j] = FALSE;
+	}
+	for (e = 0; e < n_enc; e++) {
+		x->list[x->first[enc[e].wh]++] = e;
+		x->list[x->first[enc[e].bl]++] = e;
+	}
+	for (j = n_players; j > 0; j--) {
+		x->first[j] = x->first[j-1];
+	}
+	x->first[0] = 0;
+
+	return TRUE;
+}
+
+static void
+xcache_done (struct XCACHE *x)
+{
+	memrel(x->first);
+	memrel(x->list);
+	memrel(x->wperf);
+	memrel(x->rcache);
+	memrel(x->changed);
+	memrel(x->ischanged);
+	memrel(x->touched);
+	memrel(x->istouched);
+}
+
+// no globals
+static void
+xcache_expected	( struct XCACHE *x
+				, const struct ENC *enc
+				, gamesnum_t n_enc
+				, double white_adv
+				, player_t n_players
+				, const double *ratingof
+				, double *expected /*@out@*/
+				, double beta)
+{
+	player_t	j, k, n_changed, n_touched;
+	player_t	w, b, other;
+	gamesnum_t	e, i;
+	double		wperf;
+
+	n_changed = 0;
+	if (x->valid && x->wadv == white_adv) {
+		for (j = 0; j < n_players; j++) {
+			if (ratingof[j] != x->rcache[j]) {
+				x->changed[n_changed++] = j;
+				x->ischanged[j] = TRUE;
+			}
+		}
+	}
+
+	if (!x->valid || x->wadv != white_adv || n_changed > n_players/4) {
+
+		// full calculation
+		for (k = 0; k < n_changed; k++) x->ischanged[x->changed[k]] = FALSE;
+		for (j = 0; j < n_players; j++) {
+			expected[j] = 0.0;
+			x->rcache[j] = ratingof[j];
+		}
+		for (e = 0; e < n_enc; e++) {
+			wperf = (double)enc[e].played * xpect (ratingof[enc[e].wh] + white_adv, ratingof[enc[e].bl], beta);
+			x->wperf[e] = wperf;
+			expected [enc[e].bl] += (double)enc[e].played - wperf; 
+			expected [enc[e].wh] += wperf; 
+		}
+		x->wadv = white_adv;
+		x->valid = TRUE;
+		return;
+	}
+
+	// incremental, an encounter between two changed players is done once, by the one with lower index
+	n_touched = 0;
+	for (k = 0; k < n_changed; k++) {
+		j = x->changed[k];
+		if (!x->istouched[j]) {
+			x->istouched[j] = TRUE;
+			x->touched[n_touched++] = j;
+		}
+		for (i = x->first[j]; i < x->first[j+1]; i++) {
+			e = x->list[i];
+			w = enc[e].wh;
+			b = enc[e].bl;
+			other = w == j? b: w;
+			if (!x->istouched[other]) {
+				x->istouched[other] = TRUE;
+				x->touched[n_touched++] = other;
+			}
+			if (x->ischanged[other] && other < j) continue;
+			x->wperf[e] = (double)enc[e].played * xpect (ratingof[w] + white_adv, ratingof[b], beta);
+		}
+	}
+	for (k = 0; k < n_changed; k++) {
+		j = x->changed[k];
+		x->rcache[j] = ratingof[j];
+		x->ischanged[j] = FALSE;
+	}
+
+	// sums in the same order as the full calculation, so the results are the same to the last bit
+	for (k = 0; k < n_touched; k++) {
+		j = x->touched[k];
+		expected[j] = 0.0;
+		for (i = x->first[j]; i < x->first[j+1]; i++) {
+			e = x->list[i];
+			if (enc[e].wh == j)
+				expected[j] += x->wperf[e];
+			else
+				expected[j] += (double)enc[e].played - x->wperf[e];
+		}
+		x->istouched[j] = FALSE;
+	}
+}
+
+// no globals
+// ratingof[] was restored to values cached before, bring back the expected score of their encounters
+static void
+xcache_revert	( struct XCACHE *x
+				, const struct ENC *enc
+				, player_t n_players
+				, const double *ratingof
+				, double beta)
+{
+	player_t	j;
+	gamesnum_t	e, i;
+
+	assert(x->valid);
+	for (j = 0; j < n_players; j++) {
+		if (ratingof[j] == x->rcache[j]) continue;
+		for (i = x->first[j]; i < x->first[j+1]; i++) {
+			e = x->list[i];
+			x->wperf[e] = (double)enc[e].played * xpect (ratingof[enc[e].wh] + x->wadv, ratingof[enc[e].bl], beta);
+		}
+		x->rcache[j] = ratingof[j];
+	}
+}
+
+// no globals
+static double 
+unfitness_lazy	( struct XCACHE *	x
+				, const struct ENC *enc
+				, gamesnum_t		n_enc
+				, player_t			n_players
+				, const double *	ratingof
+				, const bool_t *	flagged
+				, double			white_adv
+				, double			beta
+				, const double *	obtained
+				, const gamesnum_t *playedby
+				, double *			expected /*@out@*/
+)
+{
+		double dev;
+		xcache_expected (x, enc, n_enc, white_adv, n_players, ratingof, expected, beta);
+		dev = deviation (n_players, flagged, expected, obtained, playedby);
+		assert(!is_nan(dev));
+		return dev;
+}
+
+//===============================================================================
+
 // no globals
 static double 
 unfitness		( const struct ENC *enc
@@ -141,13 +375,17 @@ adjust_rating 	( double delta
 				, const double *expected 
 				, const double *obtained 
 				, const gamesnum_t *playedby
+				, int *quietfor /*@out@*/	// NULL when the active set is not used
+				, player_t *pactive /*@out@*/
 				, double *ratingof /*@out@*/
 )
 {
 	player_t 	j;
+	player_t	active = 0;
 	double 	d;
 	double 	y = 1.0;
 	double 	ymax = 0;
+	double	ymin = 0;
 
 	assert (kappa > 0);
 	/*
@@ -159,8 +397,24 @@ adjust_rating 	( double delta
 	|	is controled so y won't be higher than 1.0. It will be asymptotic
 	|	to 1.0, and the parameter that controls how fast this saturation is 
 	|	reached is "kappa". Smaller kappas will allow to reach 1.0 faster.	
+	|	Active set (optional): a player whose step stays much smaller than
+	|	the biggest one for ACTIVE_ROUNDS rounds is frozen, so the expected
+	|	scores need fewer updates (see XCACHE). It rejoins when the moves of
+	|	its opponents make its step relevant again.
 	*/
 
+	if (quietfor != NULL) {
+		for (j = 0; j < n_players; j++) {
+			if (flagged[j] || (anchored_n > 1 && prefed[j]))
+				continue;
+			d = (expected[j] - obtained[j]) / (double)playedby[j];
+			d = d < 0? -d: d;
+			y = d / (kappa + d);
+			if (y > ymax) ymax = y;
+		}
+		ymin = ymax * ACTIVE_FRACTION;
+	}
+
 	for (j = 0; j < n_players; j++) {
 		assert(flagged[j] == TRUE || flagged[j] == FALSE);
 		assert(prefed [j] == TRUE || prefed [j] == FALSE);
@@ -176,10 +430,20 @@ adjust_rating 	( double delta
 		// find multiplier "y"
 		d = (expected[j] - obtained[j]) / (double)playedby[j];
 		d = d < 0? -d: d;
-
 		y = d / (kappa + d);
 		if (y > ymax) ymax = y;
 
+		if (quietfor != NULL) {
+			if (y < ymin) {
+				if (quietfor[j] >= ACTIVE_ROUNDS)
+					continue; // frozen
+				quietfor[j]++;
+			} else {
+				quietfor[j] = 0;
+			}
+		}
+		active++;
+
 		// execute adjustment
 		if (expected[j] > obtained [j]) {
 			ratingof[j] -= delta * y;
@@ -189,6 +453,8 @@ adjust_rating 	( double delta
 		assert(!is_nan(ratingof[j]));
 	}
 
+	*pactive = active;
+
 	// Return maximum increase/decrease ==> "resolution"
 	return ymax * delta;
 }
@@ -406,6 +672,83 @@ adjust_drawrate (double start_wadv, const double *ratingof, gamesnum_t n_enc, co
 	return dr;
 }
 
+//=================== WHITE ADVANTAGE AND DRAW RATE, JOINTLY =============
+
+#define WADV_DRAWRATE_MAXITER 50
+
+// Expected minus obtained, for the white points (fun[0]) and the draws (fun[1]),
+// with the jacobian in one pass. The white points do not depend on the draw rate,
+// so jac[0] = d fun[0]/d wadv, jac[1] = d fun[1]/d wadv and jac[2] = d fun[1]/d dr0
+static void
+wadv_drawrate_conditions (gamesnum_t n_enc, const struct ENC *enc, const double *ratingof, double beta, double wadv, double dr0
+						, double *fun /*@out@*/, double *jac /*@out@*/)
+{
+	gamesnum_t e;
+	player_t w, b;
+	double f, df, t;
+	double dexp, ddexp_df, ddexp_dr0;
+
+	fun[0] = fun[1] = 0;
+	jac[0] = jac[1] = jac[2] = 0;
+
+	for (e = 0; e < n_enc; e++) {
+		w = enc[e].wh;
+		b = enc[e].bl;
+		t = (double)(enc[e].W + enc[e].D + enc[e].L);
+
+		f  = xpect (ratingof[w] + wadv, ratingof[b], beta);
+		df = beta * f * (1 - f);
+		draw_rate_fperf_deriv (f, dr0, &dexp, &ddexp_df, &ddexp_dr0);
+
+		fun[0] += t * f - ((double)enc[e].W + (double)enc[e].D/2);
+		fun[1] += t * dexp - (double)enc[e].D;
+		jac[0] += t * df;
+		jac[1] += t * ddexp_df * df;
+		jac[2] += t * ddexp_dr0;
+	}
+}
+
+// Newton steps on both conditions at once, instead of adjust_wadv() followed by
+// adjust_drawrate(). Returns FALSE if it does not converge, then the caller should use them.
+static bool_t
+adjust_wadv_drawrate (double *pwadv, double *pdr, const double *ratingof, gamesnum_t n_enc, const struct ENC *enc, double beta)
+{
+	double fun[2], jac[3];
+	double wa, dr, dwa, ddr;
+	int i, halved;
+
+	wa = *pwadv;
+	dr = *pdr > 0 && *pdr < 1? *pdr: 0.5;
+
+	for (i = 0; i < WADV_DRAWRATE_MAXITER; i++) {
+
+		wadv_drawrate_conditions (n_enc, enc, ratingof, beta, wa, dr, fun, jac);
+		if (!(jac[0] > 0 && jac[2] > 0))
+			return FALSE;
+
+		dwa = -fun[0] / jac[0];
+		ddr = -(fun[1] + jac[1] * dwa) / jac[2];
+
+		// stay inside the limits, no draws at all pushes it towards zero
+		for (halved = 0; halved < 64 && (dr + ddr <= 0 || dr + ddr >= 1); halved++)
+			ddr /= 2;
+
+		wa += dwa;
+		dr += ddr;
+
+		if (!(-1000 < wa && wa < 1000) || !(0 < dr && dr < 1))
+			return FALSE;
+
+		if (absol(dwa) < MIN_RESOL && absol(ddr) < DRAWRATE_RESOLUTION) {
+			*pwadv = wa;
+			*pdr = dr;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 //============ CENTER ADJUSTMENT FUNCTIONS ==================================
 
 
@@ -457,8 +800,6 @@ unfitness_fcenter 	( double excess
 	return u;
 }
 
-static double absol(double x) {return x >= 0? x: -x;}
-
 struct UNFITPAR {
 	const struct ENC *	enc;
 	gamesnum_t			n_enc;
@@ -559,6 +900,9 @@ calc_rating_ordo
 				, bool_t 			adjust_white_advantage
 				, bool_t			adjust_draw_rate
 				, bool_t			anchor_use
+				, int				warm_start	// enum Warm_Start_Type
+				, int				cpus		// threads for the players with all wins or all losses
+				, struct ACTIVESTATS *active_set	// NULL when the active set is not used
 
 				, double			*ratingtmp_buffer
 
@@ -568,14 +912,15 @@ calc_rating_ordo
 
 				, struct ENCOUNTERS *encount
 				, struct PLAYERS 	*plyrs
-				, struct GAMES 		*g
+				, const struct ENCOUNTERS *full
+				, gamesnum_t		n_games
 				, struct RATINGS 	*rat
 
 				, double			*pWhite_advantage
 				, double			*pDraw_date
+				, bool_t			*pConverged
 )
 {
-	gamesnum_t	n_games = g->n;
 	double 	*	ratingtmp = ratingtmp_buffer;
 	double 		olddev, curdev;
 	int 		i;
@@ -597,6 +942,13 @@ calc_rating_ordo
 	double 		min_devia = MIN_DEVIA;
 	double 		draw_rate = *pDraw_date;
 	double *	expected = NULL;
+	double *	expectbk = NULL;
+	bool_t		bkvalid;
+	int *		quietfor = NULL;
+	player_t	active = 0;
+	player_t	movable = 0;
+	bool_t		converged = FALSE;
+	struct XCACHE xc;
 
 	// translation variables for refactoring ------------------
 	struct ENC *	enc   			= encount->enc;
@@ -620,6 +972,18 @@ calc_rating_ordo
 		fprintf(stderr, "Not enough memory to allocate all players\n");
 		exit(EXIT_FAILURE);
 	}
+	if (NULL == (expectbk = memnew(sizeof(double) * (size_t)(n_players+1)))) {
+		fprintf(stderr, "Not enough memory to allocate all players\n");
+		exit(EXIT_FAILURE);
+	}
+	if (active_set != NULL && NULL == (quietfor = memnew(sizeof(int) * (size_t)(n_players+1)))) {
+		fprintf(stderr, "Not enough memory to allocate all players\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!xcache_init (&xc, enc, n_enc, n_players)) {
+		fprintf(stderr, "Not enough memory to allocate all encounters\n");
+		exit(EXIT_FAILURE);
+	}
 
 	max_cycle = adjust_white_advantage? 4: 1;
 
@@ -628,23 +992,35 @@ calc_rating_ordo
 		 cycle++) {
 
 		bool_t done = FALSE;
+		player_t j;
 
 		KK_DAMP = 1000;
 		rounds = 10000;
-		delta = START_DELTA;
+		delta = warm_start == WARM_RESULTS? SIM_WARM_DELTA: START_DELTA;
 		kappa = 0.05;
 		damp_delta = 1.1;
 		damp_kappa = 1.0;
 		phase = 0;
 		n = 1000;
 
+		if (quietfor) {
+			for (j = 0; j < n_players; j++) quietfor[j] = 0; // everybody active
+		}
+		for (movable = 0, j = 0; j < n_players; j++) {
+			if (!flagged[j] && !(anchored_n > 1 && prefed[j])) movable++;
+		}
+
 		calc_obtained_playedby(enc, n_enc, n_players, obtained, playedby);
 		assert(playedby_sanity (n_players, playedby, flagged));
 
-		olddev = curdev = unfitness	( enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
+		olddev = curdev = unfitness_lazy (&xc, enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
 
 		if (!quiet) printf ("\nConvergence rating calculation (cycle #%d)\n\n", cycle+1);
-		if (!quiet) printf ("%3s %4s %12s%14s\n", "phase", "iteration", "deviation","resolution");
+		if (!quiet) {
+			printf ("%3s %4s %12s%14s", "phase", "iteration", "deviation","resolution");
+			if (active_set) printf ("%8s", "active");
+			printf ("\n");
+		}
 
 		while (!done && n-->0) {
 			bool_t failed = FALSE;
@@ -654,20 +1030,28 @@ calc_rating_ordo
 
 			assert(ratings_sanity (n_players, ratingof)); //%%
 			// adjust white advantage and draw rate at the beginning
-			if (adjust_white_advantage) {
-					white_adv = adjust_wadv (white_adv, ratingof, n_enc, enc, BETA, resol);
+			if (adjust_white_advantage && adjust_draw_rate 
+				&& adjust_wadv_drawrate (&white_adv, &draw_rate, ratingof, n_enc, enc, BETA)) {
 					wa_progress = wa_previous > white_adv? wa_previous - white_adv: white_adv - wa_previous;
 					wa_previous = white_adv;
+			} else {
+				if (adjust_white_advantage) {
+						white_adv = adjust_wadv (white_adv, ratingof, n_enc, enc, BETA, resol);
+						wa_progress = wa_previous > white_adv? wa_previous - white_adv: white_adv - wa_previous;
+						wa_previous = white_adv;
+				}
+				if (adjust_draw_rate) {
+						draw_rate = adjust_drawrate (white_adv, ratingof, n_enc, enc, BETA);
+				} 
 			}
-			if (adjust_draw_rate) {
-					draw_rate = adjust_drawrate (white_adv, ratingof, n_enc, enc, BETA);
-			} 
 
 			for (i = 0; i < rounds && !done && !failed; i++) {
 
 				cd = 0;
 
 				ratings_copyto (n_players, ratingof, ratingbk); // backup
+				ratings_copyto (n_players, expected, expectbk);
+				bkvalid = xc.valid && xc.wadv == white_adv;
 				olddev = curdev;
 
 				assert(ratings_sanity (n_players, ratingof)); //%%
@@ -683,15 +1067,33 @@ calc_rating_ordo
 							, expected 
 							, obtained 
 							, playedby
+							, quietfor
+							, &active
 							, ratingof
 							);
 
-				curdev = unfitness ( enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
+				if (active_set) {
+					active_set->steps += active;
+					active_set->full  += movable;
+					active_set->last   = active;
+				}
+
+				curdev = unfitness_lazy (&xc, enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
 				failed = curdev >= olddev;
 
 				if (failed) {
 					ratings_copyto (n_players, ratingbk, ratingof); // restore
-					curdev = unfitness ( enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
+					if (quietfor) {
+						for (j = 0; j < n_players; j++) quietfor[j] = 0; // retry with everybody active
+					}
+					if (bkvalid) {
+						// exact restore, recalculating would accumulate rounding errors
+						xcache_revert (&xc, enc, n_players, ratingof, BETA);
+						ratings_copyto (n_players, expectbk, expected);
+						curdev = deviation (n_players, flagged, expected, obtained, playedby);
+					} else {
+						curdev = unfitness_lazy (&xc, enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
+					}
 					assert (i == 0 || absol(curdev-olddev) < PRECISIONERROR || 
 								!fprintf(stderr, "i=%d, curdev=%.10e, olddev=%.10e, diff=%.10e\n", i, curdev, olddev, olddev-curdev));
 				} else {
@@ -713,6 +1115,7 @@ calc_rating_ordo
 							, playedby
 							, ratingtmp
 							);
+						xc.valid = FALSE; // expected[] was used as a buffer
 					} 
 					last_cd = cd;
 
@@ -720,7 +1123,7 @@ calc_rating_ordo
 						mobile_center_apply_excess (cd, n_players, flagged, prefed, ratingof);
 					}
 
-					curdev = unfitness ( enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
+					curdev = unfitness_lazy (&xc, enc, n_enc, n_players, ratingof, flagged, white_adv, BETA, obtained, playedby, expected);
 					kk *= (1.0-1.0/KK_DAMP); //kk *= 0.995;
 				}
 
@@ -734,6 +1137,7 @@ calc_rating_ordo
 			if (!quiet) {
 				printf ("%3d %7d %16.9f", phase, i, get_outputdev (curdev, n_games));
 				printf ("%14.5f", resol);
+				if (active_set) printf ("%8ld", (long)active);
 				//	printf ("%10.5lf",ratings_rmsd(n_players, ratingof, RAT));
 				printf ("\n");
 			}
@@ -741,16 +1145,24 @@ calc_rating_ordo
 
 		} // end n-->0
 
+		converged = done;
+
 		if (!quiet) printf ("done\n");
 
-		if (adjust_white_advantage) {
-				white_adv = adjust_wadv (white_adv, ratingof, n_enc, enc, BETA, resol);
+		if (adjust_white_advantage && adjust_draw_rate 
+			&& adjust_wadv_drawrate (&white_adv, &draw_rate, ratingof, n_enc, enc, BETA)) {
 				wa_progress = wa_previous > white_adv? wa_previous - white_adv: white_adv - wa_previous;
 				wa_previous = white_adv;
+		} else {
+			if (adjust_white_advantage) {
+					white_adv = adjust_wadv (white_adv, ratingof, n_enc, enc, BETA, resol);
+					wa_progress = wa_previous > white_adv? wa_previous - white_adv: white_adv - wa_previous;
+					wa_previous = white_adv;
+			}
+			if (adjust_draw_rate) {
+					draw_rate = adjust_drawrate (white_adv, ratingof, n_enc, enc, BETA);
+			} 
 		}
-		if (adjust_draw_rate) {
-				draw_rate = adjust_drawrate (white_adv, ratingof, n_enc, enc, BETA);
-		} 
 
 		if (!quiet)	printf ("\nWhite Advantage = %.1f", white_adv);
 		if (!quiet)	printf ("\nDraw Rate (eq.) = %.1f %s\n\n", 100*draw_rate, "%");
@@ -766,9 +1178,11 @@ calc_rating_ordo
 		correct_excess (n_players, flagged, excess, ratingof);
 	}
 
+	xcache_done (&xc);
+
 	timelog("Post-Convergence rating estimation...");
 
-	encounters_calculate(ENCOUNTERS_FULL, g, flagged, encount);
+	encounters_select(ENCOUNTERS_FULL, full, flagged, encount);
 	enc   = encount->enc;
 	n_enc = encount->n;
 
@@ -776,9 +1190,9 @@ calc_rating_ordo
 
 	timelog("rate_super_players...");
 
-	rate_super_players(quiet, enc, n_enc, Performance_type, n_players, ratingof, white_adv, flagged, name, draw_rate, BETA); 
+	rate_super_players(quiet, enc, n_enc, Performance_type, n_players, ratingof, white_adv, flagged, name, draw_rate, BETA, cpus); 
 
-	encounters_calculate(ENCOUNTERS_NOFLAGGED, g, flagged, encount);
+	encounters_select(ENCOUNTERS_NOFLAGGED, full, flagged, encount);
 	enc   = encount->enc;
 	n_enc = encount->n;
 
@@ -788,7 +1202,10 @@ calc_rating_ordo
 
 	*pWhite_advantage = white_adv;
 	*pDraw_date = draw_rate;
+	*pConverged = converged;
 
+	if (quietfor) memrel(quietfor);
+	memrel(expectbk);
 	memrel(expected);
 	return n_enc;
 }
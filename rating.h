@@ -31,6 +31,9 @@ calc_rating_ordo
 				, bool_t 			adjust_white_advantage
 				, bool_t			adjust_draw_rate
 				, bool_t			anchor_use
+				, int				warm_start	// enum Warm_Start_Type
+				, int				cpus		// threads for the players with all wins or all losses
+				, struct ACTIVESTATS *active_set	// NULL when the active set is not used
 
 				, double			*ratingtmp_buffer
 
@@ -40,11 +43,13 @@ calc_rating_ordo
 
 				, struct ENCOUNTERS *encount
 				, struct PLAYERS 	*plyrs
-				, struct GAMES 		*g
+				, const struct ENCOUNTERS *full	// all the games, ENCOUNTERS_FULL
+				, gamesnum_t		n_games
 				, struct RATINGS 	*rat
 
 				, double			*pWhite_advantage
 				, double			*pDraw_date
+				, bool_t			*pConverged
 )
 ;
 
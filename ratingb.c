@@ -31,8 +31,13 @@
 #include "mymem.h"
 
 #define MIN_RESOLUTION           0.000001
+#define WARM_START_DENOM         243 // 3^5, skips the first phases when the starting point is close
+#define SIM_WARM_DENOM           27  // 3^3, a simulated run is further away from the original results
 #define MIN_DRAW_RATE_RESOLUTION 0.00001
+#define WADV_DRAWRATE_MAXITER    50
+#define MIN_PROBABILITY          1E-32
 #define PRIOR_SMALLEST_SIGMA     0.0000001
+#define ACTIVE_ROUNDS            2 // rounds with the position bracketed before a player is frozen
 
 #if !defined(NDEBUG)
 static bool_t is_nan (double x) {if (x != x) return TRUE; else return FALSE;}
@@ -132,6 +137,75 @@ super_players_present(player_t n_players, int *performance_type)
 	return found;
 }
 
+//========================= ACTIVE SET ==========================================
+
+/*
+|	In unevenly connected pools, a few sparsely connected players may need
+|	many rounds after everybody else has settled. A player whose position
+|	stays bracketed (change of +/- 0.5) for ACTIVE_ROUNDS rounds is frozen,
+|	and only the encounters of the active players are calculated again.
+|	A frozen player rejoins when the moves of its opponents add up to half 
+|	a step, and everybody rejoins at the beginning of each phase.
+*/
+
+struct ACTIVESET {
+	gamesnum_t *	first;		// per player, index of the first encounter in "list"
+	gamesnum_t *	list;		// encounters of each player, contiguous
+	gamesnum_t *	games;		// games played by each player
+	double *		encll;		// log likelihood of each encounter
+	double *		drift;		// moves of the opponents since frozen, per game
+	int *			quietfor;	// rounds in a row with the position bracketed
+	player_t *		active;
+	bool_t *		isactive;
+	player_t		n_active;
+	double			llsum;		// sum of encll
+	bool_t			valid;		// encll and llsum are up to date
+};
+
+static bool_t	activeset_init 	(struct ACTIVESET *as, const struct ENC *enc, gamesnum_t n_enc, player_t n_players);
+static void		activeset_done 	(struct ACTIVESET *as);
+static void		activeset_thaw 	(struct ACTIVESET *as, player_t n_players);
+static bool_t	activeset_select(struct ACTIVESET *as, player_t n_players, const bool_t *flagged, const bool_t *prefed);
+
+static void
+activeset_derivatives	( struct ACTIVESET *as
+						, const struct ENC *enc
+						, double delta
+						, double deq
+						, double beta
+						, player_t n_players
+						, double *ratingof
+						, double white_advantage
+		 				, const struct prior *pp
+						, player_t n_relative_anchors
+						, struct relprior *ra
+						, double *probarray
+						, double *vector 
+);
+
+static void
+activeset_quiet (struct ACTIVESET *as, const double *vector, player_t n_relative_anchors, const struct relprior *ra);
+
+static void
+activeset_drift (struct ACTIVESET *as, const struct ENC *enc, double delta, const double *vector);
+
+static double
+activeset_unfitness	( struct ACTIVESET *as
+					, bool_t partial
+					, gamesnum_t n_enc
+					, const struct ENC *enc
+					, player_t n_players
+					, const struct prior *p
+					, double wadv
+					, struct prior wa_prior
+					, player_t n_relative_anchors
+					, const struct relprior *ra
+					, const double *ratingof
+					, double deq
+					, struct prior dr_prior
+					, double beta
+);
+
 static double
 adjust_wadv_bayes 
 				( gamesnum_t n_enc
@@ -167,6 +241,23 @@ adjust_drawrate_bayes
 				, double beta
 );
 
+static bool_t
+adjust_wadv_drawrate_bayes 
+				( gamesnum_t n_enc
+				, const struct ENC *enc
+				, player_t n_players
+				, const struct prior *p
+				, struct prior wa_prior
+				, player_t n_relative_anchors
+				, const struct relprior *ra
+				, const double *ratingof
+				, double resol
+				, struct prior dr_prior
+				, double beta
+				, double *pwadv
+				, double *pdeq
+);
+
 
 // no globals
 static void
@@ -236,6 +327,9 @@ calc_rating_bayes
 			, bool_t 				adjust_white_advantage
 			, bool_t				adjust_draw_rate
 			, bool_t				anchor_use
+			, int					warm_start	// enum Warm_Start_Type
+			, int					cpus		// threads for the players with all wins or all losses
+			, struct ACTIVESTATS *	active_set	// NULL when the active set is not used
 
 			, double				beta
 			, double				general_average
@@ -245,7 +339,8 @@ calc_rating_bayes
 
 			, struct ENCOUNTERS *	encount
 			, struct PLAYERS *		plyrs
-			, struct GAMES *		g
+			, const struct ENCOUNTERS *full
+			, gamesnum_t			n_games
 			, struct RATINGS *		rat
 
 			, struct prior *		pp
@@ -255,15 +350,17 @@ calc_rating_bayes
 
 			, double *				pwadv
 			, double *				pDraw_date
+			, bool_t *				pConverged
 )
 {
-	gamesnum_t  n_games = g->n;
 	double 		olddev, curdev, outputdev;
 	int 		i;
 	int			rounds = 10000;
 	double 		rtng_76 = (-log(1.0/0.76-1.0))/beta;
-	double 		delta = rtng_76; //should be proportional to the scale
 	double 		denom = 3;
+	double 		delta = warm_start == WARM_PREVIOUS? rtng_76/WARM_START_DENOM	//should be proportional to the scale
+					  : warm_start == WARM_RESULTS?  rtng_76/SIM_WARM_DENOM
+					  : rtng_76;
 	int 		phase = 0;
 	int 		n = 40;
 	double 		resol = delta;
@@ -271,6 +368,12 @@ calc_rating_bayes
 	double		deq = *pDraw_date;
 	double 		white_advantage = *pwadv;
 	double *	probarr;
+	bool_t		partial = FALSE;
+	bool_t		joint;		// white advantage and draw rate adjusted together
+	struct ACTIVESET as;
+	struct ACTIVESET *pas = NULL;	// &as when the active set is used
+	player_t	movable = 0;
+	player_t	j;
 
 	// translation variables for refactoring ------------------
 	struct ENC *	enc 			= encount->enc;
@@ -296,10 +399,34 @@ calc_rating_bayes
 		exit(EXIT_FAILURE);
 	}
 
+	if (active_set != NULL) {
+		if (!activeset_init (&as, enc, n_enc, n_players)) {
+			fprintf(stderr,"Not enough memory to initialize the active set\n");
+			exit(EXIT_FAILURE);
+		}
+		pas = &as;
+	}
+
 	assert(deq <= 1 && deq >= 0);
 
 	// initial deviation
-	olddev = curdev = calc_bayes_unfitness_full	
+	olddev = curdev = pas != NULL
+						? activeset_unfitness	
+							( pas
+							, FALSE
+							, n_enc
+							, enc
+							, n_players
+							, pp
+							, white_advantage
+							, wa_prior
+							, n_relative_anchors
+							, ra
+							, ratingof
+							, deq
+							, dr_prior
+							, beta)
+						: calc_bayes_unfitness_full	
 							( n_enc
 							, enc
 							, n_players
@@ -313,8 +440,16 @@ calc_rating_bayes
 							, dr_prior
 							, beta);
 
+	for (j = 0; j < n_players; j++) {
+		if (!flagged[j] && !prefed[j]) movable++;
+	}
+
 	if (!quiet) printf ("Converging...\n\n");
-	if (!quiet) printf ("%3s %4s %10s %10s\n", "phase", "iteration", "unfitness","resolution");
+	if (!quiet) {
+		printf ("%3s %4s %10s %10s", "phase", "iteration", "unfitness","resolution");
+		if (pas) printf (" %7s", "active");
+		printf ("\n");
+	}
 
 	while (n-->0 && resol >= MIN_RESOLUTION) {
 
@@ -322,8 +457,30 @@ calc_rating_bayes
 			ratings_backup  (n_players, ratingof, ratingbk);
 			olddev = curdev;
 
-			// Calc "changing" vector
-			derivative_vector_calc
+			// Calc "changing" vector, only for the active players if most are frozen
+			if (pas) {
+				partial = activeset_select (pas, n_players, flagged, prefed);
+				active_set->steps += pas->n_active;
+				active_set->full  += movable;
+				active_set->last   = pas->n_active;
+			}
+			if (partial) {
+				activeset_derivatives
+						( pas
+						, enc
+						, delta
+						, deq
+						, beta
+						, n_players
+						, ratingof
+						, white_advantage
+						, pp
+						, n_relative_anchors
+						, ra
+						, probarr
+						, changing );
+			} else {
+				derivative_vector_calc
 						( delta
 						, n_enc
 						, enc
@@ -339,6 +496,8 @@ calc_rating_bayes
 						, ra
 						, probarr
 						, changing );
+			}
+			if (pas) activeset_quiet (pas, changing, n_relative_anchors, ra);
 
 			resol = adjust_rating_bayes 
 						( delta
@@ -362,7 +521,26 @@ calc_rating_bayes
 						, ratingbk // out 
 					);
 
-			curdev = calc_bayes_unfitness_full	
+			if (partial && resol < delta/2) 
+				resol = delta/2; // frozen players are bracketed
+
+			curdev = pas != NULL
+					? activeset_unfitness	
+						( pas
+						, partial
+						, n_enc
+						, enc
+						, n_players
+						, pp
+						, white_advantage
+						, wa_prior
+						, n_relative_anchors
+						, ra
+						, ratingof
+						, deq
+						, dr_prior
+						, beta)
+					: calc_bayes_unfitness_full	
 						( n_enc
 						, enc
 						, n_players
@@ -379,9 +557,11 @@ calc_rating_bayes
 			if (curdev < olddev) {
 				ratings_backup  (n_players, ratingof, ratingbk);
 				olddev = curdev;
+				if (partial) activeset_drift (pas, enc, delta, changing);
 			} else {
 				ratings_restore (n_players, ratingbk, ratingof);
 				curdev = olddev;
+				if (pas) pas->valid = FALSE;
 				break;
 			}
 		}
@@ -392,11 +572,42 @@ calc_rating_bayes
 		if (!quiet) {
 			printf ("%3d %7d %14.5f", phase, i, outputdev);
 			printf ("%11.5f",resol);
+			if (pas) printf ("%8ld", (long)pas->n_active);
 			printf ("\n");
 		}
+
+		// new step size, white advantage or draw rate
+		if (pas) {
+			activeset_thaw (pas, n_players);
+			pas->valid = FALSE;
+		}
 		phase++;
 
-		if (adjust_white_advantage) {
+		joint = FALSE;
+		if (adjust_white_advantage && adjust_draw_rate) {
+			double deqx = deq;
+			joint = adjust_wadv_drawrate_bayes 
+							( n_enc
+							, enc
+							, n_players
+							, pp
+							, wa_prior
+							, n_relative_anchors
+							, ra
+							, ratingof
+							, resol
+							, dr_prior
+							, beta
+							, &white_advantage
+							, &deqx);
+			if (joint) {
+				resol_dr = deqx > deq? deqx - deq: deq - deqx;
+				deq = deqx;
+				*pwadv = white_advantage;
+			}
+		}
+
+		if (adjust_white_advantage && !joint) {
 			white_advantage = adjust_wadv_bayes 
 							( n_enc
 							, enc
@@ -415,7 +626,7 @@ calc_rating_bayes
 			*pwadv = white_advantage;
 		}
 
-		if (adjust_draw_rate) {
+		if (adjust_draw_rate && !joint) {
 			double deqx;
 			deqx = adjust_drawrate_bayes 
 							( n_enc
@@ -437,6 +648,10 @@ calc_rating_bayes
 		}
 	}
 
+	*pConverged = resol < MIN_RESOLUTION;
+
+	if (pas) activeset_done (pas);
+
 	if (!quiet) {
 		printf ("done\n");
 		printf ("\nWhite Advantage = %.1f", white_advantage);
@@ -445,17 +660,14 @@ calc_rating_bayes
 	if (!quiet && super_players_present(n_players, performance_type)) 
 		printf ("Post-Convergence rating estimation for all-wins / all-losses players\n\n");
 
-//	n_enc = calc_encounters(ENCOUNTERS_FULL, g, flagged, enc);
-
-	encounters_calculate(ENCOUNTERS_FULL, g, flagged, encount);
+	encounters_select(ENCOUNTERS_FULL, full, flagged, encount);
 	enc   = encount->enc;
 	n_enc = encount->n;
 
 	calc_obtained_playedby(enc, n_enc, n_players, obtained, playedby);
-	rate_super_players(quiet, enc, n_enc, performance_type, n_players, ratingof, white_advantage, flagged, name, deq, beta); 
-//	n_enc = calc_encounters(ENCOUNTERS_NOFLAGGED, g, flagged, enc);
+	rate_super_players(quiet, enc, n_enc, performance_type, n_players, ratingof, white_advantage, flagged, name, deq, beta, cpus); 
 
-	encounters_calculate(ENCOUNTERS_NOFLAGGED, g, flagged, encount);
+	encounters_select(ENCOUNTERS_NOFLAGGED, full, flagged, encount);
 	enc   = encount->enc;
 	n_enc = encount->n;
 
@@ -521,6 +733,25 @@ prior_unfitness	( player_t n_players
 	return accum;
 }
 
+// no globals
+static double
+encounter_loglikelihood (const struct ENC *pe, const double *ratingof, double wadv, double deq, double beta)
+{
+	double pw, pd, pl;
+	gamesnum_t ww,dd,ll;
+
+	get_pWDL(ratingof[pe->wh] + wadv - ratingof[pe->bl], &pw, &pd, &pl, deq, beta);
+
+	ww = pe->W;
+	dd = pe->D;
+	ll = pe->L;
+
+	return		(ww > 0? (double)ww * log(pw) : 0) 
+			+ 	(dd > 0? (double)dd * log(pd) : 0) 
+			+ 	(ll > 0? (double)ll * log(pl) : 0)
+	;
+}
+
 // no globals
 static double
 calc_bayes_unfitness_full	
@@ -538,28 +769,13 @@ calc_bayes_unfitness_full
 				, double beta
 )
 {
-	double pw, pd, pl, accum;
-	player_t w, b;
-	gamesnum_t ww,dd,ll;
+	double accum;
 	gamesnum_t e;
 
 	assert(deq <= 1 && deq >= 0);
 
 	for (accum = 0, e = 0; e < n_enc; e++) {
-	
-		w = enc[e].wh;
-		b = enc[e].bl;
-
-		get_pWDL(ratingof[w] + wadv - ratingof[b], &pw, &pd, &pl, deq, beta);
-
-		ww = enc[e].W;
-		dd = enc[e].D;
-		ll = enc[e].L;
-
-		accum 	+= 	(ww > 0? (double)ww * log(pw) : 0) 
-				+ 	(dd > 0? (double)dd * log(pd) : 0) 
-				+ 	(ll > 0? (double)ll * log(pl) : 0)
-		;
+		accum += encounter_loglikelihood (&enc[e], ratingof, wadv, deq, beta);
 	}
 	
 	assert(!is_nan(accum));
@@ -615,45 +831,58 @@ probarray_reset(player_t n_players, double *probarray)
 
 // no globals
 static void
-probarray_build	( gamesnum_t n_enc
-				, const struct ENC *enc
+probarray_add	( const struct ENC *pe
 				, double inputdelta
 				, double deq
 				, double beta
-				, double *ratingof
+				, const double *ratingof
 				, double white_advantage
 				, double *probarray)
 {
 	double pw, pd, pl, delta;
 	double p;
 	player_t w,b;
-	gamesnum_t e;
-	assert(deq <= 1 && deq >= 0);
 
-	for (e = 0; e < n_enc; e++) {
-		w = enc[e].wh;	b = enc[e].bl;
+	w = pe->wh;	b = pe->bl;
+
+	delta = 0;
+	get_pWDL(ratingof[w] + delta + white_advantage - ratingof[b], &pw, &pd, &pl, deq, beta);
+	p = wdl_probabilities (pe->W, pe->D, pe->L, pw, pd, pl);
 
-		delta = 0;
-		get_pWDL(ratingof[w] + delta + white_advantage - ratingof[b], &pw, &pd, &pl, deq, beta);
-		p = wdl_probabilities (enc[e].W, enc[e].D, enc[e].L, pw, pd, pl);
+	probarray [(w<<2)|1] -= p;			
+	probarray [(b<<2)|1] -= p;	
 
-		probarray [(w<<2)|1] -= p;			
-		probarray [(b<<2)|1] -= p;	
+	delta = +inputdelta;
+	get_pWDL(ratingof[w] + delta + white_advantage - ratingof[b], &pw, &pd, &pl, deq, beta);
+	p = wdl_probabilities (pe->W, pe->D, pe->L, pw, pd, pl);
 
-		delta = +inputdelta;
-		get_pWDL(ratingof[w] + delta + white_advantage - ratingof[b], &pw, &pd, &pl, deq, beta);
-		p = wdl_probabilities (enc[e].W, enc[e].D, enc[e].L, pw, pd, pl);
+	probarray [(w<<2)|2] -= p;			
+	probarray [(b<<2)|0] -= p;	
 
-		probarray [(w<<2)|2] -= p;			
-		probarray [(b<<2)|0] -= p;	
+	delta = -inputdelta;
+	get_pWDL(ratingof[w] + delta + white_advantage - ratingof[b], &pw, &pd, &pl, deq, beta);
+	p = wdl_probabilities (pe->W, pe->D, pe->L, pw, pd, pl);
 
-		delta = -inputdelta;
-		get_pWDL(ratingof[w] + delta + white_advantage - ratingof[b], &pw, &pd, &pl, deq, beta);
-		p = wdl_probabilities (enc[e].W, enc[e].D, enc[e].L, pw, pd, pl);
+	probarray [(w<<2)|0] -= p;			
+	probarray [(b<<2)|2] -= p;	
+}
 
-		probarray [(w<<2)|0] -= p;			
-		probarray [(b<<2)|2] -= p;	
+// no globals
+static void
+probarray_build	( gamesnum_t n_enc
+				, const struct ENC *enc
+				, double inputdelta
+				, double deq
+				, double beta
+				, double *ratingof
+				, double white_advantage
+				, double *probarray)
+{
+	gamesnum_t e;
+	assert(deq <= 1 && deq >= 0);
 
+	for (e = 0; e < n_enc; e++) {
+		probarray_add (&enc[e], inputdelta, deq, beta, ratingof, white_advantage, probarray);
 	}
 }
 
@@ -732,6 +961,280 @@ static void ratings_apply_excess_correction(double excess, player_t n_players, c
 
 static double absol(double x) {return x < 0? -x: x;}
 
+//========================= ACTIVE SET ==========================================
+
+static bool_t
+activeset_init (struct ACTIVESET *as, const struct ENC *enc, gamesnum_t n_enc, player_t n_players)
+{
+	gamesnum_t e;
+	player_t j;
+
+	as->first	 = memnew (sizeof(gamesnum_t) * (size_t)(n_players+1));
+	as->list	 = memnew (sizeof(gamesnum_t) * (size_t)(2*n_enc+1));
+	as->games	 = memnew (sizeof(gamesnum_t) * (size_t)(n_players+1));
+	as->encll	 = memnew (sizeof(double)     * (size_t)(n_enc+1));
+	as->drift	 = memnew (sizeof(double)     * (size_t)(n_players+1));
+	as->quietfor = memnew (sizeof(int)        * (size_t)(n_players+1));
+	as->active	 = memnew (sizeof(player_t)   * (size_t)(n_players+1));
+	as->isactive = memnew (sizeof(bool_t)     * (size_t)(n_players+1));
+	as->n_active = 0;
+	as->llsum	 = 0;
+	as->valid	 = FALSE;
+
+	if (!as->first || !as->list || !as->games || !as->encll || !as->drift 
+		|| !as->quietfor || !as->active || !as->isactive) {
+		if (as->first) 		memrel(as->first);
+		if (as->list) 		memrel(as->list);
+		if (as->games) 		memrel(as->games);
+		if (as->encll) 		memrel(as->encll);
+		if (as->drift) 		memrel(as->drift);
+		if (as->quietfor) 	memrel(as->quietfor);
+		if (as->active) 	memrel(as->active);
+		if (as->isactive) 	memrel(as->isactive);
+		return FALSE;
+	}
+
+	// count, accumulate and fill (encounters indexed by player)
+	for (j = 0; j <= n_players; j++) {
+		as->first[j] = 0;
+		as->games[j] = 0;
+	}
+	for (e = 0; e < n_enc; e++) {
+		as->first[enc[e].wh+1]++;
+		as->first[enc[e].bl+1]++;
+		as->games[enc[e].wh] += enc[e].played;
+		as->games[enc[e].bl] += enc[e].played;
+	}
+	for (j = 0; j < n_players; j++) {
+		as->first[j+1] += as->first[j];
+	}
+	for (e = 0; e < n_enc; e++) {
+		as->list[as->first[enc[e].wh]++] = e;
+		as->list[as->first[enc[e].bl]++] = e;
+	}
+	for (j = n_players; j > 0; j--) {
+		as->first[j] = as->first[j-1];
+	}
+	as->first[0] = 0;
+
+	activeset_thaw (as, n_players);
+	return TRUE;
+}
+
+static void
+activeset_done (struct ACTIVESET *as)
+{
+	memrel(as->first);
+	memrel(as->list);
+	memrel(as->games);
+	memrel(as->encll);
+	memrel(as->drift);
+	memrel(as->quietfor);
+	memrel(as->active);
+	memrel(as->isactive);
+}
+
+static void
+activeset_thaw (struct ACTIVESET *as, player_t n_players)
+{
+	player_t j;
+	for (j = 0; j < n_players; j++) {
+		as->quietfor[j] = 0;
+		as->drift[j] = 0;
+	}
+}
+
+// Returns TRUE when only the active players need to be calculated
+static bool_t
+activeset_select (struct ACTIVESET *as, player_t n_players, const bool_t *flagged, const bool_t *prefed)
+{
+	player_t j, n;
+
+	for (n = 0, j = 0; j < n_players; j++) {
+		as->isactive[j] = FALSE;
+		if (flagged[j] || prefed[j]) 
+			continue;
+		if (as->quietfor[j] < ACTIVE_ROUNDS) {
+			as->active[n++] = j;
+			as->isactive[j] = TRUE;
+		}
+	}
+	as->n_active = n;
+
+	if (n <= n_players/4)
+		return TRUE;
+
+	// too many, everybody moves
+	for (n = 0, j = 0; j < n_players; j++) {
+		if (flagged[j] || prefed[j]) 
+			continue;
+		as->active[n++] = j;
+		as->isactive[j] = TRUE;
+	}
+	as->n_active = n;
+	return FALSE;
+}
+
+// no globals
+static void
+activeset_derivatives	( struct ACTIVESET *as
+						, const struct ENC *enc
+						, double delta
+						, double deq
+						, double beta
+						, player_t n_players
+						, double *ratingof
+						, double white_advantage
+		 				, const struct prior *pp
+						, player_t n_relative_anchors
+						, struct relprior *ra
+						, double *probarray
+						, double *vector 
+)
+{
+	player_t j, k, other;
+	gamesnum_t i, e;
+
+	for (k = 0; k < as->n_active; k++) {
+		j = as->active[k];
+		probarray[(j<<2)|0] = 0;
+		probarray[(j<<2)|1] = 0;
+		probarray[(j<<2)|2] = 0;
+	}
+
+	// an encounter between two active players is done once, by the one with lower index
+	for (k = 0; k < as->n_active; k++) {
+		j = as->active[k];
+		for (i = as->first[j]; i < as->first[j+1]; i++) {
+			e = as->list[i];
+			other = enc[e].wh == j? enc[e].bl: enc[e].wh;
+			if (as->isactive[other] && other < j) continue;
+			probarray_add (&enc[e], delta, deq, beta, ratingof, white_advantage, probarray);
+		}
+	}
+
+	for (j = 0; j < n_players; j++) {
+		vector[j] = 0.0;
+	}
+	for (k = 0; k < as->n_active; k++) {
+		j = as->active[k];
+		vector[j] = derivative_single (j, delta, ratingof, pp, n_relative_anchors, ra, probarray);
+	}
+}
+
+static void
+activeset_quiet (struct ACTIVESET *as, const double *vector, player_t n_relative_anchors, const struct relprior *ra)
+{
+	player_t j, k;
+
+	for (k = 0; k < as->n_active; k++) {
+		j = as->active[k];
+		if (absol(vector[j]) < 1.0) {
+			as->quietfor[j]++;
+			as->drift[j] = 0;
+		} else {
+			as->quietfor[j] = 0;
+		}
+	}
+
+	// linked by relative anchors, never frozen
+	for (k = 0; k < n_relative_anchors; k++) {
+		as->quietfor[ra[k].player_a] = 0;
+		as->quietfor[ra[k].player_b] = 0;
+	}
+}
+
+static void
+activeset_drift (struct ACTIVESET *as, const struct ENC *enc, double delta, const double *vector)
+{
+	player_t j, k, other;
+	gamesnum_t i, e;
+	double move;
+
+	for (k = 0; k < as->n_active; k++) {
+		j = as->active[k];
+		move = delta * vector[j];
+		for (i = as->first[j]; i < as->first[j+1]; i++) {
+			e = as->list[i];
+			other = enc[e].wh == j? enc[e].bl: enc[e].wh;
+			if (as->isactive[other] || as->quietfor[other] < ACTIVE_ROUNDS) 
+				continue;
+			as->drift[other] += move * (double)enc[e].played / (double)as->games[other];
+			if (absol(as->drift[other]) >= delta/2) {
+				as->quietfor[other] = 0; // rejoins
+				as->drift[other] = 0;
+			}
+		}
+	}
+}
+
+// no globals
+static double
+activeset_unfitness	( struct ACTIVESET *as
+					, bool_t partial
+					, gamesnum_t n_enc
+					, const struct ENC *enc
+					, player_t n_players
+					, const struct prior *p
+					, double wadv
+					, struct prior wa_prior
+					, player_t n_relative_anchors
+					, const struct relprior *ra
+					, const double *ratingof
+					, double deq
+					, struct prior dr_prior
+					, double beta
+)
+{
+	player_t j, k, other;
+	gamesnum_t i, e;
+	double ll, accum;
+
+	if (!partial || !as->valid) {
+		for (accum = 0, e = 0; e < n_enc; e++) {
+			ll = encounter_loglikelihood (&enc[e], ratingof, wadv, deq, beta);
+			as->encll[e] = ll;
+			accum += ll;
+		}
+		as->llsum = accum;
+		as->valid = TRUE;
+	} else {
+		// frozen players moved together (normalization), their encounters did not change
+		for (k = 0; k < as->n_active; k++) {
+			j = as->active[k];
+			for (i = as->first[j]; i < as->first[j+1]; i++) {
+				e = as->list[i];
+				other = enc[e].wh == j? enc[e].bl: enc[e].wh;
+				if (as->isactive[other] && other < j) continue;
+				ll = encounter_loglikelihood (&enc[e], ratingof, wadv, deq, beta);
+				as->llsum += ll - as->encll[e];
+				as->encll[e] = ll;
+			}
+		}
+	}
+
+	accum = as->llsum;
+	assert(!is_nan(accum));
+
+	// Priors
+	accum += -prior_unfitness
+				( n_players
+				, p
+				, wadv
+				, wa_prior
+				, n_relative_anchors
+				, ra
+				, ratingof
+				, deq
+				, dr_prior
+				);
+
+	assert(!is_nan(accum));
+
+	return -accum;
+}
+
+
 // no globals
 static double
 adjust_rating_bayes 
@@ -1179,3 +1682,136 @@ adjust_drawrate_bayes
 	return dr;
 }
 
+// Expected information in wadv and deq for the games, gradient of the log likelihood in g[], 
+// and the information matrix in h[] as h[0] = wadv-wadv, h[1] = wadv-deq, h[2] = deq-deq
+static void
+wadv_drawrate_information 
+				( gamesnum_t n_enc
+				, const struct ENC *enc
+				, const double *ratingof
+				, double wadv
+				, double deq
+				, double beta
+				, double *g /*@out@*/
+				, double *h /*@out@*/
+)
+{
+	gamesnum_t e;
+	double f, df, x, x_f, x_d, t;
+	double pw, pd, pl;
+	double aw, ad, al; // derivatives of pw, pd, pl with wadv
+	double bw, bd, bl; // derivatives of pw, pd, pl with deq
+
+	g[0] = g[1] = 0;
+	h[0] = h[1] = h[2] = 0;
+
+	for (e = 0; e < n_enc; e++) {
+		f  = xpect (ratingof[enc[e].wh] + wadv, ratingof[enc[e].bl], beta);
+		df = beta * f * (1 - f);
+		draw_rate_fperf_deriv (f, deq, &x, &x_f, &x_d);
+
+		pw = f - x/2;
+		pd = x;
+		pl = 1 - f - x/2;
+		if (pw < MIN_PROBABILITY) pw = MIN_PROBABILITY;
+		if (pd < MIN_PROBABILITY) pd = MIN_PROBABILITY;
+		if (pl < MIN_PROBABILITY) pl = MIN_PROBABILITY;
+
+		aw = df * (1 - x_f/2);
+		ad = df * x_f;
+		al = -df * (1 + x_f/2);
+		bw = -x_d/2;
+		bd = x_d;
+		bl = -x_d/2;
+
+		g[0] += (double)enc[e].W * aw/pw + (double)enc[e].D * ad/pd + (double)enc[e].L * al/pl;
+		g[1] += (double)enc[e].W * bw/pw + (double)enc[e].D * bd/pd + (double)enc[e].L * bl/pl;
+
+		t = (double)(enc[e].W + enc[e].D + enc[e].L);
+		h[0] += t * (aw*aw/pw + ad*ad/pd + al*al/pl);
+		h[1] += t * (aw*bw/pw + ad*bd/pd + al*bl/pl);
+		h[2] += t * (bw*bw/pw + bd*bd/pd + bl*bl/pl);
+	}
+}
+
+// no globals
+// Fisher scoring on wadv and deq at once, each step needs one pass over the encounters 
+// instead of the line searches of adjust_wadv_bayes() and adjust_drawrate_bayes().
+// Returns FALSE if it does not converge, then the caller should use them.
+static bool_t
+adjust_wadv_drawrate_bayes 
+				( gamesnum_t n_enc
+				, const struct ENC *enc
+				, player_t n_players
+				, const struct prior *p
+				, struct prior wa_prior
+				, player_t n_relative_anchors
+				, const struct relprior *ra
+				, const double *ratingof
+				, double resol
+				, struct prior dr_prior
+				, double beta
+				, double *pwadv
+				, double *pdeq
+)
+{
+	double g[2], h[3];
+	double wa, dr, sw, sd, det, u, unew, s2;
+	int i, halved;
+
+	wa = *pwadv;
+	dr = *pdeq > 0 && *pdeq < 1? *pdeq: 0.5;
+
+	u = calc_bayes_unfitness_full (n_enc, enc, n_players, p, wa, wa_prior, n_relative_anchors, ra, ratingof, dr, dr_prior, beta);
+
+	for (i = 0; i < WADV_DRAWRATE_MAXITER; i++) {
+
+		wadv_drawrate_information (n_enc, enc, ratingof, wa, dr, beta, g, h);
+
+		if (wa_prior.isset) {
+			s2 = wa_prior.sigma * wa_prior.sigma;
+			g[0] -= (wa - wa_prior.value) / s2;
+			h[0] += 1 / s2;
+		}
+		if (dr_prior.isset) {
+			s2 = dr_prior.sigma * dr_prior.sigma;
+			g[1] -= (dr - dr_prior.value) / s2;
+			h[2] += 1 / s2;
+		}
+
+		det = h[0] * h[2] - h[1] * h[1];
+		if (!(h[0] > 0 && det > 0))
+			return FALSE;
+
+		sw = ( h[2] * g[0] - h[1] * g[1]) / det;
+		sd = (-h[1] * g[0] + h[0] * g[1]) / det;
+
+		// stay inside the limits, no draws at all pushes it towards zero
+		for (halved = 0; halved < 64 && (dr + sd <= 0 || dr + sd >= 1); halved++) {
+			sw /= 2;
+			sd /= 2;
+		}
+
+		if (absol(sw) < resol/10 && absol(sd) < MIN_DRAW_RATE_RESOLUTION) {
+			*pwadv = wa + sw;
+			*pdeq = dr + sd;
+			return TRUE;
+		}
+
+		for (halved = 0; halved < 32; halved++) {
+			unew = calc_bayes_unfitness_full (n_enc, enc, n_players, p, wa + sw, wa_prior, n_relative_anchors, ra, ratingof, dr + sd, dr_prior, beta);
+			if (unew <= u) 
+				break;
+			sw /= 2;
+			sd /= 2;
+		}
+		if (halved == 32 || !(-1000 < wa + sw && wa + sw < 1000))
+			return FALSE;
+
+		wa += sw;
+		dr += sd;
+		u = unew;
+	}
+
+	return FALSE;
+}
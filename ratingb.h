@@ -33,6 +33,9 @@ calc_rating_bayes
 			, bool_t 				adjust_white_advantage
 			, bool_t				adjust_draw_rate
 			, bool_t				anchor_use
+			, int					warm_start	// enum Warm_Start_Type
+			, int					cpus		// threads for the players with all wins or all losses
+			, struct ACTIVESTATS *	active_set	// NULL when the active set is not used
 
 			, double				beta
 			, double				general_average
@@ -42,7 +45,8 @@ calc_rating_bayes
 
 			, struct ENCOUNTERS *	encount
 			, struct PLAYERS *		plyrs
-			, struct GAMES *		g
+			, const struct ENCOUNTERS *full	// all the games, ENCOUNTERS_FULL
+			, gamesnum_t			n_games
 			, struct RATINGS *		rat
 
 			, struct prior *		pp
@@ -52,6 +56,7 @@ calc_rating_bayes
 
 			, double *				pwadv
 			, double *				pDraw_date
+			, bool_t *				pConverged
 )
 ;
 
@@ -47,7 +47,7 @@ static bool_t getnum(char *p, double *px)
 //====================== RELATIVE PRIORS ====================================================================
 
 void
-relpriors_shuffle (struct rel_prior_set *rps /*@out@*/)
+relpriors_shuffle (struct rel_prior_set *rps /*@out@*/, randstream_t *rs)
 {
 	player_t i;
 	double value, sigma;
@@ -60,7 +60,7 @@ relpriors_shuffle (struct rel_prior_set *rps /*@out@*/)
 	for (i = 0; i < n; i++) {
 		value = rp[i].delta;
 		sigma =	rp[i].sigma;	
-		rp[i].delta = rand_gauss (value, sigma);
+		rp[i].delta = rand_gauss (rs, value, sigma);
 	}
 }
 
@@ -333,7 +333,7 @@ priors_copy(const struct prior *p, player_t n, struct prior *q)
 }
 
 void
-priors_shuffle(struct prior *p, player_t n)
+priors_shuffle(struct prior *p, player_t n, randstream_t *rs)
 {
 	player_t i;
 	double value, sigma;
@@ -341,7 +341,7 @@ priors_shuffle(struct prior *p, player_t n)
 		if (p[i].isset) {
 			value = p[i].value;
 			sigma = p[i].sigma;
-			p[i].value = rand_gauss (value, sigma);
+			p[i].value = rand_gauss (rs, value, sigma);
 		}
 	}
 }
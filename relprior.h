@@ -23,8 +23,9 @@
 /*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
 
 #include "mytypes.h"
+#include "randfast.h"
 
-extern void		relpriors_shuffle	(struct rel_prior_set *rps /*@out@*/);
+extern void		relpriors_shuffle	(struct rel_prior_set *rps /*@out@*/, randstream_t *rs);
 extern void		relpriors_copy		(const struct rel_prior_set *r, struct rel_prior_set *s /*@out@*/);
 extern void 	relpriors_show		(const struct PLAYERS *plyrs, const struct rel_prior_set *rps);
 extern void 	relpriors_init 		( bool_t quietmode
@@ -54,7 +55,7 @@ extern void 	priors_load 	( bool_t quietmode
 								, struct prior *pr /*@out@*/);
 
 extern void 	priors_copy		(const struct prior *p, player_t n, struct prior *q);
-extern void 	priors_shuffle	(struct prior *p, player_t n);
+extern void 	priors_shuffle	(struct prior *p, player_t n, randstream_t *rs);
 extern void 	priors_show 	(const struct PLAYERS *plyrs, struct prior *p, player_t n);
 
 extern bool_t 	has_a_prior		(struct prior *pr, player_t j);
@@ -31,23 +31,11 @@
 #include "ordolim.h"
 #include "xpect.h"
 #include "mymem.h"
+#include "summations.h"
+#include "pairlist.h"
 
 #include "mytimer.h"
 
-//=== duplicated in main.c =========
-
-static ptrdiff_t
-head2head_idx_sdev (ptrdiff_t x, ptrdiff_t y)
-{	
-	ptrdiff_t idx;
-	if (y < x) 
-		idx = (x*x-x)/2+y;					
-	else
-		idx = (y*y-y)/2+x;
-	return idx;
-}
-
-//==================================
 
 static int
 compare__ (const player_t *a, const player_t *b, const double *reference )
@@ -256,7 +244,7 @@ cegt_output	( bool_t quiet
 			, long 					simulate
 			, double				confidence_factor
 			, const struct GAMESTATS *pgame_stats
-			, const struct DEVIATION_ACC *s
+			, const struct summations *s
 			, struct output_qualifiers outqual
 			, int decimals)
 {
@@ -400,7 +388,7 @@ head2head_output( const struct GAMES 	*		g
 				, long 							simulate
 				, double						confidence_factor
 				, const struct GAMESTATS *		pgame_stats
-				, const struct DEVIATION_ACC *	s
+				, const struct summations *		s
 				, const char *					head2head_str
 				, int 							decimals)
 {
@@ -453,23 +441,16 @@ is_empty_player(player_t j, const struct PLAYERS *pPlayers)
 }
 #endif
 
-static double
-get_cfs (const struct DEVIATION_ACC *sim, double dr, player_t target, player_t oth)
+static bool_t
+get_cfs (const struct summations *sim, double dr, player_t target, player_t oth, double *cfs)
 {
-	double ret;
-	if (sim != NULL) {
-		ptrdiff_t idx;
-		double ctrs;
-		double sd;
-		idx = head2head_idx_sdev ((ptrdiff_t)target, (ptrdiff_t)oth);
-		sd = sim[idx].sdev;
-		ctrs = 100*gauss_integral(dr/sd);
-		ret = ctrs;
-	}
-	else {
-		ret = 0;
+	const struct DEVIATION_ACC *pa = summations_pair (sim, target, oth);
+	if (pa != NULL) {
+		*cfs = 100*gauss_integral(dr/pa->sdev);
+	} else {
+		*cfs = 0; // pair not accumulated in the simulations
 	}
-	return ret;
+	return pa != NULL;
 }
 
 //=====================
@@ -800,7 +781,7 @@ all_report 	( const struct GAMES 			*g
 			, struct output_qualifiers		outqual
 			, double						wa_sdev				
 			, double						dr_sdev
-			, const struct DEVIATION_ACC *	s
+			, const struct summations *		s
 			, bool_t 						csf_column
 			, int							*inp_list
 			)
@@ -893,8 +874,7 @@ all_report 	( const struct GAMES 			*g
 				{		
 					player_t prev_j = q[x-1].j;	
 					double delta_rating = r->ratingof_results[prev_j] - r->ratingof_results[j];
-					q[x-1].cfs_value = get_cfs(s, delta_rating, prev_j, j);
-					q[x-1].cfs_is_ok = TRUE;
+					q[x-1].cfs_is_ok = get_cfs(s, delta_rating, prev_j, j, &q[x-1].cfs_value);
 				}
 
 				q[x].j = j;
@@ -1077,10 +1057,10 @@ list_remove_item (int *list, int x)
 }
 
 void
-errorsout(const struct PLAYERS *p, const struct RATINGS *r, const struct DEVIATION_ACC *s, const char *out, double confidence_factor)
+errorsout(const struct PLAYERS *p, const struct RATINGS *r, const struct summations *s, const char *out, double confidence_factor)
 {
 	FILE *f;
-	ptrdiff_t idx;
+	const struct DEVIATION_ACC *pa;
 	player_t y,x;
 	player_t i;
 	player_t j;
@@ -1100,8 +1080,10 @@ errorsout(const struct PLAYERS *p, const struct RATINGS *r, const struct DEVIATI
 			fprintf(f, "%ld,\"%21s\"", (long) i, p->name[y]);
 			for (j = 0; j < i; j++) {
 				x = r->sorted[j];
-				idx = head2head_idx_sdev ((ptrdiff_t)x, (ptrdiff_t)y);
-				fprintf(f,",%.1f", s[idx].sdev * confidence_factor);
+				if (NULL != (pa = summations_pair (s, x, y)))
+					fprintf(f,",%.1f", pa->sdev * confidence_factor);
+				else
+					fprintf(f,",");
 			}
 			fprintf(f, "\n");
 		}
@@ -1114,10 +1096,10 @@ errorsout(const struct PLAYERS *p, const struct RATINGS *r, const struct DEVIATI
 
 
 void
-ctsout(const struct PLAYERS *p, const struct RATINGS *r, const struct DEVIATION_ACC *s, const char *out)
+ctsout(const struct PLAYERS *p, const struct RATINGS *r, const struct summations *s, const char *out)
 {
 	FILE *f;
-	ptrdiff_t idx;
+	const struct DEVIATION_ACC *pa;
 	player_t y;
 	player_t x;
 	player_t i,j;
@@ -1141,10 +1123,9 @@ ctsout(const struct PLAYERS *p, const struct RATINGS *r, const struct DEVIATION_
 			for (j = 0; j < p->n; j++) {
 				double ctrs, sd, dr;
 				x = r->sorted[j];
-				if (x != y) {
+				if (x != y && NULL != (pa = summations_pair (s, x, y))) {
 					dr = r->ratingof_results[y] - r->ratingof_results[x];
-					idx = head2head_idx_sdev ((ptrdiff_t)x, (ptrdiff_t)y);
-					sd = s[idx].sdev;
+					sd = pa->sdev;
 					ctrs = 100*gauss_integral(dr/sd);
 					fprintf(f,",%.1f", ctrs);
 				} else {
@@ -1161,6 +1142,78 @@ ctsout(const struct PLAYERS *p, const struct RATINGS *r, const struct DEVIATION_
 }
 
 
+// players in the order they will be printed by all_report()
+static player_t
+output_order (const struct PLAYERS *p, const struct RATINGS *r, struct output_qualifiers outqual, player_t *order)
+{
+	player_t j, n;
+	for (n = 0, j = 0; j < p->n; j++) {
+		if (ok_to_out (j, outqual, p, r)) {
+			order[n++] = j;
+		}
+	}
+	if (n > 0)
+		my_qsort(r->ratingof_results, (size_t)n, order);
+	return n;
+}
+
+// pairs of players in consecutive rows of the output
+player_t
+report_adjacent_pairs	( const struct PLAYERS *p
+						, const struct RATINGS *r
+						, const struct rel_prior_set *rps
+						, bool_t hide_old_ver
+						, struct output_qualifiers outqual
+						, struct PAIRLIST *pl)
+{
+	player_t *order;
+	player_t i, j, n, prev, added;
+
+	if (NULL == (order = memnew (sizeof(player_t) * (size_t)(p->n + 1))))
+		fatal_mem("Not enough memory for the list of adjacent players");
+
+	n = output_order (p, r, outqual, order);
+
+	for (added = 0, prev = -1, i = 0; i < n; i++) {
+		j = order[i];
+		if (!is_old_version(j, rps) || !hide_old_ver) {
+			if (prev != -1) {
+				if (!pairlist_add (pl, prev, j))
+					fatal_mem("Not enough memory for the list of pairs");
+				added++;
+			}
+			prev = j;
+		}
+	}
+
+	memrel(order);
+	return added;
+}
+
+// top k players of the output, returns how many were stored in top
+player_t
+report_top_players		( const struct PLAYERS *p
+						, const struct RATINGS *r
+						, struct output_qualifiers outqual
+						, player_t k
+						, player_t *top)
+{
+	player_t *order;
+	player_t i, n;
+
+	if (NULL == (order = memnew (sizeof(player_t) * (size_t)(p->n + 1))))
+		fatal_mem("Not enough memory for the list of top players");
+
+	n = output_order (p, r, outqual, order);
+	if (n > k) n = k;
+	for (i = 0; i < n; i++)
+		top[i] = order[i];
+
+	memrel(order);
+	return n;
+}
+
+
 void
 look_at_individual_deviation 
 			( player_t 			n_players
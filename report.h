@@ -27,6 +27,8 @@
 #include <stdlib.h>
 #include "mytypes.h"
 
+struct PAIRLIST;
+
 #define MAX_prnt 15
 
 void 
@@ -39,7 +41,7 @@ cegt_output	( bool_t 				quiet
 			, long 					simulate
 			, double				confidence_factor
 			, const struct GAMESTATS *pgame_stats
-			, const struct DEVIATION_ACC *s
+			, const struct summations *s
 			, struct output_qualifiers outqual
 			, int decimals);
 
@@ -53,7 +55,7 @@ head2head_output( const struct GAMES 	*		g
 				, long 							simulate
 				, double						confidence_factor
 				, const struct GAMESTATS *		pgame_stats
-				, const struct DEVIATION_ACC *	s
+				, const struct summations *		s
 				, const char *					head2head_str
 				, int 							decimals);
 
@@ -77,7 +79,7 @@ all_report 	( const struct GAMES 	*g
 			, struct output_qualifiers	outqual
 			, double				wa_sdev				
 			, double				dr_sdev
-			, const struct DEVIATION_ACC *	s
+			, const struct summations *		s
 			, bool_t 				csf_column
 			, int					*inp_list
 			);
@@ -85,16 +87,31 @@ all_report 	( const struct GAMES 	*g
 void
 errorsout	( const struct PLAYERS *p
 			, const struct RATINGS *r
-			, const struct DEVIATION_ACC *s
+			, const struct summations *s
 			, const char *out
 			, double confidence_factor);
 
 void
 ctsout		( const struct PLAYERS *p
 			, const struct RATINGS *r
-			, const struct DEVIATION_ACC *s
+			, const struct summations *s
 			, const char *out);
 
+player_t
+report_adjacent_pairs	( const struct PLAYERS *p
+						, const struct RATINGS *r
+						, const struct rel_prior_set *rps
+						, bool_t hide_old_ver
+						, struct output_qualifiers outqual
+						, struct PAIRLIST *pl);
+
+player_t
+report_top_players		( const struct PLAYERS *p
+						, const struct RATINGS *r
+						, struct output_qualifiers outqual
+						, player_t k
+						, player_t *top);
+
 void
 look_at_predictions 
 			( gamesnum_t n_enc
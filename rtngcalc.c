@@ -36,6 +36,9 @@ calc_rating ( bool_t 					quiet
 			, bool_t 					adjust_drate
 			, bool_t					anchor_use
 			, bool_t					anchor_err_rel2avg
+			, int						warm_start	// enum Warm_Start_Type
+			, int						cpus		// threads for the players with all wins or all losses
+			, struct ACTIVESTATS *		active_set	// NULL when the active set is not used
 
 			, double					general_average
 			, player_t 					anchor
@@ -46,7 +49,8 @@ calc_rating ( bool_t 					quiet
 			, struct rel_prior_set *	rps
 			, struct PLAYERS *			plyrs
 			, struct RATINGS *			rat
-			, struct GAMES *			pGames
+			, const struct ENCOUNTERS *	full
+			, gamesnum_t				n_games
 
 			, struct prior *			pPrior
 			, struct prior 				wa_prior
@@ -54,10 +58,12 @@ calc_rating ( bool_t 					quiet
 
 			, double *					pWhite_advantage
 			, double *					pDraw_rate
+			, bool_t *					pConverged /*@out@*/
 )
 
 {
 	double dr = *pDraw_rate;
+	bool_t converged = FALSE;
 
 	gamesnum_t ret;
 
@@ -68,6 +74,9 @@ calc_rating ( bool_t 					quiet
 				, adjust_wadv
 				, adjust_drate
 				, anchor_use && !anchor_err_rel2avg
+				, warm_start
+				, cpus
+				, active_set
 
 				, beta
 				, general_average
@@ -77,7 +86,8 @@ calc_rating ( bool_t 					quiet
 
 				, encount
 				, plyrs
-				, pGames
+				, full
+				, n_games
 				, rat
 
 				, pPrior
@@ -87,6 +97,7 @@ calc_rating ( bool_t 					quiet
 
 				, pWhite_advantage
 				, &dr
+				, &converged
 				);
 
 	} else {
@@ -103,16 +114,21 @@ calc_rating ( bool_t 					quiet
 					, adjust_wadv
 					, adjust_drate
 					, anchor_use && !anchor_err_rel2avg
+					, warm_start
+					, cpus
+					, active_set
 					, ratingtmp_memory
 					, beta
 					, general_average
 					, anchor
 					, encount
 					, plyrs
-					, pGames
+					, full
+					, n_games
 					, rat
 					, pWhite_advantage
 					, &dr
+					, &converged
 					);
 
 			memrel(ratingtmp_memory);
@@ -124,6 +140,7 @@ calc_rating ( bool_t 					quiet
 	}
 
 	*pDraw_rate = dr;
+	if (pConverged) *pConverged = converged;
 
 	return ret;
 }
@@ -33,6 +33,9 @@ calc_rating ( bool_t 					quiet
 			, bool_t 					adjust_drate
 			, bool_t					anchor_use
 			, bool_t					anchor_err_rel2avg
+			, int						warm_start	// enum Warm_Start_Type
+			, int						cpus		// threads for the players with all wins or all losses
+			, struct ACTIVESTATS *		active_set	// NULL when the active set is not used
 
 			, double					general_average
 			, player_t 					anchor
@@ -43,7 +46,8 @@ calc_rating ( bool_t 					quiet
 			, struct rel_prior_set *	rps
 			, struct PLAYERS *			plyrs
 			, struct RATINGS *			rat
-			, struct GAMES *			pGames
+			, const struct ENCOUNTERS *	full		// all the games, ENCOUNTERS_FULL
+			, gamesnum_t				n_games
 
 			, struct prior *			pPrior
 			, struct prior 				wa_prior
@@ -51,6 +55,7 @@ calc_rating ( bool_t 					quiet
 
 			, double *					pWhite_advantage
 			, double *					pDraw_rate
+			, bool_t *					pConverged /*@out@*/
 )
 ;
 
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
 #include <assert.h>
 
 #include "sim.h"
@@ -41,21 +42,40 @@
 // Prototypes
 
 static void
-simulate_scores ( const double 	*ratingof_results
-				, double 		deq
-				, double 		wadv
-				, double 		beta
-				, struct GAMES *g	// output
+simulate_encounters	( const struct ENCOUNTERS *pairing
+					, const double 	*ratingof_results
+					, double 		deq
+					, double 		wadv
+					, double 		beta
+					, randstream_t *rs
+					, struct ENCOUNTERS *full	// output
 );
 
+static void
+resample_games (const struct ENCOUNTERS *pairing, randstream_t *rs, struct ENCOUNTERS *full /*@out@*/);
+
+static void
+resample_encounters (const struct ENCOUNTERS *pairing, randstream_t *rs, struct ENCOUNTERS *full /*@out@*/);
+
 static void
 ratings_set_to	( double general_average	
 				, const struct PLAYERS *pPlayers
 				, struct RATINGS *pRA /*@out@*/
 );
 
+static void
+ratings_set_to_results	( const struct PLAYERS *pPlayers
+						, struct RATINGS *pRA /*@out@*/
+);
+
 //----------------------------------------------------------------
 
+// runs rejected for not being well connected, see simul_smp()
+#define MAX_REJECTIONS 100
+static myatomic_t	Rejected_purged = 0;	// players with all wins, all losses or no games were purged
+static myatomic_t	Rejected_other = 0;
+static myatomic_t	Rejected_kept = 0;		// runs kept unchecked, after too many rejections
+
 void
 get_a_simulated_run	( int 					limit
 					, bool_t 				quiet_mode
@@ -66,46 +86,71 @@ get_a_simulated_run	( int 					limit
 					, const struct RATINGS 			*pRA
 					, const struct prior 			*PP_ori			
 					, const struct rel_prior_set	*pRPset_ori 	
+					, const struct ENCOUNTERS		*pairing		// games of the input, shared
+					, int							resample		// SIM_PARAMETRIC, or a bootstrap
 
+					, struct ENCOUNTERS 	*pFull 			// output, every simulated game
 					, struct ENCOUNTERS 	*pEncounters 	// output
 					, struct PLAYERS 		*pPlayers 		// output
-					, struct GAMES 			*pGames			// output
 					, struct prior 			*PP				// output
 					, struct rel_prior_set	*pRPset 		// output
+					, randstream_t			*rs				// random numbers for this run
+					, struct WELLCONN		*wc				// work buffer, one per thread
+					, gamesnum_t			*superwork		// work buffer, one per thread, 3 per player and zero
 )
 {
 	int failed_sim = 0;
+	bool_t purged;
 
 	relpriors_copy (pRPset_ori, pRPset); 		// reload original
 	priors_copy    (PP_ori, pPlayers->n, PP); 	// reload original
 
-	do {
-		if (!quiet_mode && failed_sim > 0) 
-			printf("--> Simulation: [Rejected]\n\n");
-
+	for (;;) {
 		players_flags_reset (pPlayers);
-		simulate_scores ( pRA->ratingof_results
-						, drawrate_evenmatch_result
-						, white_advantage_result
-						, beta
-						, pGames /*out*/);
+		if (resample == SIM_BOOTSTRAP_GAMES) {
+			resample_games (pairing, rs, pFull);
+		} else if (resample == SIM_BOOTSTRAP_ENC) {
+			resample_encounters (pairing, rs, pFull);
+		} else {
+			simulate_encounters	( pairing
+								, pRA->ratingof_results
+								, drawrate_evenmatch_result
+								, white_advantage_result
+								, beta
+								, rs
+								, pFull /*out*/);
+		}
 
 		relpriors_copy    (pRPset_ori, pRPset); 	// reload original
-		relpriors_shuffle (pRPset);					// simulate new
+		relpriors_shuffle (pRPset, rs);					// simulate new
 		priors_copy       (PP_ori, pPlayers->n, PP);// reload original
-		priors_shuffle    (PP, pPlayers->n);		// simulate new
+		priors_shuffle    (PP, pPlayers->n, rs);		// simulate new
 
 		assert(players_have_clear_flags(pPlayers));
 
-		encounters_calculate(ENCOUNTERS_FULL, pGames, pPlayers->flagged, pEncounters);
-
+		// flags are clear, so the simulated games are looked at directly,
+		// and selected only once
 		players_set_priored_info (PP, pRPset, pPlayers);
-		if (0 < players_set_super (quiet_mode, pEncounters, pPlayers)) {
+		purged = 0 < players_set_super_wdl (quiet_mode, pFull, pPlayers, superwork);
+		if (purged) {
 			players_purge (quiet_mode, pPlayers);
-			encounters_calculate(ENCOUNTERS_NOFLAGGED, pGames, pPlayers->flagged, pEncounters);
+			encounters_select(ENCOUNTERS_NOFLAGGED, pFull, pPlayers->flagged, pEncounters);
+		} else {
+			encounters_select(ENCOUNTERS_FULL, pFull, pPlayers->flagged, pEncounters);
+		}
+
+		if (failed_sim >= limit) {
+			mythread_atomic_add (&Rejected_kept, 1);
+			break;
 		}
+		if (wellconn_check (wc, pEncounters, pPlayers))
+			break;
 
-	} while (failed_sim++ < limit && !well_connected (pEncounters, pPlayers));
+		failed_sim++;
+		mythread_atomic_add (purged? &Rejected_purged: &Rejected_other, 1);
+		if (!quiet_mode) 
+			printf("--> Simulation: [Rejected]\n\n");
+	}
 
 	if (!quiet_mode) printf("--> Simulation: [Accepted]\n");
 }
@@ -113,12 +158,12 @@ get_a_simulated_run	( int 					limit
 /*=== simulation routines ==========================================*/
 
 static int
-rand_threeway_wscore(double pwin, double pdraw)
+rand_threeway_wscore(double pwin, double pdraw, randstream_t *rs)
 {	
 	long z,x,y;
 	z = (long)((unsigned)(pwin * (0xffff+1)));
 	x = (long)((unsigned)((pwin+pdraw) * (0xffff+1)));
-	y = randfast32() & 0xffff;
+	y = randstream32(rs) & 0xffff;
 
 	if (y < z) {
 		return WHITE_WIN;
@@ -131,31 +176,113 @@ rand_threeway_wscore(double pwin, double pdraw)
 
 
 // no globals
+// Games between the same white and black players have the same odds, 
+// so they are simulated together, directly in each encounter.
 static void
-simulate_scores ( const double 	*ratingof_results
-				, double 		deq
-				, double 		wadv
-				, double 		beta
-				, struct GAMES *g	// output
+simulate_encounters	( const struct ENCOUNTERS *pairing
+					, const double 	*ratingof_results
+					, double 		deq
+					, double 		wadv
+					, double 		beta
+					, randstream_t *rs
+					, struct ENCOUNTERS *full	// output
 )
 {
-	gamesnum_t n_games = g->n;
-	struct gamei *gam = g->ga;
-
-	gamesnum_t i;
+	const struct ENC *p = pairing->enc;
+	struct ENC *e = full->enc;
+	gamesnum_t i, k;
 	player_t w, b;
 	const double *rating = ratingof_results;
 	double pwin, pdraw, plos;
 	assert(deq <= 1 && deq >= 0);
+	assert(full->size >= pairing->n);
+
+	for (i = 0; i < pairing->n; i++) {
+		w = p[i].wh;
+		b = p[i].bl;
+		get_pWDL(rating[w] + wadv - rating[b], &pwin, &pdraw, &plos, deq, beta);
+		e[i].wh = w;
+		e[i].bl = b;
+		e[i].played = p[i].played;
+		e[i].W = e[i].D = e[i].L = 0;
+		for (k = 0; k < p[i].played; k++) {
+			switch (rand_threeway_wscore(pwin,pdraw,rs)) {
+				case WHITE_WIN: 	e[i].W++; break;
+				case RESULT_DRAW:	e[i].D++; break;
+				default:			e[i].L++; break;
+			}
+		}
+		e[i].wscore = (double)e[i].W + 0.5 * (double)e[i].D;
+	}
+	full->n = pairing->n;
+}
+
+// no globals
+// Non-parametric bootstrap of the games: as many games as the input has are
+// drawn with replacement from all of them. The games that fall in each
+// encounter follow a multinomial, drawn as a binomial of the games still to
+// draw for every encounter, given the games of the encounters left. The
+// wins, draws and losses in it are split with two more binomials. Every run
+// is O(encounters), no matter how many games there are.
+static void
+resample_games (const struct ENCOUNTERS *pairing, randstream_t *rs, struct ENCOUNTERS *full /*@out@*/)
+{
+	const struct ENC *p = pairing->enc;
+	struct ENC *e = full->enc;
+	gamesnum_t i, k, games, left, drawn, n = pairing->n;
+	assert(full->size >= pairing->n);
 
-	for (i = 0; i < n_games; i++) {
-		if (gam[i].score != DISCARD) {
-			w = gam[i].whiteplayer;
-			b = gam[i].blackplayer;
-			get_pWDL(rating[w] + wadv - rating[b], &pwin, &pdraw, &plos, deq, beta);
-			gam[i].score = rand_threeway_wscore(pwin,pdraw);
+	for (games = 0, i = 0; i < n; i++) {
+		games += p[i].played;
+	}
+	for (left = games, i = 0, k = 0; i < n && left > 0; i++) {
+		drawn = games <= p[i].played? left: rand_binomial (rs, left, (double)p[i].played / (double)games);
+		games -= p[i].played;
+		left -= drawn;
+		if (drawn == 0)
+			continue;
+		e[k] = p[i];
+		e[k].played = drawn;
+		e[k].W = rand_binomial (rs, drawn, (double)p[i].W / (double)p[i].played);
+		e[k].D = p[i].D + p[i].L == 0? 0: rand_binomial (rs, drawn - e[k].W, (double)p[i].D / (double)(p[i].D + p[i].L));
+		e[k].L = drawn - e[k].W - e[k].D;
+		e[k].wscore = (double)e[k].W + 0.5 * (double)e[k].D;
+		k++;
+	}
+	full->n = k;
+}
+
+// no globals
+// Non-parametric bootstrap of whole encounters: as many encounters as the
+// input has are drawn with replacement, and each one adds all its games
+// every time it is drawn (multinomial weights). Encounters never drawn are
+// left out. Every run is O(encounters), no matter how many games there are.
+static void
+resample_encounters (const struct ENCOUNTERS *pairing, randstream_t *rs, struct ENCOUNTERS *full /*@out@*/)
+{
+	const struct ENC *p = pairing->enc;
+	struct ENC *e = full->enc;
+	gamesnum_t i, k, n = pairing->n;
+	assert(full->size >= pairing->n);
+
+	for (i = 0; i < n; i++) {
+		e[i] = p[i];
+		e[i].played = e[i].W = e[i].D = e[i].L = 0;
+	}
+	for (k = 0; k < n; k++) {
+		i = (gamesnum_t)(((uint64_t)randstream32(rs) * (uint64_t)n) >> 32);
+		e[i].played += p[i].played;
+		e[i].W += p[i].W;
+		e[i].D += p[i].D;
+		e[i].L += p[i].L;
+	}
+	for (i = 0, k = 0; i < n; i++) {
+		if (e[i].played > 0) {
+			e[i].wscore = (double)e[i].W + 0.5 * (double)e[i].D;
+			e[k++] = e[i];
 		}
 	}
+	full->n = k;
 }
 
 /*==================================================================*/
@@ -165,9 +292,9 @@ simulate_scores ( const double 	*ratingof_results
 static const char *Result_string[4] = {"1-0","1/2-1/2","0-1","*"};
 
 void
-save_simulated(struct PLAYERS *pPlayers, struct GAMES *pGames, int num)
+save_simulated(struct PLAYERS *pPlayers, const struct ENCOUNTERS *pFull, int num)
 {
-	gamesnum_t i;
+	gamesnum_t i, k;
 	const char *name_w;
 	const char *name_b;
 	const char *result;
@@ -180,22 +307,20 @@ save_simulated(struct PLAYERS *pPlayers, struct GAMES *pGames, int num)
 
 	if (NULL != (fout = fopen (filename, "w"))) {
 
-		for (i = 0; i < pGames->n; i++) {
+		for (i = 0; i < pFull->n; i++) {
 
-			int32_t score_i = pGames->ga[i].score;
-			player_t wp_i = pGames->ga[i].whiteplayer;
-			player_t bp_i = pGames->ga[i].blackplayer;
+			const struct ENC *e = &pFull->enc[i];
 
-			if (score_i == DISCARD) continue;
-	
-			name_w = pPlayers->name [wp_i];
-			name_b = pPlayers->name [bp_i];		
-			result = Result_string[score_i];
+			name_w = pPlayers->name [e->wh];
+			name_b = pPlayers->name [e->bl];		
 
-			fprintf(fout,"[White \"%s\"]\n",name_w);
-			fprintf(fout,"[Black \"%s\"]\n",name_b);
-			fprintf(fout,"[Result \"%s\"]\n",result);
-			fprintf(fout,"%s\n\n",result);
+			for (k = 0; k < e->played; k++) {
+				result = Result_string[k < e->W? WHITE_WIN: (k < e->W + e->D? RESULT_DRAW: BLACK_WIN)];
+				fprintf(fout,"[White \"%s\"]\n",name_w);
+				fprintf(fout,"[Black \"%s\"]\n",name_b);
+				fprintf(fout,"[Result \"%s\"]\n",result);
+				fprintf(fout,"%s\n\n",result);
+			}
 		}
 
 		fclose(fout);
@@ -205,49 +330,282 @@ save_simulated(struct PLAYERS *pPlayers, struct GAMES *pGames, int num)
 //========================================================================
 #include "sysport.h"
 
-mythread_mutex_t Smpcount;
-mythread_mutex_t Groupmtx;
 mythread_mutex_t Summamtx;
 mythread_mutex_t Printmtx;
 
-static long Sim_N = 0;
+/*
+|	Runs are claimed with an atomic counter, in batches that get smaller
+|	as the end approaches, so the threads finish at about the same time.
+|	With a deadline, no batch is claimed after it, and the runs done are
+|	all the ones before the counter.
+*/
+
+#define MAX_RUNBATCH 16
+
+static myatomic_t	Sim_next = 0;	// next run to be claimed
+static myatomic_t	Sim_stop = 0;	// deadline reached
+static long			Sim_total = 0;
+static int			Sim_threads = 1;
+static time_t		Sim_deadline = 0;	// none if 0
+
+struct RUNBATCH {
+	long	next;
+	long	last;
+};
+
+static void
+runs_set (long from, long simulate, int threads, time_t deadline)
+{
+	Sim_total = simulate;
+	Sim_threads = threads;
+	Sim_deadline = deadline;
+	mythread_atomic_set (&Sim_next, from);
+	mythread_atomic_set (&Sim_stop, 0);
+}
+
+// runs done once the threads are joined
+static long
+runs_done (void)
+{
+	long next = mythread_atomic_get (&Sim_next);
+	return next < Sim_total? next: Sim_total;
+}
 
 static bool_t
-smpcount_get (long *x)
+runs_claim (struct RUNBATCH *b)
 {
-	bool_t ok;
-	mythread_mutex_lock (&Smpcount);
-	if (Sim_N > 0) {
-		*x = Sim_N--;
-		ok = TRUE;
-	} else {
-		*x = 0;
-		ok = FALSE;
+	long left = Sim_total - mythread_atomic_get (&Sim_next);
+	long size = left / (4 * (long)Sim_threads);
+	long first;
+
+	if (mythread_atomic_get (&Sim_stop))
+		return FALSE;
+	if (Sim_deadline != 0 && time(NULL) >= Sim_deadline) {
+		mythread_atomic_set (&Sim_stop, 1);
+		return FALSE;
+	}
+
+	if (size < 1) size = 1;
+	if (size > MAX_RUNBATCH) size = MAX_RUNBATCH;
+
+	first = mythread_atomic_add (&Sim_next, size);
+	if (first >= Sim_total) 
+		return FALSE;
+	b->next = first;
+	b->last = first + size < Sim_total? first + size: Sim_total;
+	return TRUE;
+}
+
+static bool_t
+runs_next (struct RUNBATCH *b, long *z)
+{
+	if (b->next >= b->last && !runs_claim (b)) 
+		return FALSE;
+	*z = b->next++;
+	return TRUE;
+}
+
+//========================================================================
+#include "mymem.h"
+#include "summations.h"
+#include "simfile.h"
+#include "simckpt.h"
+#include "covar.h"
+
+/*
+|	Simulated runs are added to the summations in order, so the errors are
+|	the same regardless of the number of threads. The accumulators are
+|	split in blocks, each one with its own lock and next run to add.
+|	A thread that finishes a run leaves a copy in "Pending" and then adds
+|	to every block all the runs that are ready, so different threads can
+|	update different blocks at the same time. A run is released when all
+|	the blocks have it. White advantage and draw rate go with block 0.
+|	A shard only adds its own runs, from Pending_first on.
+*/
+
+#define MAX_SUMMABLOCKS 256
+
+struct PENDINGRUN {
+	double *	ratingof;
+	double *	lin;		// control variates, after the ratings in the same memory, or NULL
+	double		wadv;
+	double		drate;
+	int			blocks_left;
+};
+
+struct SUMMABLOCK {
+	mythread_mutex_t	mtx;
+	long				next;	// next run to be added
+};
+
+static struct PENDINGRUN *	Pending = NULL;	// Pending[0] is run Pending_first
+static long 				Pending_first = 0;
+static long 				Pending_n = 0;
+static struct SUMMABLOCK	Summablock[MAX_SUMMABLOCKS];
+static int					Summablock_n = 0;
+static FILE *				Samplef = NULL;		// runs are saved in order with block 0
+
+static bool_t
+pending_init (long first, long last, int cpus, long done)
+{
+	long z;
+	int k, nb;
+
+	if (NULL == (Pending = memnew (sizeof(struct PENDINGRUN) * (size_t)(last - first))))
+		return FALSE;
+	for (z = 0; z < last - first; z++) {
+		Pending[z].ratingof = NULL;
+	}
+	Pending_first = first;
+	Pending_n = last - first;
+
+	// a few blocks per thread
+	nb = cpus > 1? 4 * cpus: 1;
+	if (nb > MAX_SUMMABLOCKS) nb = MAX_SUMMABLOCKS;
+
+	for (k = 0; k < nb; k++) {
+		Summablock[k].next = done;
+		mythread_mutex_init (&Summablock[k].mtx);
+	}
+	Summablock_n = nb;
+
+	return TRUE;
+}
+
+static void
+pending_done (void)
+{
+	long z;
+	int k;
+	for (z = 0; z < Pending_n; z++) {
+		assert (Pending[z].ratingof == NULL);
+		if (Pending[z].ratingof) memrel(Pending[z].ratingof);
+	}
+	memrel(Pending);
+	Pending = NULL;
+	Pending_n = 0;
+	for (k = 0; k < Summablock_n; k++) {
+		mythread_mutex_destroy (&Summablock[k].mtx);
+	}
+	Summablock_n = 0;
+}
+
+static void
+summablock_flush (int k, struct summations *sfe)
+{
+	struct SUMMABLOCK *b = &Summablock[k];
+	struct PENDINGRUN *p;
+	double *r, *lin;
+
+	mythread_mutex_lock (&b->mtx);
+	while (b->next < Pending_first + Pending_n) {
+
+		p = &Pending[b->next - Pending_first];
+
+		mythread_mutex_lock (&Summamtx);
+		r = p->ratingof;
+		lin = p->lin;
+		mythread_mutex_unlock (&Summamtx);
+
+		if (r == NULL) break; // not ready
+
+		summations_update_block (sfe, k, Summablock_n, r, lin, (double)(b->next - Pending_first + 1));
+		if (k == 0) {
+			summations_update_wadr (sfe, p->wadv, p->drate);
+			if (Samplef && !simfile_append (Samplef, sfe->nplayers, r, p->wadv, p->drate)) {
+				fprintf(stderr, "Problems writing the file of simulated runs\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		b->next++;
+
+		mythread_mutex_lock (&Summamtx);
+		if (--p->blocks_left == 0) {
+			p->ratingof = NULL;
+		} else {
+			r = NULL;
+		}
+		mythread_mutex_unlock (&Summamtx);
+
+		if (r) memrel(r);
 	}
-	mythread_mutex_unlock (&Smpcount);
-	return ok;
+	mythread_mutex_unlock (&b->mtx);
 }
 
 static void
-smpcount_set (long x)
+pending_add (long z, struct summations *sfe, player_t topn, const double *ratingof, const double *lin, double wadv, double drate)
 {
-	mythread_mutex_lock (&Smpcount);
-	Sim_N = x;
-	mythread_mutex_unlock (&Smpcount);
+	struct PENDINGRUN *p;
+	player_t j;
+	double *r;
+	int k;
+
+	if (NULL == (r = memnew (sizeof(double) * (size_t)topn * (lin? 2: 1)))) {
+		fprintf(stderr, "Not enough memory to store a simulated run\n");
+		exit(EXIT_FAILURE);
+	}
+	for (j = 0; j < topn; j++) r[j] = ratingof[j];
+	if (lin) {
+		for (j = 0; j < topn; j++) r[topn+j] = lin[j];
+	}
+
+	mythread_mutex_lock (&Summamtx);
+	p = &Pending[z - Pending_first];
+	p->wadv 		= wadv;
+	p->drate 		= drate;
+	p->blocks_left 	= Summablock_n;
+	p->lin			= lin? r + topn: NULL;
+	p->ratingof 	= r;
+	mythread_mutex_unlock (&Summamtx);
+
+	// each run starts at a different block to spread the threads
+	for (k = 0; k < Summablock_n; k++) {
+		summablock_flush ((int)((z + k) % Summablock_n), sfe);
+	}
 }
 
 //========================================================================
 
+/*
+|	With a target, it is checked after a given number of runs: 100, 200,
+|	and then every 25% more. These points do not depend on the threads or
+|	on the checkpoints, so neither does the number of runs done.
+*/
+
+#define TARGET_FIRST 100
+
+// next point to check after done runs, or last
+static long
+target_next (long done, long last)
+{
+	long c = TARGET_FIRST;
+	while (c <= done) {
+		c += c / 4 > TARGET_FIRST? c / 4: TARGET_FIRST;
+	}
+	return c < last? c: last;
+}
+
+static bool_t
+target_reached (const struct SIMTARGET *target, const struct summations *sfe, long done)
+{
+	double se;
+	if (target == NULL || done < 2 || target_next (done - 1, done + 1) != done)
+		return FALSE;
+	se = target->factor * summations_sdev_stderr (sfe, target->watch, target->watch_n, (double)done);
+	return se <= target->precision;
+}
 
 struct SIMSMP {
 	  long							simulate
-	; bool_t 						sim_updates
 	; bool_t 						quiet_mode
 	; bool_t						prior_mode
 	; bool_t 						adjust_white_advantage
 	; bool_t 						adjust_draw_rate
 	; bool_t						anchor_use
 	; bool_t						anchor_err_rel2avg
+	; bool_t						sim_warm
+	; bool_t						active_set
+	; int							resample
 
 	; double						general_average
 	; player_t 						anchor
@@ -261,21 +619,26 @@ struct SIMSMP {
 	; struct prior 					wa_prior
 	; struct prior 					dr_prior
 
-	; struct ENCOUNTERS	*			encount				// io, modified
+	; const struct ENCOUNTERS *		pairing				// input, shared by all threads
+	; gamesnum_t					n_games
 	; struct PLAYERS *				plyrs				// io, modified
 	; struct RATINGS *				rat					// io, modified
-	; struct GAMES *				pGames				// io, modified
 
 	; struct rel_prior_set 			RPset_work			// mem provided
 	; struct prior *				PP_work				// mem provided
+	; const struct COVLIN *			covlin				// control variates, or NULL
 
 	; struct summations *			p_sfe_io 			// output
 	;
 };
 
+struct SIMTHREAD {
+	struct SIMSMP *		s;
+	myatomic_t *		progress;	// runs done by this thread
+};
+
 //========================================================================
 
-#include "summations.h"
 #include "rtngcalc.h"
 
 static void
@@ -291,6 +654,23 @@ ratings_set_to	( double general_average
 	assert(ratings_sanity (pPlayers->n, pRA->ratingbk));
 }
 
+// Simulated runs are perturbations of the original, which is a good starting point
+static void
+ratings_set_to_results	( const struct PLAYERS *pPlayers
+						, struct RATINGS *pRA /*@out@*/
+)
+{
+	player_t j;
+	for (j = 0; j < pPlayers->n; j++) {
+		if (!pPlayers->prefed[j] && !pPlayers->flagged[j]) {
+			pRA->ratingof[j] = pRA->ratingof_results[j];
+			pRA->ratingbk[j] = pRA->ratingof_results[j];
+		}
+	}
+	assert(ratings_sanity (pPlayers->n, pRA->ratingof));
+	assert(ratings_sanity (pPlayers->n, pRA->ratingbk));
+}
+
 static void
 updates_print_scale (bool_t sim_updates)
 {
@@ -309,62 +689,100 @@ updates_print_head (bool_t quiet, long z, long simulate)
 	mythread_mutex_unlock (&Printmtx);
 }
 
-static	double 					Fraction = 0.0;
-static	double 					Asterisk = 1;
-static	int 					Astcount = 0;
+/*
+|	Each thread counts its own runs. A reporter thread adds the counters
+|	from time to time and prints the progress bar, so the threads doing
+|	the simulations never wait for it.
+*/
 
-static void
-updates_print_progress (bool_t sim_updates)
-{
-	double fraction;
-	int astcount;
+struct PROGRESS {
+	myatomic_t	done;
+	char		pad[64 - sizeof(myatomic_t)];	// one cache line per thread
+};
 
-	mythread_mutex_lock (&Printmtx);
+struct REPORTER {
+	long				simulate;
+	long				start;		// runs done before
+	int					n;
+	struct PROGRESS *	progress;
+	myatomic_t			stop;
+	int					astcount;
+};
 
-	fraction = Fraction;
-	astcount = Astcount;
-	if (sim_updates) {
-		fraction += 1.0;
-		while (fraction > Asterisk) {
-			fraction -= Asterisk;
-			astcount++;
-			printf ("*"); 
+static thread_return_t THREAD_CALL
+updates_reporter (void *p)
+{
+	struct REPORTER *r = p;
+	long done, stop;
+	int t, target;
+
+	for (stop = 0; !stop; ) {
+		stop = mythread_atomic_get (&r->stop);
+		for (done = r->start, t = 0; t < r->n; t++) {
+			done += mythread_atomic_get (&r->progress[t].done);
+		}
+		target = (int)(50 * done / r->simulate);
+		while (r->astcount < target) {
+			printf ("*");
+			r->astcount++;
 		}
 		fflush(stdout);
+		if (!stop) mythread_sleep_ms (100);
 	}
-	Fraction = fraction;
-	Astcount = astcount;
-
-	mythread_mutex_unlock (&Printmtx);
 
-	return;
+	mythread_exit ();
+	return (thread_return_t) 0;
 }
 
 static void
-updates_print_reachedgoal (bool_t sim_updates)
+updates_print_reachedgoal (bool_t sim_updates, int astcount)
 {
-	int astcount;
-	mythread_mutex_lock (&Printmtx);
-	astcount = Astcount;
 	if (sim_updates) {
 		int x = 51-astcount;
 		while (x-->0) {printf ("*"); fflush(stdout);}
 		printf ("\n");
 	}
-	mythread_mutex_unlock (&Printmtx);
+}
+
+static void
+rejections_reset (void)
+{
+	mythread_atomic_set (&Rejected_purged, 0);
+	mythread_atomic_set (&Rejected_other, 0);
+	mythread_atomic_set (&Rejected_kept, 0);
+}
+
+// only if there were any
+static void
+rejections_print (void)
+{
+	long purged = mythread_atomic_get (&Rejected_purged);
+	long other  = mythread_atomic_get (&Rejected_other);
+	long kept   = mythread_atomic_get (&Rejected_kept);
+
+	if (purged + other > 0) {
+		printf ("\nSimulated runs rejected, not well connected = %ld\n", purged + other);
+		printf (" - with all-wins/all-losses players purged  = %ld\n", purged);
+		printf (" - without                                  = %ld\n", other);
+	}
+	if (kept > 0) {
+		printf ("Simulated runs kept after %d rejections     = %ld\n", MAX_REJECTIONS, kept);
+	}
 }
 
 
 void
 simul
 	( long 							simulate
-	, bool_t 						sim_updates
 	, bool_t 						quiet_mode
 	, bool_t						prior_mode
 	, bool_t 						adjust_white_advantage
 	, bool_t 						adjust_draw_rate
 	, bool_t						anchor_use
 	, bool_t						anchor_err_rel2avg
+	, bool_t						sim_warm
+	, bool_t						active_set			// --active-set in every run
+	, int							resample			// SIM_PARAMETRIC, or a bootstrap
 
 	, double						general_average
 	, player_t 						anchor
@@ -378,15 +796,19 @@ simul
 	, struct prior 					wa_prior
 	, struct prior 					dr_prior
 
-	, struct ENCOUNTERS	*			encount				// io, modified
+	, const struct ENCOUNTERS *		pairing				// input, shared by all threads
+	, gamesnum_t					n_games
+	, struct ENCOUNTERS	*			encount				// mem provided
+	, struct ENCOUNTERS	*			full				// mem provided
 	, struct PLAYERS *				plyrs				// io, modified
 	, struct RATINGS *				rat					// io, modified
-	, struct GAMES *				pGames				// io, modified
 
 	, struct rel_prior_set 			RPset_work			// mem provided
 	, struct prior *				PP_work				// mem provided
+	, const struct COVLIN *			covlin				// input, control variates, or NULL
 
 	, struct summations *			p_sfe_io 			// output
+	, myatomic_t *					progress			// output, runs done by this thread
 )
 {
 	double 					white_advantage = white_advantage_result;
@@ -395,44 +817,65 @@ simul
 	struct summations 		*sfe = p_sfe_io; 	// summations for errors
 
 	struct ENCOUNTERS		Encounters = *encount;
+	struct ENCOUNTERS		Full = *full;
 	struct rel_prior_set 	RPset = *rps;
 	struct PLAYERS 			Players = *plyrs;
 	struct RATINGS 			RA = *rat;
-	struct GAMES 			Games = *pGames;
 
 	const struct prior *	PP = pPrior;
 
-	long 					zz;
+	long 					z;
+	struct RUNBATCH			batch = {0, 0};
 	ptrdiff_t 				topn = (ptrdiff_t)Players.n;
+	bool_t					converged;
+	bool_t					warm;
+	struct ACTIVESTATS		activestats = {0, 0, 0};	// not reported, the runs only need the mode
+	randstream_t			rs;
+	struct WELLCONN			wc;		// connectivity of this thread, reused in every run
+	gamesnum_t *			superwork;	// detection of players with all wins or all losses, same
+	size_t					k;
+	double *				lin = NULL;		// control variates of the run
+	double *				linwork = NULL;
 
 	assert (simulate > 1);
 	if (simulate <= 1) return;
 
+	if (!wellconn_init (&wc, Players.n, pairing->n)) {
+		fprintf (stderr, "not enough memory for encounters allocation\n");
+		exit(EXIT_FAILURE);
+	}
+	if (NULL == (superwork = memnew (sizeof(gamesnum_t) * 3 * (size_t)(Players.n + 1)))) {
+		fprintf (stderr, "not enough memory for encounters allocation\n");
+		exit(EXIT_FAILURE);
+	}
+	for (k = 0; k < 3 * (size_t)Players.n; k++) superwork[k] = 0;
+	if (covlin) {
+		lin 	= memnew (sizeof(double) * (size_t)(Players.n + 1));
+		linwork = memnew (sizeof(double) * (size_t)(covlin->work_n + 1));
+		if (NULL == lin || NULL == linwork) {
+			fprintf (stderr, "not enough memory for the control variates\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	/* Simulation block, begin */
 
-	while (smpcount_get(&zz)) {
+	while (runs_next (&batch, &z)) {
 
-		long z = simulate-zz;
+		updates_print_head (quiet_mode, z, simulate);
 
-		if (z == 0) {
-			// original run
-			// should be done only once by only one thread, that is why z == 0
-			mythread_mutex_lock (&Summamtx);
-			sfe->wa_sum1 += white_advantage_result;
-			sfe->wa_sum2 += white_advantage_result * white_advantage_result;				
-			sfe->dr_sum1 += drawrate_evenmatch_result;
-			sfe->dr_sum2 += drawrate_evenmatch_result * drawrate_evenmatch_result;
-			mythread_mutex_unlock (&Summamtx);
-		}
+		// every run has its own stream, results do not depend on the thread doing it
+		randstream_init (&rs, (uint32_t)z);
 
-		updates_print_head (quiet_mode, z, simulate);
+		// nor on the run done before by this thread
+		white_advantage = white_advantage_result;
+		drawrate_evenmatch = drawrate_evenmatch_result;
 
 		// store originals
 		relpriors_copy (&RPset, &RPset_work); 
 		priors_copy (PP, Players.n, PP_work);
 
-		mythread_mutex_lock (&Groupmtx);
-		get_a_simulated_run	( 100
+		get_a_simulated_run	( MAX_REJECTIONS
 							, quiet_mode
 							, beta
 							, drawrate_evenmatch_result
@@ -440,49 +883,76 @@ simul
 							, &RA	
 							, PP			
 							, &RPset		
+							, pairing
+							, resample
+							, &Full			// output
 							, &Encounters 	// output
 							, &Players		// output
-							, &Games		// output
 							, PP_work		// output
 							, &RPset_work 	// output
+							, &rs
+							, &wc
+							, superwork
 							);
-		mythread_mutex_unlock (&Groupmtx);
+
+		if (covlin) {
+			covlin_predict (covlin, &Full, PP, PP_work, &RPset, &RPset_work, linwork, lin);
+		}
 
 		#if defined(SAVE_SIMULATION)
 		if (z+1 == SAVE_SIMULATION_N) {
-			save_simulated(&Players, &Games, (int)(z+1)); 
+			save_simulated(&Players, &Full, (int)(z+1)); 
 		}
 		#endif
 
-		// may improve convergence in pathological cases, it should not be needed.
-		ratings_set_to (general_average, &Players, &RA);
+		for (warm = sim_warm; ; warm = FALSE) {
 
-		Encounters.n = calc_rating 
-						( quiet_mode
-						, prior_mode 
-						, adjust_white_advantage
-						, adjust_draw_rate
-						, anchor_use
-						, anchor_err_rel2avg
+			if (warm) {
+				ratings_set_to_results (&Players, &RA);
+			} else {
+				// may improve convergence in pathological cases, it should not be needed.
+				ratings_set_to (general_average, &Players, &RA);
+			}
 
-						, general_average
-						, anchor
-						, priored_n
-						, beta
+			Encounters.n = calc_rating 
+							( quiet_mode
+							, prior_mode 
+							, adjust_white_advantage
+							, adjust_draw_rate
+							, anchor_use
+							, anchor_err_rel2avg
+							, warm? WARM_RESULTS: WARM_NONE
+							, 1		// runs are already spread over the threads
+							, active_set? &activestats: NULL
+
+							, general_average
+							, anchor
+							, priored_n
+							, beta
+
+							, &Encounters
+							, &RPset_work
+							, &Players
+							, &RA
+							, &Full
+							, n_games
+
+							, PP_work
+							, wa_prior
+							, dr_prior
 
-						, &Encounters
-						, &RPset_work
-						, &Players
-						, &RA
-						, &Games
+							, &white_advantage
+							, &drawrate_evenmatch
+							, &converged
+							);
 
-						, PP_work
-						, wa_prior
-						, dr_prior
+			if (converged || !warm)
+				break;
 
-						, &white_advantage
-						, &drawrate_evenmatch
-						);
+			// fall back to a cold start
+			white_advantage = white_advantage_result;
+			drawrate_evenmatch = drawrate_evenmatch_result;
+		}
 
 		ratings_cleared_for_purged (&Players, &RA);
 
@@ -492,18 +962,21 @@ simul
 		}
 
 		// update summations for errors
-		mythread_mutex_lock (&Summamtx);
-		summations_update (sfe, topn, RA.ratingof, white_advantage, drawrate_evenmatch);
-		mythread_mutex_unlock (&Summamtx);
+		pending_add (z, sfe, (player_t)topn, RA.ratingof, lin, white_advantage, drawrate_evenmatch);
 
 		if (anchor_err_rel2avg) {
 			ratings_copy (Players.n, RA.ratingbk, RA.ratingof); // ** restore
 		}
 
-		updates_print_progress (sim_updates);
+		mythread_atomic_add (progress, 1);
 
 	} // for loop end
 
+	if (linwork) memrel (linwork);
+	if (lin) memrel (lin);
+	memrel (superwork);
+	wellconn_done (&wc);
+
 } /* Simulation function, end */
 
 
@@ -513,7 +986,8 @@ simul_smp_process (void *p);
 
 #include "inidone.h"
 
-void
+// returns the runs done, fewer than simulate if the target is reached before
+long
 simul_smp
 	( int							cpus
 	, long 							simulate
@@ -524,6 +998,9 @@ simul_smp
 	, bool_t 						adjust_draw_rate
 	, bool_t						anchor_use
 	, bool_t						anchor_err_rel2avg
+	, bool_t						sim_warm
+	, bool_t						active_set			// --active-set in every run
+	, int							resample			// SIM_PARAMETRIC, or a bootstrap
 
 	, double						general_average
 	, player_t 						anchor
@@ -537,32 +1014,39 @@ simul_smp
 	, struct prior 					wa_prior
 	, struct prior 					dr_prior
 
-	, struct ENCOUNTERS	*			encount				// io, modified
+	, const struct ENCOUNTERS *		pairing				// input, every game
+	, gamesnum_t					n_games
 	, struct PLAYERS *				plyrs				// io, modified
 	, struct RATINGS *				rat					// io, modified
-	, struct GAMES *				pGames				// io, modified
 
 	, struct rel_prior_set 			RPset_work			// mem provided
 	, struct prior *				PP_work				// mem provided
 
 	, struct summations *			p_sfe_io 			// output
+	, FILE *						samplef				// output
+	, struct SIMCKPT *				ckpt				// io, checkpoint or NULL
+	, const struct SIMTARGET *		target				// input, or NULL
+	, const struct COVLIN *			covlin				// input, or NULL
 )
 {
 	struct SIMSMP s;
-	void *pdata;
+	long first, last, start, done;
+	bool_t report = !quiet_mode || sim_updates;
 
-	if (cpus < 1) return;
+	if (cpus < 1) return 0;
 
 	if (cpus > 1 && !quiet_mode) {quiet_mode = TRUE; sim_updates = TRUE;}
 
 	s.simulate					= simulate						;
-	s.sim_updates				= sim_updates					;
 	s.quiet_mode				= quiet_mode					;
 	s.prior_mode				= prior_mode					;
 	s.adjust_white_advantage	= adjust_white_advantage		;
 	s.adjust_draw_rate			= adjust_draw_rate				;
 	s.anchor_use				= anchor_use					;
 	s.anchor_err_rel2avg		= anchor_err_rel2avg			;
+	s.sim_warm					= sim_warm						;
+	s.active_set				= active_set					;
+	s.resample					= resample						;
 	s.general_average			= general_average				;
 	s.anchor					= anchor						;
 	s.priored_n					= priored_n						;
@@ -574,61 +1058,132 @@ simul_smp
 	s.wa_prior					= wa_prior						;
 	s.dr_prior					= dr_prior						;
 
-	s.encount					= encount						;
+	s.pairing					= pairing						;
+	s.n_games					= n_games						;
 	s.plyrs						= plyrs						;
 	s.rat						= rat							;
-	s.pGames					= pGames						;
 	s.RPset_work				= RPset_work					;
 	s.PP_work					= PP_work						;
+	s.covlin					= covlin						;
 
 	s.p_sfe_io 					= p_sfe_io						;
 
-	pdata = &s; // convert to a void pointer, needed for the SMP call
+	Samplef = samplef;
+
+	// all the runs, or those of a shard
+	first = ckpt? ckpt->first: 0;
+	last  = ckpt? ckpt->last: simulate;
+	start = ckpt? ckpt->done: 0;
+	assert (0 <= first && first <= start && start <= last && last <= simulate);
 
-	if(!summations_calloc(s.p_sfe_io, s.plyrs->n)) {
+	rejections_reset();
+	if(!pending_init(first, last, cpus, start)) {
 		fprintf(stderr, "Memory for simulations could not be allocated\n");
 		exit(EXIT_FAILURE);
 	}
 
-	{
-		#define MAX_CPUS 64
+	// the original run is the first sample of white advantage and draw rate, unless resumed
+	if (first == 0 && s.p_sfe_io->wadr_n < 1)
+		summations_update_wadr (s.p_sfe_io, white_advantage_result, drawrate_evenmatch_result);
 
-		int CPUS = cpus > MAX_CPUS? MAX_CPUS: cpus;
+	{
+		int CPUS = cpus;
 		int t;
-		static bool_t		iret     [MAX_CPUS];
-		static mythread_t 	threadid [MAX_CPUS];
-		static int			err		 [MAX_CPUS];
+		bool_t *			iret;
+		mythread_t *		threadid;
+		int *				err;
+		struct SIMTHREAD *	arg;
+		struct REPORTER		reporter;
+		mythread_t			reporter_id;
+		int					reporter_err;
+		bool_t				reporter_ok = FALSE;
+
+		iret 		= memnew (sizeof(bool_t) * (size_t)CPUS);
+		threadid 	= memnew (sizeof(mythread_t) * (size_t)CPUS);
+		err 		= memnew (sizeof(int) * (size_t)CPUS);
+		arg 		= memnew (sizeof(struct SIMTHREAD) * (size_t)CPUS);
+		reporter.progress = memnew (sizeof(struct PROGRESS) * (size_t)CPUS);
+		if (!iret || !threadid || !err || !arg || !reporter.progress) {
+			fprintf(stderr, "Memory for %d threads could not be allocated\n", CPUS);
+			exit(EXIT_FAILURE);
+		}
+
+		reporter.simulate = last - first;
+		reporter.start = start - first;
+		reporter.n = CPUS;
+		reporter.astcount = 0;
+		mythread_atomic_set (&reporter.stop, 0);
+		for (t = 0; t < CPUS; t++) {
+			mythread_atomic_set (&reporter.progress[t].done, 0);
+			arg[t].s = &s;
+			arg[t].progress = &reporter.progress[t].done;
+		}
 
-		smpcount_set(simulate);
 		updates_print_scale (sim_updates);
-		Asterisk = (double)simulate/50.0;
 
-		/* Create independent threads each of which will execute function */
-		for (t = 0; t < CPUS; t++) {
-			iret[t] = mythread_create( &threadid[t], simul_smp_process, pdata, &err[t]);
+		if (sim_updates) {
+			reporter_ok = mythread_create (&reporter_id, updates_reporter, &reporter, &reporter_err);
 		}
 
-		/* reporting error */
-		for (t = 0; t < CPUS; t++) {
-			if (!iret[(short int)t]) { //cast to short int silences a warning
-				fprintf (stderr, "thread %d, fatal error at creating: %s\n", t, mythread_create_error(err[t]) );
-				exit(EXIT_FAILURE);
+		// with a checkpoint, the threads stop from time to time to save it,
+		// and with a target, to see if it has been reached
+		for (done = start; done < last && !target_reached (target, s.p_sfe_io, done); ) {
+
+			runs_set (done, target? target_next (done, last): last, CPUS, ckpt? time(NULL) + ckpt->interval: 0);
+
+			/* Create independent threads each of which will execute function */
+			for (t = 0; t < CPUS; t++) {
+				iret[t] = mythread_create( &threadid[t], simul_smp_process, &arg[t], &err[t]);
+			}
+
+			/* reporting error */
+			for (t = 0; t < CPUS; t++) {
+				if (!iret[t]) {
+					fprintf (stderr, "thread %d, fatal error at creating: %s\n", t, mythread_create_error(err[t]) );
+					exit(EXIT_FAILURE);
+				}
+			}
+
+			/* Wait for threads to be done */
+			for (t = 0; t < CPUS; t++) {
+				if (0==mythread_join( threadid[t] )) {
+					fprintf (stderr, "thread %d: fatal problems at joining\n", t);	
+					exit(EXIT_FAILURE);	
+				};
+			}
+
+			// every run before this one has been added to the summations
+			done = runs_done();
+
+			if (ckpt) {
+				ckpt->done = done;
+				if ((Samplef && 0 != fflush (Samplef))
+					|| !simckpt_save (ckpt, rat->ratingof_results, white_advantage_result, drawrate_evenmatch_result, s.p_sfe_io)) {
+					fprintf (stderr, "Problems writing the checkpoint file: %s\n", ckpt->fname);
+					exit(EXIT_FAILURE);
+				}
 			}
 		}
 
-		/* Wait for threads to be done */
-		for (t = 0; t < CPUS; t++) {
-			if (0==mythread_join( threadid[t] )) {
-				fprintf (stderr, "thread %d: fatal problems at joining\n", t);	
-				exit(EXIT_FAILURE);	
-			};
+		if (reporter_ok) {
+			mythread_atomic_set (&reporter.stop, 1);
+			mythread_join (reporter_id);
 		}
-	}
 
-	summations_calc_sdev (s.p_sfe_io, s.plyrs->n, (double)simulate);
-	updates_print_reachedgoal (sim_updates);
+		pending_done();
+		Samplef = NULL;
+		summations_calc_sdev (s.p_sfe_io, (double)(done - first));
+		updates_print_reachedgoal (sim_updates, reporter.astcount);
+		if (report) rejections_print();
+
+		memrel (reporter.progress);
+		memrel (arg);
+		memrel (err);
+		memrel (threadid);
+		memrel (iret);
+	}
 
-	return;
+	return done - first;
 }
 
 static /*@null@*/
@@ -636,11 +1191,12 @@ thread_return_t THREAD_CALL
 simul_smp_process (void *p)
 {
 	bool_t ok;
-	struct SIMSMP *s = p;
+	struct SIMTHREAD *arg = p;
+	struct SIMSMP *s = arg->s;
 
 	struct PLAYERS 			_plyrs			;	
 	struct ENCOUNTERS		_encount		;	
-	struct GAMES 			_games			;	
+	struct ENCOUNTERS		_full			;	
 	struct RATINGS 			_rat			;		
 	struct prior 		*	_PP_work  = NULL;			
 	struct rel_prior_set 	_RPset_work 	;	
@@ -648,8 +1204,8 @@ simul_smp_process (void *p)
 	// save locally
 	ok = TRUE;
 	ok = ok && players_replicate 	(s->plyrs, &_plyrs);
-	ok = ok && encounters_replicate	(s->encount, &_encount);
-	ok = ok && games_replicate 		(s->pGames, &_games);
+	ok = ok && encounters_init		(s->pairing->n, &_encount);
+	ok = ok && encounters_init		(s->pairing->n, &_full);
 	ok = ok && ratings_replicate 	(s->rat, &_rat);	
 	ok = ok && priorlist_replicate 	(s->plyrs->n, s->PP_work, &_PP_work);
 	ok = ok && relpriors_replicate	(&s->RPset_work, &_RPset_work);
@@ -660,13 +1216,15 @@ simul_smp_process (void *p)
 	}
 
 	simul (	s->simulate
-	, 		s->sim_updates
 	, 		s->quiet_mode
 	, 		s->prior_mode
 	, 		s->adjust_white_advantage
 	, 		s->adjust_draw_rate
 	, 		s->anchor_use
 	, 		s->anchor_err_rel2avg
+	, 		s->sim_warm
+	, 		s->active_set
+	, 		s->resample
 	, 		s->general_average
 	, 		s->anchor
 	, 		s->priored_n
@@ -678,20 +1236,24 @@ simul_smp_process (void *p)
 	, 		s->wa_prior
 	, 		s->dr_prior
 
-	, 		&_encount			// io, modified
+	, 		s->pairing			// input, shared
+	, 		s->n_games
+	, 		&_encount			// mem provided
+	, 		&_full				// mem provided
 	, 		&_plyrs				// io, modified
 	, 		&_rat				// io, modified
-	, 		&_games				// io, modified
 	, 		_RPset_work			// mem provided
 	, 		_PP_work			// mem provided
+	, 		s->covlin			// input
 
 	, 		s->p_sfe_io 		// output
+	, 		arg->progress		// output
 	);
 
 	// done
 	players_done (&_plyrs);
 	encounters_done (&_encount);
-	games_done (&_games);
+	encounters_done (&_full);
 	ratings_done (&_rat);
 	priorlist_done (&_PP_work);
 	relpriors_done1	(&_RPset_work);
@@ -22,13 +22,31 @@
 #define H_SIM
 /*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
 
+#include <stdio.h>
+
 #include "boolean.h"
 #include "mytypes.h"
+#include "randfast.h"
+#include "groups.h"
 
 #include "sysport.h"
 
-extern mythread_mutex_t Smpcount;
-extern mythread_mutex_t Groupmtx;
+struct SIMCKPT;
+struct COVLIN;
+
+// games of every simulated run
+#define SIM_PARAMETRIC		0	// results drawn from the ratings obtained
+#define SIM_BOOTSTRAP_GAMES	1	// games resampled
+#define SIM_BOOTSTRAP_ENC	2	// encounters resampled
+
+// simulations continue until the error margins of some players are precise enough
+struct SIMTARGET {
+	double				precision;	// largest standard error allowed for an error margin
+	double				factor;		// error margin / standard deviation
+	const player_t *	watch;		// players that must reach it
+	player_t			watch_n;
+};
+
 extern mythread_mutex_t Summamtx;
 extern mythread_mutex_t Printmtx;
 
@@ -42,28 +60,35 @@ get_a_simulated_run	( int 					limit
 					, const struct RATINGS 			*pRA
 					, const struct prior 			*PP_ori			
 					, const struct rel_prior_set	*pRPset_ori 	
+					, const struct ENCOUNTERS		*pairing		// games of the input, shared
+					, int							resample		// SIM_PARAMETRIC, or a bootstrap
 
+					, struct ENCOUNTERS 	*pFull 			// output, every simulated game
 					, struct ENCOUNTERS 	*pEncounters 	// output
 					, struct PLAYERS 		*pPlayers 		// output
-					, struct GAMES 			*pGames			// output
 					, struct prior 			*PP				// output
 					, struct rel_prior_set	*pRPset 		// output
+					, randstream_t			*rs				// random numbers for this run
+					, struct WELLCONN		*wc				// work buffer, one per thread
+					, gamesnum_t			*superwork		// work buffer, one per thread, 3 per player and zero
 )
 ;
 
 extern void
-save_simulated(struct PLAYERS *pPlayers, struct GAMES *pGames, int num);
+save_simulated(struct PLAYERS *pPlayers, const struct ENCOUNTERS *pFull, int num);
 
 extern void
 simul
 	( long 							simulate
-	, bool_t 						sim_updates
 	, bool_t 						quiet_mode
 	, bool_t						prior_mode
 	, bool_t 						adjust_white_advantage
 	, bool_t 						adjust_draw_rate
 	, bool_t						anchor_use
 	, bool_t						anchor_err_rel2avg
+	, bool_t						sim_warm
+	, bool_t						active_set			// --active-set in every run
+	, int							resample			// SIM_PARAMETRIC, or a bootstrap
 
 	, double						general_average
 	, player_t 						anchor
@@ -77,19 +102,23 @@ simul
 	, struct prior 					wa_prior
 	, struct prior 					dr_prior
 
-	, struct ENCOUNTERS	*			encount				// io, modified
+	, const struct ENCOUNTERS *		pairing				// input, shared by all threads
+	, gamesnum_t					n_games
+	, struct ENCOUNTERS	*			encount				// mem provided
+	, struct ENCOUNTERS	*			full				// mem provided
 	, struct PLAYERS *				plyrs				// io, modified
 	, struct RATINGS *				rat					// io, modified
-	, struct GAMES *				pGames				// io, modified
 
 	, struct rel_prior_set 			RPset_work			// mem provided
 	, struct prior *				PP_work				// mem provided
+	, const struct COVLIN *			covlin				// input, control variates, or NULL
 
 	, struct summations *			p_sfe_io 			// output
+	, myatomic_t *					progress			// output, runs done by this thread
 )
 ;
 
-void
+extern long
 simul_smp
 	( int							cpus
 	, long 							simulate
@@ -100,6 +129,9 @@ simul_smp
 	, bool_t 						adjust_draw_rate
 	, bool_t						anchor_use
 	, bool_t						anchor_err_rel2avg
+	, bool_t						sim_warm
+	, bool_t						active_set			// --active-set in every run
+	, int							resample			// SIM_PARAMETRIC, or a bootstrap
 
 	, double						general_average
 	, player_t 						anchor
@@ -113,15 +145,19 @@ simul_smp
 	, struct prior 					wa_prior
 	, struct prior 					dr_prior
 
-	, struct ENCOUNTERS	*			encount				// io, modified
+	, const struct ENCOUNTERS *		pairing				// input, every game (ENCOUNTERS_FULL)
+	, gamesnum_t					n_games
 	, struct PLAYERS *				plyrs				// io, modified
 	, struct RATINGS *				rat					// io, modified
-	, struct GAMES *				pGames				// io, modified
 
 	, struct rel_prior_set 			RPset_work			// mem provided
 	, struct prior *				PP_work				// mem provided
 
-	, struct summations *			p_sfe_io 			// output
+	, struct summations *			p_sfe_io 			// output, allocated with summations_calloc()
+	, FILE *						samplef				// output, sample file from simfile_create(), or NULL
+	, struct SIMCKPT *				ckpt				// io, runs done (resumed) and checkpoint file, or NULL
+	, const struct SIMTARGET *		target				// stop when reached, -s is the most runs, or NULL
+	, const struct COVLIN *			covlin				// control variates from covlin_init(), or NULL
 )
 ;
 /*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
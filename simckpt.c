@@ -0,0 +1,165 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "simckpt.h"
+#include "summations.h"
+#include "mymem.h"
+
+static void
+header_set (const struct SIMCKPT *c, const struct summations *sm, struct SIMCKPT_HEADER *h /*@out@*/)
+{
+	memset (h, 0, sizeof(*h));
+	strcpy (h->magic, SIMCKPT_MAGIC);
+	h->version			= SIMCKPT_VERSION;
+	h->endian			= SIMCKPT_ENDIAN;
+	h->nplayers			= (int64_t)sm->nplayers;
+	h->first			= (int64_t)c->first;
+	h->last				= (int64_t)c->last;
+	h->done				= (int64_t)c->done;
+	h->seed				= (int64_t)c->seed;
+	h->options			= (int64_t)c->options;
+	h->anchor			= (int64_t)c->anchor;
+	h->pairmode			= (int64_t)sm->pairmode;
+	h->table_n			= (int64_t)sm->table_n;
+	h->pair_n			= (int64_t)sm->pair_n;
+	h->beta				= c->beta;
+	h->general_average	= c->general_average;
+}
+
+// the reference is compared bit by bit, it comes from the same input and settings
+static bool_t
+reference_same (FILE *f, player_t n, const double *ratingof, double wadv, double drate)
+{
+	double x;
+	player_t j;
+	bool_t ok = TRUE;
+
+	for (j = 0; ok && j < n; j++) {
+		ok = 1 == fread (&x, sizeof(double), 1, f) && x == ratingof[j];
+	}
+	ok = ok && 1 == fread (&x, sizeof(double), 1, f) && x == wadv;
+	ok = ok && 1 == fread (&x, sizeof(double), 1, f) && x == drate;
+	return ok;
+}
+
+// no globals
+// Written first to a temporary file, so an interruption never leaves a broken checkpoint
+bool_t
+simckpt_save	( const struct SIMCKPT *c
+				, const double *ratingof
+				, double wadv
+				, double drate
+				, const struct summations *sm)
+{
+	struct SIMCKPT_HEADER h;
+	char *tmpname;
+	FILE *f;
+	bool_t ok;
+
+	assert (c && c->fname);
+
+	if (NULL == (tmpname = memnew (strlen(c->fname) + 5)))
+		return FALSE;
+	strcpy (tmpname, c->fname);
+	strcat (tmpname, ".tmp");
+
+	header_set (c, sm, &h);
+
+	if (NULL == (f = fopen (tmpname, "wb"))) {
+		memrel (tmpname);
+		return FALSE;
+	}
+	ok = 1 == fwrite (&h, sizeof(h), 1, f)
+		&& (size_t)sm->nplayers == fwrite (ratingof, sizeof(double), (size_t)sm->nplayers, f)
+		&& 1 == fwrite (&wadv,  sizeof(double), 1, f)
+		&& 1 == fwrite (&drate, sizeof(double), 1, f)
+		&& summations_save (f, sm);
+	ok = 0 == fclose (f) && ok;
+
+	// rename() may not replace an existing file in some systems
+	if (ok && 0 != rename (tmpname, c->fname)) {
+		remove (c->fname);
+		ok = 0 == rename (tmpname, c->fname);
+	}
+	if (!ok) remove (tmpname);
+
+	memrel (tmpname);
+	return ok;
+}
+
+// no globals
+// The range of runs is taken from the file, it could be any
+int
+simckpt_load	( struct SIMCKPT *c
+				, const double *ratingof
+				, double wadv
+				, double drate
+				, struct summations *sm)
+{
+	struct SIMCKPT_HEADER h, expected;
+	FILE *f;
+	int ret;
+
+	assert (c && c->fname);
+
+	if (NULL == (f = fopen (c->fname, "rb")))
+		return SIMCKPT_ABSENT;
+
+	header_set (c, sm, &expected);
+
+	if (1 != fread (&h, sizeof(h), 1, f)
+		|| 0 != memcmp (h.magic, SIMCKPT_MAGIC, sizeof(SIMCKPT_MAGIC))
+		|| h.version != SIMCKPT_VERSION
+		|| h.endian != SIMCKPT_ENDIAN
+		|| h.first < 0
+		|| h.first > h.done
+		|| h.done > h.last) {
+		ret = SIMCKPT_DAMAGED;
+	} else
+	if (h.nplayers != expected.nplayers
+		|| h.seed != expected.seed
+		|| h.options != expected.options
+		|| h.anchor != expected.anchor
+		|| h.pairmode != expected.pairmode
+		|| h.table_n != expected.table_n
+		|| h.pair_n != expected.pair_n
+		|| h.beta != expected.beta
+		|| h.general_average != expected.general_average
+		|| !reference_same (f, sm->nplayers, ratingof, wadv, drate)) {
+		ret = SIMCKPT_MISMATCH;
+	} else
+	if (!summations_load (f, sm)) {
+		ret = SIMCKPT_DAMAGED;
+	} else {
+		c->first = (long)h.first;
+		c->last = (long)h.last;
+		c->done = (long)h.done;
+		ret = SIMCKPT_LOADED;
+	}
+
+	fclose (f);
+	return ret;
+}
@@ -0,0 +1,105 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(H_SIMCKPT)
+#define H_SIMCKPT
+/*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
+
+#include <stdint.h>
+#include "boolean.h"
+#include "mytypes.h"
+
+/*
+|	Checkpoint of the simulations, in the byte order of the machine that
+|	wrote it:
+|
+|	struct SIMCKPT_HEADER
+|	reference: double[nplayers+2], ratings obtained, white advantage, draw rate
+|	summations for errors of the runs from "first" to "done", with their
+|	controls if the runs have them (--sim-control), see summations_save()
+|
+|	Every run has its own random stream, given by the seed and the number
+|	of the run, so the runs done and the seed are all that is needed to
+|	continue with the random numbers. A simulation resumed from a
+|	checkpoint gives the same results as one that was never interrupted.
+|
+|	A shard does the runs from "first" to "last" (excluded) of a bigger
+|	simulation. Once done == last, the checkpoint holds its part of the
+|	summations, to be merged with the others.
+*/
+
+#define SIMCKPT_MAGIC "ORDOCKP"
+#define SIMCKPT_VERSION 3
+#define SIMCKPT_ENDIAN 0x01020304
+
+struct SIMCKPT_HEADER {
+	char		magic[8];
+	int32_t		version;
+	int32_t		endian;
+	int64_t		nplayers;
+	int64_t		first;		// runs of this simulation, or shard
+	int64_t		last;
+	int64_t		done;		// runs added to the summations
+	int64_t		seed;
+	int64_t		options;	// switches that change the simulated runs
+	int64_t		anchor;
+	int64_t		pairmode;	// scope of the summations
+	int64_t		table_n;
+	int64_t		pair_n;
+	double		beta;
+	double		general_average;
+};
+
+// settings of a simulation, a checkpoint can only continue one with the same
+struct SIMCKPT {
+	const char *	fname;
+	long			interval;	// seconds between checkpoints
+	long			first;		// runs from first to last (excluded), set by simckpt_load()
+	long			last;
+	long			done;		// runs already in the summations, set by simckpt_load()
+	uint32_t		seed;
+	unsigned		options;
+	player_t		anchor;
+	double			beta;
+	double			general_average;
+};
+
+enum SIMCKPT_LOAD {
+	SIMCKPT_LOADED,
+	SIMCKPT_ABSENT,		// no checkpoint yet, start from the beginning
+	SIMCKPT_MISMATCH,	// written by a different simulation
+	SIMCKPT_DAMAGED
+};
+
+extern bool_t	simckpt_save	( const struct SIMCKPT *c
+								, const double *ratingof	// reference, ratings obtained
+								, double wadv
+								, double drate
+								, const struct summations *sm);
+
+extern int		simckpt_load	( struct SIMCKPT *c			// io, first, last and done are set
+								, const double *ratingof	// reference, must be the same
+								, double wadv
+								, double drate
+								, struct summations *sm		/*@out@*/);
+
+/*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
+#endif
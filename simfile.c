@@ -0,0 +1,472 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "simfile.h"
+#include "pairlist.h"
+#include "sysport.h"
+#include "gauss.h"
+#include "mymem.h"
+
+//================================================ write
+
+static bool_t
+write_padding (FILE *f, size_t written)
+{
+	static const char zeros[8] = {0,0,0,0,0,0,0,0};
+	size_t pad = (8 - written % 8) % 8;
+	return pad == fwrite (zeros, 1, pad, f);
+}
+
+FILE *
+simfile_create (const char *fname, const struct PLAYERS *plyrs, const double *ratingof, double wadv, double drate)
+{
+	struct SIMFILE_HEADER h;
+	FILE *f;
+	player_t j;
+	size_t names_size, len;
+	bool_t ok;
+
+	for (names_size = 0, j = 0; j < plyrs->n; j++) {
+		names_size += strlen(plyrs->name[j]) + 1;
+	}
+
+	memset (&h, 0, sizeof(h));
+	strcpy (h.magic, SIMFILE_MAGIC);
+	h.version 		= SIMFILE_VERSION;
+	h.endian		= SIMFILE_ENDIAN;
+	h.nplayers		= (int64_t)plyrs->n;
+	h.names_size	= (int64_t)((names_size + 7) / 8 * 8);
+	h.reserved		= 0;
+
+	if (NULL == (f = fopen (fname, "wb")))
+		return NULL;
+
+	ok = 1 == fwrite (&h, sizeof(h), 1, f);
+	for (j = 0; ok && j < plyrs->n; j++) {
+		len = strlen(plyrs->name[j]) + 1;
+		ok = len == fwrite (plyrs->name[j], 1, len, f);
+	}
+	ok = ok && write_padding (f, names_size);
+	ok = ok && (size_t)plyrs->n == fwrite (ratingof, sizeof(double), (size_t)plyrs->n, f);
+	ok = ok && 1 == fwrite (&wadv,  sizeof(double), 1, f);
+	ok = ok && 1 == fwrite (&drate, sizeof(double), 1, f);
+
+	if (!ok) {
+		fclose (f);
+		return NULL;
+	}
+	return f;
+}
+
+// Opens a sample file to continue after its first "runs" runs, which may
+// be followed by others that will be written again in the same order.
+FILE *
+simfile_reopen (const char *fname, player_t n, long runs)
+{
+	struct SIMFILE_HEADER h;
+	FILE *f;
+	int64_t start, end;
+	size_t rec = sizeof(float) * (size_t)(n + 2);
+	bool_t ok;
+
+	if (NULL == (f = fopen (fname, "r+b")))
+		return NULL;
+
+	ok = 1 == fread (&h, sizeof(h), 1, f)
+		&& 0 == memcmp (h.magic, SIMFILE_MAGIC, sizeof(SIMFILE_MAGIC))
+		&& h.version == SIMFILE_VERSION
+		&& h.endian == SIMFILE_ENDIAN
+		&& h.nplayers == (int64_t)n
+		&& h.names_size >= h.nplayers;
+
+	if (ok) {
+		start = (int64_t)sizeof(h) + h.names_size + (int64_t)(sizeof(double) * (size_t)(n + 2)) + (int64_t)rec * runs;
+		ok = 0 == mysys_fseek64 (f, 0, SEEK_END) && -1 != (end = mysys_ftell64 (f)) && end >= start
+			&& 0 == mysys_fseek64 (f, start, SEEK_SET);
+	}
+
+	if (!ok) {
+		fclose (f);
+		return NULL;
+	}
+	return f;
+}
+
+// no globals
+bool_t
+simfile_append (FILE *f, player_t n, const double *ratingof, double wadv, double drate)
+{
+	enum {CHUNK = 1024};
+	float buf[CHUNK];
+	player_t j, k;
+	bool_t ok = TRUE;
+
+	for (j = 0; ok && j < n; j += k) {
+		for (k = 0; k < CHUNK && j + k < n; k++) {
+			buf[k] = (float)ratingof[j+k];
+		}
+		ok = (size_t)k == fwrite (buf, sizeof(float), (size_t)k, f);
+	}
+	buf[0] = (float)wadv;
+	buf[1] = (float)drate;
+	return ok && 2 == fwrite (buf, sizeof(float), 2, f);
+}
+
+//================================================ read
+
+static void
+simsamples_clear (struct SIMSAMPLES *ss)
+{
+	ss->n		= 0;
+	ss->runs	= 0;
+	ss->namebuf	= NULL;
+	ss->name	= NULL;
+	ss->ref		= NULL;
+	ss->f		= NULL;
+	ss->start	= 0;
+}
+
+void
+simsamples_done (struct SIMSAMPLES *ss)
+{
+	if (ss->namebuf)	memrel (ss->namebuf);
+	if (ss->name)		memrel ((void *)ss->name);
+	if (ss->ref)		memrel (ss->ref);
+	if (ss->f)			fclose (ss->f);
+	simsamples_clear (ss);
+}
+
+// Reads the names and the reference ratings. The runs stay in the file,
+// which is kept open, and are read by simsamples_report() when needed.
+bool_t
+simsamples_load (const char *fname, struct SIMSAMPLES *ss)
+{
+	struct SIMFILE_HEADER h;
+	FILE *f;
+	player_t j, n;
+	int64_t start, end;
+	size_t rec, names_size, i;
+	char *p;
+	bool_t ok;
+
+	simsamples_clear (ss);
+
+	if (NULL == (f = fopen (fname, "rb")))
+		return FALSE;
+
+	ok = 1 == fread (&h, sizeof(h), 1, f)
+		&& 0 == memcmp (h.magic, SIMFILE_MAGIC, sizeof(SIMFILE_MAGIC))
+		&& h.version == SIMFILE_VERSION
+		&& h.endian == SIMFILE_ENDIAN
+		&& h.nplayers > 0 
+		&& h.names_size >= h.nplayers;
+
+	if (ok) {
+		n 			= (player_t)h.nplayers;
+		names_size 	= (size_t)h.names_size;
+		ss->n 		= n;
+		ss->namebuf = memnew (names_size + 1);
+		ss->name 	= memnew (sizeof(char *) * (size_t)n);
+		ss->ref 	= memnew (sizeof(double) * (size_t)(n + 2));
+		ok = NULL != ss->namebuf && NULL != ss->name && NULL != ss->ref
+			&& names_size == fread (ss->namebuf, 1, names_size, f)
+			&& (size_t)(n + 2) == fread (ss->ref, sizeof(double), (size_t)(n + 2), f);
+	}
+
+	if (ok) {
+		ss->namebuf[names_size] = '\0';
+		for (p = ss->namebuf, i = 0, j = 0; j < ss->n && i < names_size; j++) {
+			ss->name[j] = p + i;
+			i += strlen(p + i) + 1;
+		}
+		ok = j == ss->n && i <= names_size;
+	}
+
+	// runs fill the rest of the file, an incomplete last one is ignored
+	if (ok) {
+		rec = sizeof(float) * (size_t)(ss->n + 2);
+		start = mysys_ftell64 (f);
+		ok = -1 != start && 0 == mysys_fseek64 (f, 0, SEEK_END) && -1 != (end = mysys_ftell64 (f));
+		if (ok) {
+			ss->runs 	= (long)((end - start) / (int64_t)rec);
+			ss->start 	= start;
+		}
+	}
+
+	ss->f = f;
+
+	if (!ok) simsamples_done (ss);
+	return ok;
+}
+
+//================================================ query
+
+struct RANKED {
+	double		r;
+	player_t	j;
+};
+
+static int
+compare_ranked (const void *a, const void *b)
+{
+	const struct RANKED *x = a;
+	const struct RANKED *y = b;
+	if (x->r < y->r) return  1;
+	if (x->r > y->r) return -1;
+	return x->j < y->j? -1: (x->j > y->j? 1: 0);
+}
+
+static int
+compare_float (const void *a, const void *b)
+{
+	const float *x = a;
+	const float *y = b;
+	return *x < *y? -1: (*x > *y? 1: 0);
+}
+
+// memory for the columns sorted at once to find the quantiles
+#define SIMQUERY_BLOCK_MEMORY (64 * 1024 * 1024)
+
+struct WELFORD {
+	double mean;
+	double m2;
+};
+
+static void
+welford_add (struct WELFORD *w, double v, long count)
+{
+	double d = v - w->mean;
+	w->mean += d / (double)count;
+	w->m2 += d * (v - w->mean);
+}
+
+// quantile p of a sorted vector, linear interpolation
+static double
+quantile (const float *v, long n, double p)
+{
+	double pos = p * (double)(n - 1);
+	long i = (long)pos;
+	if (n == 0) return 0;
+	if (i >= n - 1) return (double)v[n-1];
+	return (double)v[i] + (pos - (double)i) * ((double)v[i+1] - (double)v[i]);
+}
+
+static double
+cfs_of (double diff, double sdev)
+{
+	if (sdev > 0) return 100 * gauss_integral (diff / sdev);
+	return diff > 0? 100: (diff < 0? 0: 50);
+}
+
+static void
+fatal_mem (void)
+{
+	fprintf (stderr, "Not enough memory to query the simulations\n");
+	exit (EXIT_FAILURE);
+}
+
+static void
+fatal_read (void)
+{
+	fprintf (stderr, "Problems reading the file of simulated runs\n");
+	exit (EXIT_FAILURE);
+}
+
+// values from..from+count-1 of run z
+static void
+read_run (const struct SIMSAMPLES *ss, long z, player_t from, player_t count, float *buf)
+{
+	int64_t rec = (int64_t)sizeof(float) * (int64_t)(ss->n + 2);
+	int64_t pos = ss->start + rec * (int64_t)z + (int64_t)sizeof(float) * (int64_t)from;
+	if (0 != mysys_fseek64 (ss->f, pos, SEEK_SET) 
+		|| (size_t)count != fread (buf, sizeof(float), (size_t)count, ss->f))
+		fatal_read();
+}
+
+// Lower and upper quantiles of each player, sorting the columns of a block
+// of players at a time, so the memory needed does not depend on the file size.
+static void
+column_quantiles (const struct SIMSAMPLES *ss, double plo, double phi, double *qlo /*@out@*/, double *qhi /*@out@*/)
+{
+	size_t runs = (size_t)(ss->runs > 0? ss->runs: 1);
+	player_t block, j0, b, nb;
+	float *row, *col, *c;
+	long z;
+
+	block = (player_t)(SIMQUERY_BLOCK_MEMORY / (sizeof(float) * runs));
+	if (block < 1) block = 1;
+	if (block > ss->n) block = ss->n;
+
+	if (NULL == (row = memnew (sizeof(float) * (size_t)block)))
+		fatal_mem();
+	if (NULL == (col = memnew (sizeof(float) * runs * (size_t)block)))
+		fatal_mem();
+
+	for (j0 = 0; j0 < ss->n; j0 += block) {
+		nb = ss->n - j0 < block? ss->n - j0: block;
+		for (z = 0; z < ss->runs; z++) {
+			read_run (ss, z, j0, nb, row);
+			for (b = 0; b < nb; b++) col[(size_t)b * runs + (size_t)z] = row[b];
+		}
+		for (b = 0; b < nb; b++) {
+			c = col + (size_t)b * runs;
+			qsort (c, (size_t)ss->runs, sizeof(float), compare_float);
+			qlo[j0+b] = quantile (c, ss->runs, plo);
+			qhi[j0+b] = quantile (c, ss->runs, phi);
+		}
+	}
+
+	memrel (col);
+	memrel (row);
+}
+
+// The runs are read from the file and never held in memory all together.
+// One pass over them gives the errors of the players, of the pairs and of
+// white advantage and draw rate. The intervals need the sorted columns,
+// which take one more pass for each block of players.
+void
+simsamples_report	( FILE *f
+					, const struct SIMSAMPLES *ss
+					, double confidence
+					, double confidence_factor
+					, const struct PAIRLIST *pl
+					, int decimals)
+{
+	struct RANKED *rk;
+	struct WELFORD *wp, *wadj, *wpair, wa, dr;
+	player_t *rank_of;
+	float *x;
+	double *qlo, *qhi;
+	double sdev, lo, hi;
+	player_t i, j, k;
+	ptrdiff_t q, npairs = pl? pl->n: 0;
+	long z;
+	int ml = 6, len;
+
+	if (NULL == (rk = memnew (sizeof(struct RANKED) * (size_t)ss->n)))
+		fatal_mem();
+	if (NULL == (rank_of = memnew (sizeof(player_t) * (size_t)ss->n)))
+		fatal_mem();
+	if (NULL == (x = memnew (sizeof(float) * (size_t)(ss->n + 2))))
+		fatal_mem();
+	if (NULL == (wp = memnew (sizeof(struct WELFORD) * (size_t)ss->n)))
+		fatal_mem();
+	if (NULL == (wadj = memnew (sizeof(struct WELFORD) * (size_t)ss->n)))
+		fatal_mem();
+	if (NULL == (wpair = memnew (sizeof(struct WELFORD) * (size_t)(npairs > 0? npairs: 1))))
+		fatal_mem();
+	if (NULL == (qlo = memnew (sizeof(double) * (size_t)ss->n)))
+		fatal_mem();
+	if (NULL == (qhi = memnew (sizeof(double) * (size_t)ss->n)))
+		fatal_mem();
+
+	for (j = 0; j < ss->n; j++) {
+		rk[j].r = ss->ref[j];
+		rk[j].j = j;
+		len = (int)strlen(ss->name[j]);
+		if (len > ml) ml = len;
+	}
+	qsort (rk, (size_t)ss->n, sizeof(struct RANKED), compare_ranked);
+	for (i = 0; i < ss->n; i++) rank_of[rk[i].j] = i;
+
+	// the original calculation counts as a sample of white advantage and draw rate, as in the simulations
+	wa.mean = ss->ref[ss->n];
+	dr.mean = ss->ref[ss->n+1];
+	wa.m2 = dr.m2 = 0;
+
+	memset (wp,    0, sizeof(struct WELFORD) * (size_t)ss->n);
+	memset (wadj,  0, sizeof(struct WELFORD) * (size_t)ss->n);
+	memset (wpair, 0, sizeof(struct WELFORD) * (size_t)(npairs > 0? npairs: 1));
+
+	for (z = 0; z < ss->runs; z++) {
+		if (z == 0) 
+			read_run (ss, 0, 0, ss->n + 2, x);
+		else if ((size_t)(ss->n + 2) != fread (x, sizeof(float), (size_t)(ss->n + 2), ss->f))
+			fatal_read();
+
+		for (j = 0; j < ss->n; j++) {
+			welford_add (&wp[j], (double)x[j], z + 1);
+			i = rank_of[j];
+			if (i + 1 < ss->n)
+				welford_add (&wadj[i], (double)x[j] - (double)x[rk[i+1].j], z + 1);
+		}
+		for (q = 0; q < npairs; q++) {
+			welford_add (&wpair[q], (double)x[pl->x[q].a] - (double)x[pl->x[q].b], z + 1);
+		}
+		welford_add (&wa, (double)x[ss->n],   z + 2);
+		welford_add (&dr, (double)x[ss->n+1], z + 2);
+	}
+
+	column_quantiles (ss, (1 - confidence) / 2, (1 + confidence) / 2, qlo, qhi);
+
+	fprintf (f, "Simulated runs = %ld\n\n", ss->runs);
+
+	fprintf (f, "%4s %-*s : %7s %6s %7s %7s %7s\n", "#", ml, "PLAYER", "RATING", "ERROR", "LOWER", "UPPER", "CFS(%)");
+	for (i = 0; i < ss->n; i++) {
+		j = rk[i].j;
+
+		// interval of the simulations, centered on the rating obtained
+		sdev = ss->runs > 0? sqrt(wp[j].m2 / (double)ss->runs): 0;
+		lo = ss->ref[j] + qlo[j] - wp[j].mean;
+		hi = ss->ref[j] + qhi[j] - wp[j].mean;
+
+		fprintf (f, "%4ld %-*s : %7.*f %6.*f %7.*f %7.*f", (long)(i+1), ml, ss->name[j]
+					, decimals, ss->ref[j], decimals, sdev * confidence_factor, decimals, lo, decimals, hi);
+		if (i + 1 < ss->n) {
+			k = rk[i+1].j;
+			fprintf (f, " %7.1f", cfs_of (ss->ref[j] - ss->ref[k], ss->runs > 0? sqrt(wadj[i].m2 / (double)ss->runs): 0));
+		} else {
+			fprintf (f, " %7s", "---");
+		}
+		fprintf (f, "\n");
+	}
+
+	fprintf (f, "\n");
+	fprintf (f, "White advantage = %.2f +/- %.2f\n", ss->ref[ss->n], sqrt(wa.m2 / (double)(ss->runs + 1)));
+	fprintf (f, "Draw rate (equal opponents) = %.2f %s +/- %.2f\n", 100 * ss->ref[ss->n+1], "%", 100 * sqrt(dr.m2 / (double)(ss->runs + 1)));
+
+	if (npairs > 0) {
+		fprintf (f, "\n%-*s   %-*s : %7s %6s %7s\n", ml, "PLAYER", ml, "OPPONENT", "DIFF", "ERROR", "CFS(%)");
+		for (q = 0; q < npairs; q++) {
+			j = pl->x[q].a;
+			k = pl->x[q].b;
+			sdev = ss->runs > 0? sqrt(wpair[q].m2 / (double)ss->runs): 0;
+			fprintf (f, "%-*s - %-*s : %+7.*f %6.*f %7.1f\n", ml, ss->name[j], ml, ss->name[k]
+						, decimals, ss->ref[j] - ss->ref[k], decimals, sdev * confidence_factor
+						, cfs_of (ss->ref[j] - ss->ref[k], sdev));
+		}
+	}
+
+	memrel (qhi);
+	memrel (qlo);
+	memrel (wpair);
+	memrel (wadj);
+	memrel (wp);
+	memrel (x);
+	memrel (rank_of);
+	memrel (rk);
+}
@@ -0,0 +1,90 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(H_SIMFILE)
+#define H_SIMFILE
+/*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "boolean.h"
+#include "mytypes.h"
+
+struct PAIRLIST;
+
+/*
+|	Sample file of the simulations, in the byte order of the machine that
+|	wrote it. Every section starts at a multiple of 8 bytes, so the file
+|	could be memory mapped and read in place:
+|
+|	struct SIMFILE_HEADER
+|	names, each one ending in '\0', padded with zeros to a multiple of 8
+|	reference: double[nplayers+2], ratings obtained, white advantage, draw rate
+|	samples:   float[nplayers+2] for each simulated run, appended in run order
+|
+|	The number of runs is not stored, it is given by the size of the file.
+*/
+
+#define SIMFILE_MAGIC "ORDOSIM"
+#define SIMFILE_VERSION 1
+#define SIMFILE_ENDIAN 0x01020304
+
+struct SIMFILE_HEADER {
+	char		magic[8];
+	int32_t		version;
+	int32_t		endian;
+	int64_t		nplayers;
+	int64_t		names_size;
+	int64_t		reserved;
+};
+
+struct SIMSAMPLES {
+	player_t		n;			// players
+	long			runs;
+	char *			namebuf;
+	const char **	name;
+	double *		ref;		// n+2
+	FILE *			f;			// open, the runs are read from it when queried
+	int64_t			start;		// offset of the first run
+};
+
+extern FILE *	simfile_create	( const char *fname
+								, const struct PLAYERS *plyrs
+								, const double *ratingof
+								, double wadv
+								, double drate);
+
+extern FILE *	simfile_reopen	(const char *fname, player_t n, long runs);
+
+extern bool_t	simfile_append	(FILE *f, player_t n, const double *ratingof, double wadv, double drate);
+
+extern bool_t	simsamples_load	(const char *fname, struct SIMSAMPLES *ss /*@out@*/);
+extern void		simsamples_done	(struct SIMSAMPLES *ss);
+
+extern void		simsamples_report	( FILE *f
+									, const struct SIMSAMPLES *ss
+									, double confidence 		// 0 to 1, for the quantiles
+									, double confidence_factor	// for the errors
+									, const struct PAIRLIST *pl
+									, int decimals);
+
+/*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
+#endif
@@ -18,15 +18,35 @@
     along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include <float.h>
 
 #include "summations.h"
 #include "mymem.h"
 
 //---------------------------------- statics
 
+/*
+|	Every accumulator keeps a running mean and the sum of squared
+|	differences from it (Welford). Unlike the raw sums of x and x*x, it
+|	does not lose precision when the variance is small compared to the
+|	mean, which is the case of ratings in the thousands.
+|
+|	Pairs of players only have an accumulator when they are in the scope
+|	given to summations_calloc(): all the pairs among the players of a
+|	table (which may be all of them), or an explicit list of pairs.
+|
+|	Optionally, every accumulator has a control variate: a variable of
+|	exact variance, given with each run, correlated with the accumulated
+|	one. The variance is then that of the regression on the control, with
+|	its exact value, plus the variance of what is left. Only what is left
+|	adds noise, and the effective number of runs is larger.
+*/
+
 static ptrdiff_t
 head2head_idx_sdev (ptrdiff_t x, ptrdiff_t y)
 {	
@@ -39,87 +59,220 @@ head2head_idx_sdev (ptrdiff_t x, ptrdiff_t y)
 }
 
 static double
-get_sdev (double s1, double s2, double n)
+get_sdev (double m2, double n)
+{
+	return n > 0? sqrt (m2/n): 0;
+}
+
+static void
+welford_add (double *mean, double *m2, double x, double n)
+{
+	double d = x - *mean;
+	*mean += d / n;
+	*m2   += d * (x - *mean);
+}
+
+static void
+control_add (struct CONTROL_ACC *c, double x, double dy, double n)
+{
+	// dy is from the mean before it was updated
+	double d = x - c->mean;
+	c->mean += d / n;
+	c->m2   += d * (x - c->mean);
+	c->co   += dy * (x - c->mean);
+}
+
+static double
+control_sdev (const struct CONTROL_ACC *c, double m2, double n)
+{
+	double b, var;
+	if (!(c->m2 > 0) || n < 2) 
+		return get_sdev (m2, n);
+	b = c->co / c->m2;
+	// the exact variance is scaled as the estimated ones, divided by n
+	var = b * b * c->var * (n - 1) / n + (m2 - b * c->co) / n;
+	return var > 0? sqrt (var): 0;
+}
+
+// runs without control that give the same standard error of the sdev
+static double
+control_ess (const struct CONTROL_ACC *c, double m2, double n)
+{
+	double r2;
+	if (!(c->m2 > 0) || !(m2 > 0)) 
+		return n;
+	r2 = c->co * c->co / (c->m2 * m2);
+	return r2 < 1? n / (1 - r2 * r2): n / DBL_EPSILON;
+}
+
+static int 
+compare_pair (const void * a, const void * b)
+{
+	const struct PAIR *pa = a;
+	const struct PAIR *pb = b;
+	if (pa->a != pb->a) return pa->a < pb->a? -1: 1;
+	if (pa->b != pb->b) return pa->b < pb->b? -1: 1;
+	return 0;
+}
+
+// sorted, a > b and no repetitions
+static ptrdiff_t
+pairs_normalize (struct PAIR *pair, ptrdiff_t n)
+{
+	ptrdiff_t i, m;
+	player_t t;
+
+	for (i = 0, m = 0; i < n; i++) {
+		if (pair[i].a == pair[i].b) continue;
+		if (pair[i].a < pair[i].b) {
+			t = pair[i].a; pair[i].a = pair[i].b; pair[i].b = t;
+		}
+		pair[m++] = pair[i];
+	}
+	if (m > 0) {
+		qsort (pair, (size_t)m, sizeof(struct PAIR), compare_pair);
+		for (i = 1, n = 1; i < m; i++) {
+			if (compare_pair (&pair[n-1], &pair[i]) != 0) pair[n++] = pair[i];
+		}
+		m = n;
+	}
+	return m;
+}
+
+// first element of block k out of nb, when the cost of the elements grows linearly
+static ptrdiff_t
+split_triangle (ptrdiff_t n, int k, int nb)
+{
+	return k >= nb? n: (ptrdiff_t)((double)n * sqrt((double)k/(double)nb));
+}
+
+static ptrdiff_t
+split_even (ptrdiff_t n, int k, int nb)
+{
+	return k >= nb? n: (ptrdiff_t)((double)n * (double)k/(double)nb);
+}
+
+static ptrdiff_t
+relative_elements (player_t nplayers, int pairmode, player_t table_n, ptrdiff_t pair_n)
 {
-	double xx = n*s2 - s1 * s1;
-	xx = sqrt(xx*xx); // removes problems with -0.00000000000;
-	return sqrt( xx ) /n;
+	ptrdiff_t tn = (ptrdiff_t)table_n;
+	(void)nplayers;
+	switch (pairmode) {
+		case PAIRS_TABLE: 	return (tn*tn-tn)/2;
+		case PAIRS_LIST: 	return pair_n;
+		default: 			return 0;
+	}
 }
 
 static void
-summations_clear (struct summations *sm, player_t nplayers)
+summations_clear (struct summations *sm)
 {
-	ptrdiff_t np = (ptrdiff_t)nplayers;
-	ptrdiff_t est = (ptrdiff_t)((np*np-np)/2); /* elements of simulation table */
-	ptrdiff_t i, idx;
+	ptrdiff_t i;
 	
-	sm->wa_sum1 = 0;
-	sm->wa_sum2 = 0;                               
-	sm->dr_sum1 = 0;
-	sm->dr_sum2 = 0; 
+	sm->wa_mean = 0;
+	sm->wa_m2 = 0;                               
+	sm->dr_mean = 0;
+	sm->dr_m2 = 0; 
+	sm->wadr_n = 0; 
 	sm->wa_sdev = 0;                               
 	sm->dr_sdev = 0;
 		
-	for (idx = 0; idx < est; idx++) {
-		sm->relative[idx].sum1 = 0;
-		sm->relative[idx].sum2 = 0;
-		sm->relative[idx].sdev = 0;
+	for (i = 0; i < sm->relative_n; i++) {
+		sm->relative[i].mean = 0;
+		sm->relative[i].m2 = 0;
+		sm->relative[i].sdev = 0;
 	}
 
-	for (i = 0; i < np; i++) {
-		sm->sum1[i] = 0;
-		sm->sum2[i] = 0;
+	for (i = 0; i < sm->nplayers; i++) {
+		sm->mean[i] = 0;
+		sm->m2[i] = 0;
 		sm->sdev[i] = 0;
 	}
 }
 
 //---------------------------------- extern
 
-bool_t 
-summations_calloc (struct summations *sm, player_t nplayers)
+// bytes needed by summations_calloc(), pairs that repeat are counted
+size_t
+summations_memory (player_t nplayers, int pairmode, player_t table_n, ptrdiff_t pair_n)
 {
-	ptrdiff_t np = (ptrdiff_t)nplayers;
-	ptrdiff_t est = (ptrdiff_t)((np*np-np)/2); /* elements of simulation table */
-	size_t allocsize = sizeof(struct DEVIATION_ACC) * (size_t)est;
-
-	double					*a;
-	double 					*b;
-	double 					*c;
-	struct DEVIATION_ACC	*d;
+	size_t x = 3 * sizeof(double) * (size_t)nplayers;
+	x += sizeof(struct DEVIATION_ACC) * (size_t)relative_elements (nplayers, pairmode, table_n, pair_n);
+	if (pairmode == PAIRS_TABLE)
+		x += sizeof(player_t) * (size_t)(nplayers + table_n);
+	if (pairmode == PAIRS_LIST)
+		x += sizeof(struct PAIR) * (size_t)pair_n;
+	return x;
+}
 
-	size_t		sa = sizeof(double);
-	size_t		sb = sizeof(double);
-	size_t		sc = sizeof(double);
-	size_t		sd = allocsize;
+bool_t 
+summations_calloc	( struct summations *sm
+					, player_t nplayers
+					, int pairmode
+					, const player_t *table		// PAIRS_TABLE, NULL for all the players
+					, player_t table_n
+					, const struct PAIR *pair	// PAIRS_LIST, in any order
+					, ptrdiff_t pair_n
+					)
+{
+	ptrdiff_t i;
 
 	assert (sm);
 	assert(nplayers > 0);
+	assert(pairmode != PAIRS_TABLE || table != NULL || table_n == nplayers);
 
-	if (NULL == (a = memnew (sa * (size_t)nplayers))) {
-		return FALSE;
-	} else 
-	if (NULL == (b = memnew (sb * (size_t)nplayers))) {
-		memrel(a);
-		return FALSE;
-	} else 
-	if (NULL == (c = memnew (sc * (size_t)nplayers))) {
-		memrel(a);
-		memrel(b);
-		return FALSE;
-	} else 
-	if (NULL == (d = memnew (sd))) {
-		memrel(a);
-		memrel(b);
-		memrel(c);
+	summations_init (sm);
+	sm->nplayers = nplayers;
+	sm->pairmode = pairmode;
+
+	sm->mean = memnew (sizeof(double) * (size_t)nplayers);
+	sm->m2   = memnew (sizeof(double) * (size_t)nplayers);
+	sm->sdev = memnew (sizeof(double) * (size_t)nplayers);
+	if (NULL == sm->mean || NULL == sm->m2 || NULL == sm->sdev) {
+		summations_done (sm);
 		return FALSE;
-	} 
+	}
+
+	if (pairmode == PAIRS_TABLE) {
+		sm->table = memnew (sizeof(player_t) * (size_t)(table_n > 0? table_n: 1));
+		sm->slot  = memnew (sizeof(player_t) * (size_t)nplayers);
+		if (NULL == sm->table || NULL == sm->slot) {
+			summations_done (sm);
+			return FALSE;
+		}
+		for (i = 0; i < nplayers; i++) {
+			sm->slot[i] = -1;
+		}
+		for (i = 0; i < table_n; i++) {
+			player_t j = table? table[i]: (player_t)i;
+			assert (j >= 0 && j < nplayers);
+			if (sm->slot[j] >= 0) continue; // repeated
+			sm->slot[j] = sm->table_n;
+			sm->table[sm->table_n++] = j;
+		}
+	}
+
+	if (pairmode == PAIRS_LIST) {
+		sm->pair = memnew (sizeof(struct PAIR) * (size_t)(pair_n > 0? pair_n: 1));
+		if (NULL == sm->pair) {
+			summations_done (sm);
+			return FALSE;
+		}
+		for (i = 0; i < pair_n; i++) {
+			sm->pair[i] = pair[i];
+		}
+		sm->pair_n = pairs_normalize (sm->pair, pair_n);
+	}
 
-	sm->sum1 	 	= a; 
-	sm->sum2 	 	= b; 
-	sm->sdev	 	= c; 
-	sm->relative 	= d; 
+	sm->relative_n = relative_elements (nplayers, pairmode, sm->table_n, sm->pair_n);
+	if (sm->relative_n > 0) {
+		if (NULL == (sm->relative = memnew (sizeof(struct DEVIATION_ACC) * (size_t)sm->relative_n))) {
+			summations_done (sm);
+			return FALSE;
+		}
+	}
 
-	summations_clear (sm, nplayers);
+	summations_clear (sm);
 
 	return TRUE;
 }
@@ -129,13 +282,24 @@ summations_init (struct summations *sm)
 {
 	assert (sm);
 	sm->relative = NULL;
-	sm->sum1 = NULL;
-	sm->sum2 = NULL;
+	sm->relative_n = 0;
+	sm->pairmode = PAIRS_NONE;
+	sm->nplayers = 0;
+	sm->table_n = 0;
+	sm->table = NULL;
+	sm->slot = NULL;
+	sm->pair = NULL;
+	sm->pair_n = 0;
+	sm->mean = NULL;
+	sm->m2 = NULL;
 	sm->sdev = NULL; 
-	sm->wa_sum1 = 0;
-	sm->wa_sum2 = 0;                               
-	sm->dr_sum1 = 0;
-	sm->dr_sum2 = 0; 
+	sm->control = NULL;
+	sm->control_rel = NULL;
+	sm->wa_mean = 0;
+	sm->wa_m2 = 0;                               
+	sm->dr_mean = 0;
+	sm->dr_m2 = 0; 
+	sm->wadr_n = 0; 
 	sm->wa_sdev = 0;                               
 	sm->dr_sdev = 0;
 	return;
@@ -146,63 +310,389 @@ summations_done (struct summations *sm)
 {
 	assert (sm);
 
-	if (sm->sum1) 		memrel (sm->sum1);
-	if (sm->sum2) 		memrel (sm->sum2);
+	if (sm->mean) 		memrel (sm->mean);
+	if (sm->m2) 		memrel (sm->m2);
 	if (sm->sdev)	 	memrel (sm->sdev);
 	if (sm->relative) 	memrel (sm->relative);
+	if (sm->table) 		memrel (sm->table);
+	if (sm->slot) 		memrel (sm->slot);
+	if (sm->pair) 		memrel (sm->pair);
+	if (sm->control)	memrel (sm->control);
+	if (sm->control_rel)memrel (sm->control_rel);
 
-	sm->sum1 	 	= NULL; 
-	sm->sum2 	 	= NULL; 
+	sm->mean 	 	= NULL; 
+	sm->m2 	 		= NULL; 
 	sm->sdev	 	= NULL; 
 	sm->relative 	= NULL; 
+	sm->table 		= NULL; 
+	sm->slot 		= NULL; 
+	sm->pair 		= NULL; 
+	sm->control		= NULL;
+	sm->control_rel	= NULL;
+	sm->relative_n	= 0;
+	sm->table_n		= 0;
+	sm->pair_n		= 0;
+	sm->pairmode	= PAIRS_NONE;
 
 	return;
 }
 
+// no globals
+// Control variates for the accumulators of summations already allocated.
+bool_t
+summations_control_calloc (struct summations *sm)
+{
+	ptrdiff_t i;
+
+	assert (sm->control == NULL && sm->control_rel == NULL);
+	sm->control = memnew (sizeof(struct CONTROL_ACC) * (size_t)(sm->nplayers + 1));
+	if (sm->relative_n > 0)
+		sm->control_rel = memnew (sizeof(struct CONTROL_ACC) * (size_t)sm->relative_n);
+	if (NULL == sm->control || (sm->relative_n > 0 && NULL == sm->control_rel)) {
+		if (sm->control) 		memrel (sm->control);
+		if (sm->control_rel) 	memrel (sm->control_rel);
+		sm->control = NULL;
+		sm->control_rel = NULL;
+		return FALSE;
+	}
+	for (i = 0; i < sm->nplayers; i++) {
+		sm->control[i].mean = sm->control[i].m2 = sm->control[i].co = sm->control[i].var = 0;
+	}
+	for (i = 0; i < sm->relative_n; i++) {
+		sm->control_rel[i].mean = sm->control_rel[i].m2 = sm->control_rel[i].co = sm->control_rel[i].var = 0;
+	}
+	return TRUE;
+}
+
+// accumulator of the pair x, y or NULL if it is out of scope
+const struct DEVIATION_ACC *
+summations_pair (const struct summations *sm, player_t x, player_t y)
+{
+	if (sm == NULL || sm->relative == NULL || x == y) 
+		return NULL;
+
+	if (sm->pairmode == PAIRS_TABLE) {
+		player_t sx = sm->slot[x];
+		player_t sy = sm->slot[y];
+		if (sx < 0 || sy < 0) return NULL;
+		return &sm->relative[head2head_idx_sdev ((ptrdiff_t)sx, (ptrdiff_t)sy)];
+	}
+
+	if (sm->pairmode == PAIRS_LIST) {
+		struct PAIR key;
+		const struct PAIR *found;
+		key.a = x > y? x: y;
+		key.b = x > y? y: x;
+		found = bsearch (&key, sm->pair, (size_t)sm->pair_n, sizeof(struct PAIR), compare_pair);
+		return found? &sm->relative[found - sm->pair]: NULL;
+	}
+
+	return NULL;
+}
+
+// no globals
+// Adds the n-th run to block k out of nb, each with a similar amount of work.
+// Different blocks can be updated at the same time by different threads.
+// With control variates, lin has their values for the run.
 void
-summations_update	( struct summations *sm
-					, player_t topn
-					, double *ratingof
-					, double white_advantage
-					, double drawrate_evenmatch
+summations_update_block	( struct summations *sm
+						, int k
+						, int nb
+						, const double *ratingof
+						, const double *lin			// NULL without control variates
+						, double n
 )
 {
-	player_t i, j;
-	ptrdiff_t idx;
-	double diff;
-
-	sm->wa_sum1 += white_advantage;
-	sm->wa_sum2 += white_advantage * white_advantage;				
-	sm->dr_sum1 += drawrate_evenmatch;
-	sm->dr_sum2 += drawrate_evenmatch * drawrate_evenmatch;	
-
-	// update summations for errors
-	for (i = 0; i < topn; i++) {
-		sm->sum1[i] += ratingof[i];
-		sm->sum2[i] += ratingof[i]*ratingof[i];
-		for (j = 0; j < i; j++) {
-			idx = head2head_idx_sdev ((ptrdiff_t)i, (ptrdiff_t)j);
-			assert(idx < (ptrdiff_t)((topn*topn-topn)/2));
-			diff = ratingof[i] - ratingof[j];	
-			sm->relative[idx].sum1 += diff; 
-			sm->relative[idx].sum2 += diff * diff;
+	ptrdiff_t i, j, from, to;
+	double diff, d, ri, li = 0;
+	double inv_n = 1.0 / n;
+	struct DEVIATION_ACC *rel;
+	struct CONTROL_ACC *ctl = NULL;
+
+	assert (n >= 1);
+	assert (k >= 0 && k < nb);
+	assert ((lin == NULL) == (sm->control == NULL));
+
+	from = split_even (sm->nplayers, k, nb);
+	to   = split_even (sm->nplayers, k+1, nb);
+	for (i = from; i < to; i++) {
+		if (lin) control_add (&sm->control[i], lin[i], ratingof[i] - sm->mean[i], n);
+		welford_add (&sm->mean[i], &sm->m2[i], ratingof[i], n);
+	}
+
+	if (sm->pairmode == PAIRS_TABLE) {
+		const player_t *table = sm->table;
+		from = split_triangle (sm->table_n, k, nb);
+		to   = split_triangle (sm->table_n, k+1, nb);
+		for (i = from; i < to; i++) {
+			ri = ratingof[table[i]];
+			// row i of the triangular table is contiguous, see head2head_idx_sdev()
+			rel = &sm->relative[(i*i-i)/2];
+			if (lin) {
+				li  = lin[table[i]];
+				ctl = &sm->control_rel[(i*i-i)/2];
+			}
+			for (j = 0; j < i; j++) {
+				diff = ri - ratingof[table[j]];	
+				d = diff - rel[j].mean;
+				if (lin) control_add (&ctl[j], li - lin[table[j]], d, n);
+				rel[j].mean += d * inv_n; 
+				rel[j].m2   += d * (diff - rel[j].mean);
+			}
+		}
+	}
+
+	if (sm->pairmode == PAIRS_LIST) {
+		const struct PAIR *pair = sm->pair;
+		from = split_even (sm->pair_n, k, nb);
+		to   = split_even (sm->pair_n, k+1, nb);
+		rel  = sm->relative;
+		for (i = from; i < to; i++) {
+			diff = ratingof[pair[i].a] - ratingof[pair[i].b];	
+			d = diff - rel[i].mean;
+			if (lin) control_add (&sm->control_rel[i], lin[pair[i].a] - lin[pair[i].b], d, n);
+			rel[i].mean += d * inv_n; 
+			rel[i].m2   += d * (diff - rel[i].mean);
 		}
 	}
 }
 
 void
-summations_calc_sdev (struct summations *sm, player_t topn, double sim_n)
+summations_update_wadr	( struct summations *sm
+						, double white_advantage
+						, double drawrate_evenmatch
+)
+{
+	sm->wadr_n += 1;
+	welford_add (&sm->wa_mean, &sm->wa_m2, white_advantage, sm->wadr_n);
+	welford_add (&sm->dr_mean, &sm->dr_m2, drawrate_evenmatch, sm->wadr_n);
+}
+
+void
+summations_calc_sdev (struct summations *sm, double sim_n)
+{
+	ptrdiff_t i;
+
+	for (i = 0; i < sm->nplayers; i++) {
+		sm->sdev[i] = sm->control
+					? control_sdev (&sm->control[i], sm->m2[i], sim_n)
+					: get_sdev (sm->m2[i], sim_n);
+	}
+	for (i = 0; i < sm->relative_n; i++) {
+		sm->relative[i].sdev = sm->control_rel
+							? control_sdev (&sm->control_rel[i], sm->relative[i].m2, sim_n)
+							: get_sdev (sm->relative[i].m2, sim_n);
+	}
+	sm->wa_sdev = get_sdev (sm->wa_m2, sm->wadr_n);
+	sm->dr_sdev = get_sdev (sm->dr_m2, sm->wadr_n);
+}
+
+// no globals
+// Largest standard error of the standard deviations of the players in list,
+// after n runs. For normal samples, it is sdev / sqrt(2(n-1)), with n the
+// effective number of runs if there are control variates.
+double
+summations_sdev_stderr (const struct summations *sm, const player_t *list, player_t list_n, double n)
+{
+	player_t i, j;
+	double sdev, se, ess, worst = 0;
+
+	if (n < 2) return 0;
+	for (i = 0; i < list_n; i++) {
+		j = list[i];
+		if (sm->control) {
+			sdev = control_sdev (&sm->control[j], sm->m2[j], n);
+			ess  = control_ess (&sm->control[j], sm->m2[j], n);
+		} else {
+			sdev = get_sdev (sm->m2[j], n);
+			ess  = n;
+		}
+		se = sdev / sqrt (2 * (ess - 1));
+		if (se > worst) worst = se;
+	}
+	return worst;
+}
+
+static int
+compare_double (const void *a, const void *b)
+{
+	const double *x = a;
+	const double *y = b;
+	return *x < *y? -1: (*x > *y? 1: 0);
+}
+
+// no globals
+// Effective number of runs of the players that vary, the smallest and the
+// median, after n runs with control variates. Returns FALSE if there is
+// none, or not enough memory.
+bool_t
+summations_control_ess (const struct summations *sm, double n, double *smallest /*@out@*/, double *median /*@out@*/)
 {
 	player_t i;
-	ptrdiff_t est = (ptrdiff_t)((topn*topn-topn)/2); /* elements of simulation table */
+	ptrdiff_t k = 0;
+	double *ess;
+
+	if (NULL == sm->control || NULL == (ess = memnew (sizeof(double) * (size_t)(sm->nplayers + 1))))
+		return FALSE;
+	for (i = 0; i < sm->nplayers; i++) {
+		if (sm->control[i].m2 > 0 && sm->m2[i] > 0)
+			ess[k++] = control_ess (&sm->control[i], sm->m2[i], n);
+	}
+	if (k > 0) {
+		qsort (ess, (size_t)k, sizeof(double), compare_double);
+		*smallest = ess[0];
+		*median = ess[k/2];
+	}
+	memrel (ess);
+	return k > 0;
+}
+
+static void
+chan_merge (double *mean, double *m2, double x_mean, double x_m2, double n, double x_n)
+{
+	double d = x_mean - *mean;
+	double t = n + x_n;
+	if (x_n <= 0) return;
+	*mean += d * x_n / t;
+	*m2   += x_m2 + d * d * n * x_n / t;
+}
+
+// the same for a control, before the means of the accumulated ones, y_mean and x_y_mean, are combined
+static void
+control_merge (struct CONTROL_ACC *c, const struct CONTROL_ACC *x, double y_mean, double x_y_mean, double n, double x_n)
+{
+	double d = x->mean - c->mean;
+	double t = n + x_n;
+	if (x_n <= 0) return;
+	c->co	+= x->co + d * (x_y_mean - y_mean) * n * x_n / t;
+	chan_merge (&c->mean, &c->m2, x->mean, x->m2, n, x_n);
+}
+
+// no globals
+// Combines the accumulators of n runs with those of x_n runs that follow, 
+// both with the same scope (Chan et al. 1979). White advantage and draw
+// rate keep their own count of samples. Controls are combined if both have
+// them, their exact variances are those of sm.
+void
+summations_merge (struct summations *sm, const struct summations *x, double n, double x_n)
+{
+	ptrdiff_t i;
+	double wadr_n = sm->wadr_n;
+
+	assert (sm->nplayers == x->nplayers && sm->relative_n == x->relative_n);
+	assert ((sm->control == NULL) == (x->control == NULL));
+
+	for (i = 0; i < sm->nplayers; i++) {
+		if (sm->control) control_merge (&sm->control[i], &x->control[i], sm->mean[i], x->mean[i], n, x_n);
+		chan_merge (&sm->mean[i], &sm->m2[i], x->mean[i], x->m2[i], n, x_n);
+	}
+	for (i = 0; i < sm->relative_n; i++) {
+		if (sm->control_rel) control_merge (&sm->control_rel[i], &x->control_rel[i], sm->relative[i].mean, x->relative[i].mean, n, x_n);
+		chan_merge (&sm->relative[i].mean, &sm->relative[i].m2, x->relative[i].mean, x->relative[i].m2, n, x_n);
+	}
+	chan_merge (&sm->wa_mean, &sm->wa_m2, x->wa_mean, x->wa_m2, wadr_n, x->wadr_n);
+	chan_merge (&sm->dr_mean, &sm->dr_m2, x->dr_mean, x->dr_m2, wadr_n, x->wadr_n);
+	sm->wadr_n = wadr_n + x->wadr_n;
+}
+
+/*
+|	Accumulators of a checkpoint: means and m2 of the players, then of the
+|	pairs, then white advantage and draw rate. With controls, their mean, m2
+|	and co follow, of the players and then of the pairs. The exact variances
+|	are not written, they come from the curvature again. The scope is not
+|	written, the summations are loaded into others allocated with the same
+|	one, and controls if they were saved with them.
+*/
+
+static bool_t
+write_doubles (FILE *f, const double *x, size_t n)
+{
+	return n == fwrite (x, sizeof(double), n, f);
+}
+
+static bool_t
+read_doubles (FILE *f, double *x, size_t n)
+{
+	return n == fread (x, sizeof(double), n, f);
+}
+
+static bool_t
+control_save (FILE *f, const struct CONTROL_ACC *c)
+{
+	double x[3];
+	x[0] = c->mean;
+	x[1] = c->m2;
+	x[2] = c->co;
+	return write_doubles (f, x, 3);
+}
+
+static bool_t
+control_load (FILE *f, struct CONTROL_ACC *c)
+{
+	double x[3];
+	if (!read_doubles (f, x, 3))
+		return FALSE;
+	c->mean	= x[0];
+	c->m2	= x[1];
+	c->co	= x[2];
+	return TRUE;
+}
 
-	for (i = 0; i < topn; i++) {
-		sm->sdev[i] = get_sdev (sm->sum1[i], sm->sum2[i], sim_n);
+bool_t
+summations_save (FILE *f, const struct summations *sm)
+{
+	double x[5];
+	ptrdiff_t i;
+	bool_t ok;
+
+	ok = write_doubles (f, sm->mean, (size_t)sm->nplayers)
+		&& write_doubles (f, sm->m2, (size_t)sm->nplayers);
+	for (i = 0; ok && i < sm->relative_n; i++) {
+		x[0] = sm->relative[i].mean;
+		x[1] = sm->relative[i].m2;
+		ok = write_doubles (f, x, 2);
+	}
+	x[0] = sm->wa_mean;
+	x[1] = sm->wa_m2;
+	x[2] = sm->dr_mean;
+	x[3] = sm->dr_m2;
+	x[4] = sm->wadr_n;
+	ok = ok && write_doubles (f, x, 5);
+	for (i = 0; ok && sm->control && i < sm->nplayers; i++) {
+		ok = control_save (f, &sm->control[i]);
 	}
-	for (i = 0; i < est; i++) {
-		sm->relative[i].sdev = get_sdev (sm->relative[i].sum1, sm->relative[i].sum2, sim_n);
+	for (i = 0; ok && sm->control_rel && i < sm->relative_n; i++) {
+		ok = control_save (f, &sm->control_rel[i]);
 	}
-	sm->wa_sdev = get_sdev (sm->wa_sum1, sm->wa_sum2, sim_n+1);
-	sm->dr_sdev = get_sdev (sm->dr_sum1, sm->dr_sum2, sim_n+1);
+	return ok;
 }
 
+bool_t
+summations_load (FILE *f, struct summations *sm)
+{
+	double x[5];
+	ptrdiff_t i;
+	bool_t ok;
+
+	ok = read_doubles (f, sm->mean, (size_t)sm->nplayers)
+		&& read_doubles (f, sm->m2, (size_t)sm->nplayers);
+	for (i = 0; ok && i < sm->relative_n; i++) {
+		ok = read_doubles (f, x, 2);
+		sm->relative[i].mean = x[0];
+		sm->relative[i].m2   = x[1];
+	}
+	if (!ok || !read_doubles (f, x, 5))
+		return FALSE;
+	sm->wa_mean	= x[0];
+	sm->wa_m2	= x[1];
+	sm->dr_mean	= x[2];
+	sm->dr_m2	= x[3];
+	sm->wadr_n	= x[4];
+	for (i = 0; ok && sm->control && i < sm->nplayers; i++) {
+		ok = control_load (f, &sm->control[i]);
+	}
+	for (i = 0; ok && sm->control_rel && i < sm->relative_n; i++) {
+		ok = control_load (f, &sm->control_rel[i]);
+	}
+	return ok;
+}
@@ -23,23 +23,55 @@
 #define H_SUMMA
 /*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
 
+#include <stdio.h>
 #include "mytypes.h"
 
-extern bool_t 	summations_calloc (struct summations *sm, player_t nplayers);
+extern size_t	summations_memory (player_t nplayers, int pairmode, player_t table_n, ptrdiff_t pair_n);
+
+extern bool_t 	summations_calloc	
+					( struct summations *sm
+					, player_t nplayers
+					, int pairmode
+					, const player_t *table
+					, player_t table_n
+					, const struct PAIR *pair
+					, ptrdiff_t pair_n
+					);
+
+extern bool_t	summations_control_calloc (struct summations *sm);
 
 extern void 	summations_init (struct summations *sm);
 
 extern void 	summations_done (struct summations *sm);
 
-extern void		summations_update	
+extern const struct DEVIATION_ACC *
+				summations_pair (const struct summations *sm, player_t x, player_t y);
+
+extern void		summations_update_block	
+					( struct summations *sm
+					, int k
+					, int nb
+					, const double *ratingof
+					, const double *lin
+					, double n
+					);
+
+extern void		summations_update_wadr	
 					( struct summations *sm
-					, player_t topn
-					, double *ratingof
 					, double white_advantage
 					, double drawrate_evenmatch
 					);
 
-extern void		summations_calc_sdev (struct summations *sm, player_t topn, double sim_n);
+extern void		summations_calc_sdev (struct summations *sm, double sim_n);
+
+extern double	summations_sdev_stderr (const struct summations *sm, const player_t *list, player_t list_n, double n);
+
+extern bool_t	summations_control_ess (const struct summations *sm, double n, double *smallest, double *median);
+
+extern void		summations_merge (struct summations *sm, const struct summations *x, double n, double x_n);
+
+extern bool_t	summations_save (FILE *f, const struct summations *sm);
+extern bool_t	summations_load (FILE *f, struct summations *sm);
 
 /*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
 #endif
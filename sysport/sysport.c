@@ -1,3 +1,7 @@
+#if defined(__linux__) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
@@ -73,6 +77,19 @@
 	extern int mysys_fopen_max (void) { return FOPEN_MAX;}
 #endif
 
+/**** 64 bit File Offsets ****************************************************************/
+
+#if defined(MVSC)
+	extern int mysys_fseek64 (FILE *f, int64_t offset, int whence) { return _fseeki64 (f, offset, whence);}
+	extern int64_t mysys_ftell64 (FILE *f) { return _ftelli64 (f);}
+#elif defined(GCCLINUX)
+	extern int mysys_fseek64 (FILE *f, int64_t offset, int whence) { return fseeko (f, (off_t)offset, whence);}
+	extern int64_t mysys_ftell64 (FILE *f) { return (int64_t)ftello (f);}
+#else
+	extern int mysys_fseek64 (FILE *f, int64_t offset, int whence) { return fseek (f, (long)offset, whence);}
+	extern int64_t mysys_ftell64 (FILE *f) { return (int64_t)ftell (f);}
+#endif
+
 
 
 #if defined(MULTI_THREADED_INTERFACE)
@@ -184,6 +201,12 @@ extern void mythread_spinx_lock	(mythread_spinx_t *m) { pthread_spin_lock   (m)
 extern void mythread_spinx_unlock	(mythread_spinx_t *m) { pthread_spin_unlock (m)  ;} /**/
 #endif
 
+extern long mythread_atomic_add	(myatomic_t *x, long d) { return __sync_fetch_and_add (x, d);}
+extern long mythread_atomic_get	(myatomic_t *x) 		{ return __sync_fetch_and_add (x, 0);}
+extern void mythread_atomic_set	(myatomic_t *x, long v) { __sync_synchronize(); *x = v; __sync_synchronize();}
+
+extern void mythread_sleep_ms	(unsigned ms) { usleep ((useconds_t)ms * 1000);}
+
 #if defined(UNNAMED_SEMAPHORES)
 
 /* semaphores unnamed */
@@ -455,6 +478,12 @@ extern void mythread_spinx_lock     (mythread_spinx_t *m) { EnterCriticalSection
 //_Releases_lock_(m)
 extern void mythread_spinx_unlock   (mythread_spinx_t *m) { LeaveCriticalSection (m)  ;} /**/
 
+extern long mythread_atomic_add		(myatomic_t *x, long d) { return InterlockedExchangeAdd (x, d)			;}
+extern long mythread_atomic_get		(myatomic_t *x) 		{ return InterlockedCompareExchange (x, 0, 0)	;}
+extern void mythread_atomic_set		(myatomic_t *x, long v) { InterlockedExchange (x, v)					;}
+
+extern void mythread_sleep_ms		(unsigned ms) { Sleep (ms);}
+
 /* semaphores */
 extern int /* boolean */ 
 mysem_init	(mysem_t *sem, unsigned int value)
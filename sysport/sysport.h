@@ -149,6 +149,16 @@ extern int isfoldersep (int x);
 
 extern int mysys_fopen_max (void);
 
+/*-----------------
+	FILE OFFSETS
+------------------*/
+
+#include <stdio.h>
+
+/* seek and tell with 64 bit offsets, for files over 2 GB */
+extern int		mysys_fseek64 (FILE *f, int64_t offset, int whence);
+extern int64_t	mysys_ftell64 (FILE *f);
+
 /*------------ 
 	TIMER 
 -------------*/
@@ -181,6 +191,7 @@ extern myclock_t ticks_per_sec (void);
 	typedef pthread_t 					mythread_t;
 	typedef thread_return_t 			(THREAD_CALL *routine_t) (void *);
 	typedef pthread_mutex_t 			mythread_mutex_t;
+	typedef volatile long				myatomic_t;
 
 	#if defined(NSPINLOCKS)
 		typedef pthread_mutex_t 		mythread_spinx_t; 
@@ -242,6 +253,7 @@ extern myclock_t ticks_per_sec (void);
 	typedef HANDLE 						mythread_t;
 	typedef thread_return_t 			(THREAD_CALL *routine_t) (void *);
 	typedef HANDLE						mythread_mutex_t;
+	typedef volatile LONG				myatomic_t;
 
 	#if defined(NSPINLOCKS)
 		typedef HANDLE 					mythread_spinx_t; 
@@ -271,6 +283,13 @@ extern void 			mythread_spinx_destroy	(mythread_spinx_t *m); /**/
 extern void 			mythread_spinx_lock     (mythread_spinx_t *m); /**/
 extern void 			mythread_spinx_unlock   (mythread_spinx_t *m); /**/
 
+/* atomic counters, add returns the value before adding */
+extern long				mythread_atomic_add		(myatomic_t *x, long d);
+extern long				mythread_atomic_get		(myatomic_t *x);
+extern void				mythread_atomic_set		(myatomic_t *x, long v);
+
+extern void				mythread_sleep_ms		(unsigned ms);
+
 /* semaphores*/
 extern int /*boolean*/	mysem_init		(mysem_t *sem, unsigned int value);
 extern int /*boolean*/	mysem_wait		(mysem_t *sem);
@@ -0,0 +1,195 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "warmst.h"
+#include "csv.h"
+#include "plyrs.h"
+#include "mymem.h"
+
+#define MAX_MYLINE MAXSIZE_CSVLINE
+
+/*
+|	Warm start: previous ratings are used as the starting point of the
+|	calculation. Input is either the csv output of a previous run (-c)
+|	or a snapshot saved with --warm-save. A snapshot is the same format,
+|	preceded by rows with the white advantage and draw rate (%) found.
+|
+|	"White advantage",34.1234
+|	"Draw rate",42.1234
+|	"PLAYER","RATING"
+|	"Player A",2512.3456
+\*--------------------------------------------------------------*/
+
+static const char *Hdr_player = "PLAYER";
+static const char *Hdr_rating = "RATING";
+static const char *Key_wadv   = "White advantage";
+static const char *Key_drate  = "Draw rate";
+
+static char *skipblanks(char *p) {while (isspace(*p)) p++; return p;}
+
+static bool_t getnum(const char *p, double *px) 
+{ 	
+	return 1 == sscanf( p, "%lf", px );
+}
+
+static bool_t
+header_find (const csv_line_t *c, int *pcol_player, int *pcol_rating)
+{
+	int i;
+	*pcol_player = -1;
+	*pcol_rating = -1;
+	for (i = 0; i < c->n; i++) {
+		if (!strcmp(c->s[i], Hdr_player)) *pcol_player = i;
+		if (!strcmp(c->s[i], Hdr_rating)) *pcol_rating = i;
+	}
+	return *pcol_player != -1 && *pcol_rating != -1;
+}
+
+void
+warmstart_load	( bool_t quietmode
+				, const char *fname
+				, const struct PLAYERS *plyrs
+				, struct RATINGS *rat /*@out@*/
+				, double *pwadv /*@out@*/
+				, double *pdrate /*@out@*/)
+{
+	FILE *f;
+	char myline[MAX_MYLINE];
+	char *p;
+	csv_line_t csvln;
+	bool_t success = TRUE;
+	bool_t header_found = FALSE;
+	int col_player = -1;
+	int col_rating = -1;
+	player_t j;
+	player_t loaded_n = 0;
+	double x;
+	double sum = 0;
+	bool_t *loaded;
+
+	assert(NULL != fname);
+
+	if (NULL == (loaded = memnew (sizeof(bool_t) * (size_t)plyrs->n))) {
+		fprintf (stderr, "Not enough memory to load file \"%s\"\n", fname);
+		exit(EXIT_FAILURE);
+	}
+	for (j = 0; j < plyrs->n; j++) loaded[j] = FALSE;
+
+	if (NULL == (f = fopen (fname, "r"))) {
+		fprintf (stderr, "Errors with file: %s\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	while (success && NULL != fgets(myline, MAX_MYLINE, f)) {
+		p = skipblanks(myline);
+		if (*p == '\0') continue;
+
+		if (!csv_line_init(&csvln, myline)) {
+			fprintf (stderr, "Failure to input --warm-start file\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!header_found) {
+			header_found = header_find (&csvln, &col_player, &col_rating);
+			if (!header_found) {
+				success = csvln.n == 2 && getnum(csvln.s[1], &x);
+				if (success) {
+					if (!strcmp(csvln.s[0], Key_wadv)) {
+						*pwadv = x;
+					} else if (!strcmp(csvln.s[0], Key_drate)) {
+						*pdrate = x/100.0;
+					} else {
+						success = FALSE;
+					}
+				}
+			}
+		} else {
+			success = csvln.n > col_player && csvln.n > col_rating;
+			if (success && players_name2idx (plyrs, csvln.s[col_player], &j)) {
+				// a rating not present, such as in purged players, is skipped
+				if (getnum(csvln.s[col_rating], &x) && !plyrs->prefed[j] && !loaded[j]) {
+					rat->ratingof[j] = x;
+					rat->ratingbk[j] = x;
+					loaded[j] = TRUE;
+					sum += x;
+					loaded_n++;
+				}
+			}
+		}
+
+		csv_line_done(&csvln);
+	}
+
+	fclose(f);
+
+	if (!success || !header_found) {
+		fprintf (stderr, "Errors in file \"%s\"\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	// players that are new start from the average of the ones loaded
+	if (loaded_n > 0) {
+		double avg = sum / (double)loaded_n;
+		for (j = 0; j < plyrs->n; j++) {
+			if (!loaded[j] && !plyrs->prefed[j]) {
+				rat->ratingof[j] = avg;
+				rat->ratingbk[j] = avg;
+			}
+		}
+	}
+
+	if (!quietmode)
+		printf ("Warm start, %ld of %ld players loaded from \"%s\"\n", (long)loaded_n, (long)plyrs->n, fname);
+
+	memrel(loaded);
+}
+
+void
+warmstart_save	( const char *fname
+				, const struct PLAYERS *plyrs
+				, const struct RATINGS *rat
+				, double wadv
+				, double drate)
+{
+	FILE *f;
+	player_t j;
+
+	if (NULL == (f = fopen (fname, "w"))) {
+		fprintf (stderr, "Errors with file: %s\n", fname);
+		return;
+	}
+
+	fprintf (f, "\"%s\",%.6f\n", Key_wadv, wadv);
+	fprintf (f, "\"%s\",%.6f\n", Key_drate, 100*drate);
+	fprintf (f, "\"%s\",\"%s\"\n", Hdr_player, Hdr_rating);
+	for (j = 0; j < plyrs->n; j++) {
+		if (plyrs->present_in_games[j])
+			fprintf (f, "\"%s\",%.6f\n", plyrs->name[j], rat->ratingof_results[j]);
+	}
+
+	fclose(f);
+}
+
@@ -0,0 +1,42 @@
+/*
+	Ordo is program for calculating ratings of engine or chess players
+    Copyright 2013 Miguel A. Ballicora
+
+    This file is part of Ordo.
+
+    Ordo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Ordo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ordo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(H_WARMST)
+#define H_WARMST
+/*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
+
+#include "boolean.h"
+#include "mytypes.h"
+
+extern void	warmstart_load	( bool_t quietmode
+							, const char *fname
+							, const struct PLAYERS *plyrs
+							, struct RATINGS *rat /*@out@*/
+							, double *pwadv /*@out@*/
+							, double *pdrate /*@out@*/);
+
+extern void	warmstart_save	( const char *fname
+							, const struct PLAYERS *plyrs
+							, const struct RATINGS *rat
+							, double wadv
+							, double drate);
+
+/*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
+#endif
@@ -100,6 +100,31 @@ draw_rate_fperf (double p, double d0)
 	return newx;
 }
 
+// draw rate and its derivatives, from the implicit derivative of a*x*x + 2*x + c = 0
+// with a = (1-2*d0)/(d0*d0) and c = 4*(p*p-p)
+void
+draw_rate_fperf_deriv (double p, double d0, double *pdr, double *pdr_dp, double *pdr_dd0)
+{
+	double x, a, s, q;
+
+	if (d0 < 0.0001) {
+		q = sqrt(p-p*p);
+		*pdr 	 = 2*d0*q-d0*d0;
+		*pdr_dp  = q > 0? d0*(1-2*p)/q: 0;
+		*pdr_dd0 = 2*q-2*d0;
+		return;
+	}
+
+	x = draw_rate_fperf (p, d0);
+	a = (1-2*d0)/(d0*d0);
+	s = 2 + 2*a*x; // sqrt(b*b-4*a*c), zero only when all games are draws
+	if (s < 1E-9) s = 1E-9;
+
+	*pdr 	 = x;
+	*pdr_dp  = -4*(2*p-1)/s;
+	*pdr_dd0 = 2*(1-d0)*x*x/(d0*d0*d0*s);
+}
+
 
 static double 
 draw_rate_fperf_calc (double p, double d0)
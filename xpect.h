@@ -31,6 +31,7 @@ extern double 	inv_xpect	(double invbeta, double p);
 extern double 	xpect (double a, double b, double beta);
 extern void 	get_pWDL(double delta_rating /*delta rating*/, double *pw, double *pd, double *pl, double drawrate0, double beta);
 extern double 	draw_rate_fperf (double p, double d0);
+extern void 	draw_rate_fperf_deriv (double p, double d0, double *pdr, double *pdr_dp, double *pdr_dd0);
 
 /*<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<*/
 #endif